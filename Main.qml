@@ -20,6 +20,7 @@ Window {
     readonly property bool isMinimalView: isFramelessMode || isMonitorFullScreen
 
     property bool sidebarVisible: true
+    property bool telemetryVisible: false
     
     // Visibility: Only "Real" Fullscreen uses Window.FullScreen
     visibility: isMonitorFullScreen ? Window.FullScreen : Window.Windowed
@@ -39,6 +40,11 @@ Window {
         sequence: "Ctrl+F"
         onActivated: isMonitorFullScreen = !isMonitorFullScreen
     }
+
+    Shortcut {
+        sequence: "Ctrl+I"
+        onActivated: telemetryVisible = !telemetryVisible
+    }
     
     // Auto-maximize/restore if needed, or just let it occupy current size. 
     // User said "interface closes, full video shows", implying the window size might stay or fill screen. 
@@ -57,6 +63,38 @@ Window {
         }
     }
 
+    // Fast start: straight back to the last playlist, category and channel.
+    // The playlist comes from its cache when there is one, and the channel
+    // starts playing before its list has loaded.
+    property bool sessionRestoreTried: false
+    function restoreSession() {
+        if (sessionRestoreTried || !userState.ready)
+            return
+        sessionRestoreTried = true
+        if (!userState.fastStart)
+            return
+
+        const last = userState.lastWatched()
+        if (!last.url || !last.category)
+            return
+        if (last.playlist === "catalogue") {
+            playlistModel.loadCatalogue(playlistManager)
+        } else {
+            const index = playlistManager.indexOfSource(last.playlist)
+            if (index < 0)
+                return // removed since
+            playlistModel.loadPlaylist(last.playlist, playlistManager.getRefreshInterval(index))
+        }
+        playlistModel.filterChannels(last.category, "")
+        stackView.push(categoryParams, {}, StackView.Immediate)
+        stackView.push(channelListComp, {categoryName: last.category, restoreUrl: last.url}, StackView.Immediate)
+    }
+    Component.onCompleted: restoreSession()
+    Connections {
+        target: userState
+        function onReadyChanged() { mainWindow.restoreSession() }
+    }
+
     Dialog {
         id: errorDialog
         title: "Xatolik (Error)"
@@ -191,6 +229,33 @@ Window {
                             font.pixelSize: 18
                         }
                         
+                        Button {
+                            id: allPlaylistsButton
+                            anchors.left: parent.left
+                            anchors.verticalCenter: parent.verticalCenter
+                            anchors.leftMargin: 10
+                            text: "Hammasi (All)"
+                            enabled: playlistListView.count > 0
+                            ToolTip.visible: hovered
+                            ToolTip.text: "Belgilangan pleylistlar birlashtiriladi (Merged catalogue)"
+                            onClicked: {
+                                playlistModel.loadCatalogue(playlistManager)
+                                stackView.push(categoryParams)
+                            }
+                        }
+
+                        CheckBox {
+                            anchors.left: allPlaylistsButton.right
+                            anchors.verticalCenter: parent.verticalCenter
+                            anchors.leftMargin: 10
+                            text: "Tez ishga tushirish (Fast start)"
+                            palette.windowText: "white"
+                            checked: userState.fastStart
+                            onToggled: userState.fastStart = checked
+                            ToolTip.visible: hovered
+                            ToolTip.text: "Oxirgi kanal darhol ochiladi (Reopen the last channel on start)"
+                        }
+
                         Button {
                             anchors.right: parent.right
                             anchors.verticalCenter: parent.verticalCenter
@@ -213,6 +278,13 @@ Window {
                             
                             contentItem: RowLayout {
                                 spacing: 10
+
+                                CheckBox {
+                                    checked: model.enabled
+                                    onToggled: playlistManager.setEnabled(index, checked)
+                                    ToolTip.visible: hovered
+                                    ToolTip.text: "Hammasi ro'yxatiga qo'shish (Include in All)"
+                                }
                                 
                                 ColumnLayout {
                                     Layout.fillWidth: true
@@ -237,7 +309,7 @@ Window {
                                 Button {
                                     text: "Edit"
                                     onClicked: {
-                                        addPlaylistDialog.openDialog(index, model.name, model.source)
+                                        addPlaylistDialog.openDialog(index, model.name, model.source, model.refreshInterval)
                                     }
                                 }
                                 
@@ -258,7 +330,7 @@ Window {
                             }
                             
                             onClicked: {
-                                playlistModel.loadPlaylist(model.source)
+                                playlistModel.loadPlaylist(model.source, model.refreshInterval)
                                 stackView.push(categoryParams) // Go to categories
                             }
                         }
@@ -272,16 +344,17 @@ Window {
                     title: isEdit ? "Tahrirlash (Edit)" : "Yangi Pleylist (New Playlist)"
                     anchors.centerIn: parent
                     width: 400
-                    height: 250
+                    height: 300
                     
                     property bool isEdit: false
                     property int editIndex: -1
                     
-                    function openDialog(index = -1, name = "", source = "") {
+                    function openDialog(index = -1, name = "", source = "", refreshInterval = 0) {
                         isEdit = (index !== -1)
                         editIndex = index
                         nameInput.text = name
                         sourceInput.text = source
+                        refreshInput.value = refreshInterval
                         open()
                     }
                     
@@ -326,6 +399,23 @@ Window {
                              }
                         }
                         
+                        RowLayout {
+                            Layout.fillWidth: true
+
+                            Text {
+                                text: "Yangilash, daqiqa (Refresh, min; 0 = off)"
+                                color: "#aaa"
+                                Layout.fillWidth: true
+                            }
+                            SpinBox {
+                                id: refreshInput
+                                from: 0
+                                to: 1440
+                                stepSize: 5
+                                editable: true
+                            }
+                        }
+                        
                         RowLayout {
                             Layout.fillWidth: true
                             Layout.alignment: Qt.AlignRight
@@ -341,9 +431,9 @@ Window {
                                 enabled: nameInput.text !== "" && sourceInput.text !== ""
                                 onClicked: {
                                     if (addPlaylistDialog.isEdit) {
-                                        playlistManager.editPlaylist(addPlaylistDialog.editIndex, nameInput.text, sourceInput.text)
+                                        playlistManager.editPlaylist(addPlaylistDialog.editIndex, nameInput.text, sourceInput.text, refreshInput.value)
                                     } else {
-                                        playlistManager.addPlaylist(nameInput.text, sourceInput.text)
+                                        playlistManager.addPlaylist(nameInput.text, sourceInput.text, refreshInput.value)
                                     }
                                     addPlaylistDialog.close()
                                 }
@@ -432,7 +522,10 @@ Window {
                             display: AbstractButton.IconOnly
                             background: Item {} // Transparent background
                             
-                            onClicked: stackView.pop()
+                            onClicked: {
+                                playlistModel.cancelLoad()
+                                stackView.pop()
+                            }
                         }
                         
                         Text {
@@ -448,23 +541,108 @@ Window {
                         Item { width: 40; height: 1 }
                     }
 
+                    // Shown while the playlist is downloaded and parsed in the background
+                    ProgressBar {
+                        Layout.fillWidth: true
+                        Layout.leftMargin: 20
+                        Layout.rightMargin: 20
+                        visible: playlistModel.loading
+                        from: 0
+                        to: 1.0
+                        value: playlistModel.loadProgress
+                        indeterminate: playlistModel.loadProgress === 0
+                    }
+
+                    TextField {
+                        id: globalSearchField
+                        Layout.fillWidth: true
+                        Layout.leftMargin: 20
+                        Layout.rightMargin: 20
+                        placeholderText: "Barcha kanallardan qidirish... (Search all channels)"
+                        onTextChanged: playlistModel.searchAll(text, 100)
+                    }
+
+                    // Global search results replace the category list while searching
+                    ListView {
+                        id: searchResultsListView
+                        Layout.fillWidth: true
+                        Layout.fillHeight: true
+                        clip: true
+                        visible: globalSearchField.text !== ""
+                        model: playlistModel.searchResults
+
+                        delegate: ItemDelegate {
+                            width: ListView.view.width
+                            height: 50
+
+                            contentItem: ColumnLayout {
+                                spacing: 2
+
+                                Text {
+                                    text: model.name
+                                    color: "white"
+                                    font.pixelSize: 16
+                                    elide: Text.ElideRight
+                                    Layout.fillWidth: true
+                                    leftPadding: 20
+                                }
+
+                                Text {
+                                    text: model.category
+                                    color: "#aaa"
+                                    font.pixelSize: 12
+                                    elide: Text.ElideRight
+                                    Layout.fillWidth: true
+                                    leftPadding: 20
+                                }
+                            }
+
+                            background: Rectangle {
+                                color: parent.hovered ? "#0078d7" : "#333333"
+                                border.color: "#444"
+                                border.width: 1
+                            }
+
+                            onClicked: {
+                                playlistModel.filterChannels(model.category, "")
+                                stackView.push(channelListComp, {
+                                    categoryName: model.category,
+                                    initialRow: playlistModel.rowForChannel(model.channelIndex)
+                                })
+                            }
+                        }
+                        ScrollBar.vertical: ScrollBar {}
+                    }
+
                     ListView {
                         id: catListView
                         Layout.fillWidth: true
                         Layout.fillHeight: true
                         clip: true
-                        model: playlistModel.categories // Uses the new QStringList property
+                        visible: globalSearchField.text === ""
+                        model: playlistModel.categories // CategoryListModel: name, count
 
                         delegate: ItemDelegate {
                             width: parent.width
                             height: 50
                             
-                            contentItem: Text {
-                                text: modelData // modelData is the string in QStringList
-                                color: "white"
-                                font.pixelSize: 16
-                                verticalAlignment: Text.AlignVCenter
-                                leftPadding: 20
+                            contentItem: RowLayout {
+                                Text {
+                                    text: model.name
+                                    color: "white"
+                                    font.pixelSize: 16
+                                    elide: Text.ElideRight
+                                    verticalAlignment: Text.AlignVCenter
+                                    leftPadding: 20
+                                    Layout.fillWidth: true
+                                }
+
+                                Text {
+                                    text: model.count
+                                    color: "#aaa"
+                                    font.pixelSize: 14
+                                    rightPadding: 10
+                                }
                             }
 
                             background: Rectangle {
@@ -475,8 +653,8 @@ Window {
 
                             highlighted: ListView.isCurrentItem
                             onClicked: {
-                                playlistModel.filterChannels(modelData, "")
-                                stackView.push(channelListComp, {categoryName: modelData})
+                                playlistModel.filterChannels(model.name, "")
+                                stackView.push(channelListComp, {categoryName: model.name})
                             }
                         }
                         ScrollBar.vertical: ScrollBar {}
@@ -487,20 +665,221 @@ Window {
             }
         }
 
+        // Several channels at once; MosaicController shares out the decoding
+        Component {
+            id: mosaicComp
+
+            Rectangle {
+                id: mosaicPage
+                color: "#1e1e1e"
+                property int startRow: 0
+                readonly property int tileCount: mosaic.columns * mosaic.columns
+
+                MosaicController {
+                    id: mosaic
+                    model: playlistModel
+                    volume: mosaicVolume.value
+                    // Everything is released while the page is covered or the window minimised
+                    active: mosaicPage.StackView.status === StackView.Active && mainWindow.visibility !== Window.Minimized
+                }
+                Component.onCompleted: mosaic.showRows(startRow)
+
+                ColumnLayout {
+                    anchors.fill: parent
+                    spacing: 0
+
+                    Rectangle {
+                        Layout.fillWidth: true
+                        height: 50
+                        color: "#333"
+
+                        RowLayout {
+                            anchors.fill: parent
+                            anchors.margins: 10
+
+                            Button {
+                                icon.source: "icons/back.svg"
+                                icon.color: "white"
+                                display: AbstractButton.IconOnly
+                                background: Item {}
+                                onClicked: stackView.pop()
+                            }
+
+                            Text {
+                                text: "Mozaika (Mosaic)"
+                                color: "white"
+                                font.bold: true
+                                font.pixelSize: 18
+                            }
+
+                            Button {
+                                text: "2x2"
+                                highlighted: mosaic.columns === 2
+                                onClicked: mosaic.columns = 2
+                            }
+
+                            Button {
+                                text: "3x3"
+                                highlighted: mosaic.columns === 3
+                                onClicked: mosaic.columns = 3
+                            }
+
+                            Button {
+                                text: "◀"
+                                enabled: mosaicPage.startRow > 0
+                                onClicked: {
+                                    mosaicPage.startRow = Math.max(0, mosaicPage.startRow - mosaicPage.tileCount)
+                                    mosaic.showRows(mosaicPage.startRow)
+                                }
+                            }
+
+                            Button {
+                                text: "▶"
+                                enabled: mosaicPage.startRow + mosaicPage.tileCount < playlistModel.totalCount
+                                onClicked: {
+                                    mosaicPage.startRow += mosaicPage.tileCount
+                                    mosaic.showRows(mosaicPage.startRow)
+                                }
+                            }
+
+                            Item { Layout.fillWidth: true }
+
+                            // Decoding in use, in 1080p30 streams
+                            Text {
+                                text: "Dekodlash (Decode): " + mosaic.usedBudget.toFixed(2) + " / " + mosaic.decodeBudget.toFixed(2)
+                                color: mosaic.usedBudget > mosaic.decodeBudget ? "#e81123" : "#aaa"
+                                font.pixelSize: 12
+                            }
+
+                            Text {
+                                text: "Ovoz:"
+                                color: "white"
+                            }
+
+                            Slider {
+                                id: mosaicVolume
+                                from: 0
+                                to: 1.0
+                                value: 1.0
+                                Layout.preferredWidth: 120
+                            }
+                        }
+                    }
+
+                    GridLayout {
+                        Layout.fillWidth: true
+                        Layout.fillHeight: true
+                        columns: mosaic.columns
+                        rowSpacing: 2
+                        columnSpacing: 2
+
+                        Repeater {
+                            model: mosaic
+
+                            delegate: Rectangle {
+                                Layout.fillWidth: true
+                                Layout.fillHeight: true
+                                color: "black"
+                                border.color: model.focused ? "#0078d7" : "#333"
+                                border.width: 2
+                                onVisibleChanged: mosaic.setTileVisible(index, visible)
+
+                                VideoOutput {
+                                    id: tileOutput
+                                    anchors.fill: parent
+                                    anchors.margins: 2
+                                    Component.onCompleted: mosaic.setTileOutput(index, tileOutput)
+                                    Component.onDestruction: if (mosaic) mosaic.setTileOutput(index, null)
+                                }
+
+                                // Channel name, and why the picture stands still
+                                Rectangle {
+                                    anchors.left: parent.left
+                                    anchors.bottom: parent.bottom
+                                    anchors.margins: 6
+                                    width: tileLabel.implicitWidth + 12
+                                    height: tileLabel.implicitHeight + 6
+                                    color: "#aa000000"
+                                    radius: 3
+                                    visible: model.name !== ""
+
+                                    Text {
+                                        id: tileLabel
+                                        anchors.centerIn: parent
+                                        text: model.name
+                                              + (model.failed ? "  ·  Xato (Error)"
+                                                 : model.tier === MosaicController.Paused ? "  ·  Navbatda (Waiting)" : "")
+                                        color: "white"
+                                        font.pixelSize: 12
+                                    }
+                                }
+
+                                MouseArea {
+                                    anchors.fill: parent
+                                    // Sound and full resolution follow the click
+                                    onClicked: mosaic.focusedTile = index
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
         Component {
             id: channelListComp
             
             Rectangle {
                 color: "#1e1e1e"
                 property string categoryName: ""
+                property int initialRow: -1
+                // Set by restoreSession(): played at once, selected once listed
+                property url restoreUrl
+                property bool restoring: false
 
-                MediaPlayer {
-                    id: player
-                    videoOutput: videoOutput
-                    audioOutput: AudioOutput {
-                        volume: volumeSlider.value
+                // Opened from the global search: start on the chosen channel
+                Component.onCompleted: {
+                    if (initialRow >= 0) {
+                        channelListView.currentIndex = initialRow
+                        zapper.playRow(initialRow)
+                    } else if (restoreUrl.toString() !== "") {
+                        restoring = true
+                        zapper.playUrl(restoreUrl)
+                        selectRestored()
+                    }
+                }
+
+                function selectRestored() {
+                    if (!restoring)
+                        return
+                    // rowForUrl() may fetch rows, which lands back here
+                    restoring = false
+                    const row = playlistModel.rowForUrl(restoreUrl)
+                    if (row < 0) {
+                        restoring = true
+                        return
                     }
+                    channelListView.currentIndex = row
+                    // Already playing; this warms the neighbours
+                    zapper.playRow(row)
+                }
+
+                Connections {
+                    target: playlistModel
+                    function onRowsInserted() { selectRestored() }
+                    function onModelReset() { selectRestored() }
+                }
+
+                // Plays the current channel and pre-buffers its neighbours
+                ZappingController {
+                    id: zapper
+                    model: playlistModel
+                    videoOutput: videoOutput
+                    volume: volumeSlider.value
+                    onChannelStarted: (url, name) => userState.channelWatched(playlistModel.source, url, name, categoryName)
+                    onFirstFrameShown: startupTrace.mark(StartupTrace.FirstVideoFrame)
                 }
+                readonly property MediaPlayer player: zapper.player
 
                 ColumnLayout {
                     anchors.fill: parent
@@ -538,6 +917,21 @@ Window {
                                playlistModel.filterChannels(categoryName, text)
                            }
                        }
+
+                       CheckBox {
+                           text: "Ishlamaydiganlarni yashirish (Hide dead)"
+                           checked: playlistModel.hideDeadChannels
+                           palette.windowText: "white"
+                           onToggled: playlistModel.hideDeadChannels = checked
+                       }
+
+                       Button {
+                           text: "Mozaika (Mosaic)"
+                           onClicked: {
+                               zapper.stop()
+                               stackView.push(mosaicComp, {startRow: Math.max(0, channelListView.currentIndex)})
+                           }
+                       }
                     }
                 }
 
@@ -560,17 +954,81 @@ Window {
                                 anchors.fill: parent
                                 model: playlistModel
                                 clip: true
+                                onCountChanged: if (count > 0) startupTrace.markOnNextFrame(StartupTrace.ListShown)
 
                                 delegate: ItemDelegate {
                                     width: ListView.view.width
                                     text: model.name
                                     
-                                    contentItem: Text {
-                                        text: model.name
-                                        color: "white"
-                                        font.pixelSize: 14
-                                        elide: Text.ElideRight
-                                        verticalAlignment: Text.AlignVCenter
+                                    contentItem: ColumnLayout {
+                                        spacing: 2
+
+                                        RowLayout {
+                                            spacing: 8
+                                            Layout.fillWidth: true
+
+                                            Image {
+                                                visible: model.logo !== ""
+                                                source: model.logo
+                                                sourceSize: Qt.size(32, 32)
+                                                Layout.preferredWidth: 32
+                                                Layout.preferredHeight: 32
+                                                fillMode: Image.PreserveAspectFit
+                                                asynchronous: true
+                                            }
+
+                                            Text {
+                                                text: model.name
+                                                color: "white"
+                                                font.pixelSize: 14
+                                                elide: Text.ElideRight
+                                                verticalAlignment: Text.AlignVCenter
+                                                Layout.fillWidth: true
+                                            }
+
+                                            // Favourite toggle
+                                            ToolButton {
+                                                readonly property bool favorite: userState.revision >= 0
+                                                    && userState.isFavorite(playlistModel.source, model.url)
+                                                text: favorite ? "★" : "☆"
+                                                palette.buttonText: favorite ? "#f5c518" : "#888"
+                                                Layout.preferredWidth: 28
+                                                Layout.preferredHeight: 28
+                                                onClicked: userState.setFavorite(playlistModel.source, model.url, !favorite)
+                                            }
+
+                                            // Stream check result, hidden until the channel was checked
+                                            Rectangle {
+                                                visible: model.alive !== undefined
+                                                Layout.preferredWidth: 8
+                                                Layout.preferredHeight: 8
+                                                radius: 4
+                                                color: model.alive ? "#3cb043" : "#d00000"
+                                            }
+                                        }
+
+                                        // Programme guide, when the playlist has one
+                                        Text {
+                                            visible: !!model.nowTitle
+                                            text: model.nowTitle + (model.nextTitle ? "  →  " + model.nextTitle : "")
+                                            color: "#aaa"
+                                            font.pixelSize: 11
+                                            elide: Text.ElideRight
+                                            Layout.fillWidth: true
+                                        }
+
+                                        Rectangle {
+                                            visible: model.progress !== undefined && model.progress >= 0
+                                            Layout.fillWidth: true
+                                            height: 2
+                                            color: "#444"
+
+                                            Rectangle {
+                                                width: parent.width * Math.max(0, Math.min(1, model.progress || 0))
+                                                height: parent.height
+                                                color: "#0078d7"
+                                            }
+                                        }
                                     }
 
                                     background: Rectangle {
@@ -580,8 +1038,7 @@ Window {
                                     highlighted: ListView.isCurrentItem
                                     onClicked: {
                                         channelListView.currentIndex = index
-                                        player.source = model.url
-                                        player.play()
+                                        zapper.playRow(index)
                                     }
                                 }
                                 ScrollBar.vertical: ScrollBar {}
@@ -615,18 +1072,15 @@ Window {
                                     
                                     // Function to switch to next channel
                                     function nextChannel() {
-                                        if (channelListView.count > 0) {
-                                            var nextIndex = channelListView.currentIndex + 1
-                                            if (nextIndex >= channelListView.count) {
-                                                nextIndex = 0 // Loop to first channel
-                                            }
+                                        if (playlistModel.totalCount > 0) {
+                                            // Loops to the first channel, fetching rows as needed
+                                            var nextIndex = playlistModel.neighbourRow(channelListView.currentIndex, 1)
                                             if (nextIndex !== lastSwitchedIndex) {
                                                 lastSwitchedIndex = nextIndex
                                                 channelListView.currentIndex = nextIndex
                                                 var channelUrl = playlistModel.getChannelUrl(nextIndex)
                                                 if (channelUrl.toString() !== "") {
-                                                    player.source = channelUrl
-                                                    player.play()
+                                                    zapper.playRow(nextIndex)
                                                     // Show channel name overlay
                                                     channelOverlay.showChannel(nextIndex)
                                                 }
@@ -636,18 +1090,15 @@ Window {
                                     
                                     // Function to switch to previous channel
                                     function previousChannel() {
-                                        if (channelListView.count > 0) {
-                                            var prevIndex = channelListView.currentIndex - 1
-                                            if (prevIndex < 0) {
-                                                prevIndex = channelListView.count - 1 // Loop to last channel
-                                            }
+                                        if (playlistModel.totalCount > 0) {
+                                            // Loops to the last channel, fetching rows as needed
+                                            var prevIndex = playlistModel.neighbourRow(channelListView.currentIndex, -1)
                                             if (prevIndex !== lastSwitchedIndex) {
                                                 lastSwitchedIndex = prevIndex
                                                 channelListView.currentIndex = prevIndex
                                                 var channelUrl = playlistModel.getChannelUrl(prevIndex)
                                                 if (channelUrl.toString() !== "") {
-                                                    player.source = channelUrl
-                                                    player.play()
+                                                    zapper.playRow(prevIndex)
                                                     // Show channel name overlay
                                                     channelOverlay.showChannel(prevIndex)
                                                 }
@@ -705,25 +1156,12 @@ Window {
                                             // Horizontal drag - channel switching (only if not vertical drag)
                                             // Left swipe = next channel, Right swipe = previous channel
                                             if (deltaX > minDragDistance && deltaX > deltaY * 1.5) {
-                                                var switchIndex = -1
                                                 if (mouse.x < startX) {
                                                     // Swiped left = next channel
-                                                    if (channelListView.count > 0) {
-                                                        switchIndex = channelListView.currentIndex + 1
-                                                        if (switchIndex >= channelListView.count) {
-                                                            switchIndex = 0
-                                                        }
-                                                        nextChannel() // This will show overlay
-                                                    }
+                                                    nextChannel() // This will show overlay
                                                 } else {
                                                     // Swiped right = previous channel
-                                                    if (channelListView.count > 0) {
-                                                        switchIndex = channelListView.currentIndex - 1
-                                                        if (switchIndex < 0) {
-                                                            switchIndex = channelListView.count - 1
-                                                        }
-                                                        previousChannel() // This will show overlay
-                                                    }
+                                                    previousChannel() // This will show overlay
                                                 }
                                             }
                                         }
@@ -847,6 +1285,27 @@ Window {
                                     }
                                 }
                                 
+                                // Playback metrics (Ctrl+I)
+                                Rectangle {
+                                    anchors.left: parent.left
+                                    anchors.top: parent.top
+                                    anchors.margins: 10
+                                    width: telemetryText.implicitWidth + 16
+                                    height: telemetryText.implicitHeight + 12
+                                    color: "#cc000000"
+                                    radius: 4
+                                    visible: mainWindow.telemetryVisible
+
+                                    Text {
+                                        id: telemetryText
+                                        anchors.centerIn: parent
+                                        text: telemetry.overlayText + "\n\n" + startupTrace.summary + "\n\n" + playlistModel.memoryStats()
+                                        color: "#9f9"
+                                        font.family: "monospace"
+                                        font.pixelSize: 12
+                                    }
+                                }
+
                                 // Channel Name Overlay (bottom center)
                                 Rectangle {
                                     id: channelOverlay
@@ -943,15 +1402,28 @@ Window {
                                                             anchors.fill: parent
                                                             color: parent.highlighted ? "#0078d7" : (index % 2 === 0 ? "#333333" : "#2b2b2b")
                                                             
-                                                            Text {
+                                                            Image {
+                                                                id: overlayLogo
                                                                 anchors.left: parent.left
                                                                 anchors.leftMargin: 15
                                                                 anchors.verticalCenter: parent.verticalCenter
+                                                                width: model.logo !== "" ? 32 : 0
+                                                                height: 32
+                                                                source: model.logo
+                                                                sourceSize: Qt.size(32, 32)
+                                                                fillMode: Image.PreserveAspectFit
+                                                                asynchronous: true
+                                                            }
+
+                                                            Text {
+                                                                anchors.left: overlayLogo.right
+                                                                anchors.leftMargin: overlayLogo.width > 0 ? 10 : 0
+                                                                anchors.verticalCenter: parent.verticalCenter
                                                                 text: model.name
                                                                 color: "white"
                                                                 font.pixelSize: 16
                                                                 elide: Text.ElideRight
-                                                                width: parent.width - 30
+                                                                width: parent.width - 30 - overlayLogo.width
                                                             }
                                                         }
                                                         
@@ -962,8 +1434,7 @@ Window {
                                                             channelListView.currentIndex = index
                                                             var channelUrl = playlistModel.getChannelUrl(index)
                                                             if (channelUrl.toString() !== "") {
-                                                                player.source = channelUrl
-                                                                player.play()
+                                                                zapper.playRow(index)
                                                                 channelOverlay.showChannel(index)
                                                                 channelsListOverlay.visible = false
                                                             }
@@ -1044,9 +1515,9 @@ Window {
                                 }
                                 onClicked: {
                                     if (player.playbackState === MediaPlayer.PlayingState)
-                                        player.pause()
+                                        zapper.pause()
                                     else
-                                        player.play()
+                                        zapper.resume()
                                 }
                             }
 
@@ -1059,7 +1530,50 @@ Window {
                                     radius: 4
                                     border.color: parent.hovered ? "#444" : "transparent"
                                 }
-                                onClicked: player.stop()
+                                onClicked: zapper.stop()
+                            }
+
+                            // Timeshift: pause, rewind and catch up on live channels
+                            Button {
+                                text: "TS"
+                                checkable: true
+                                checked: zapper.timeshift
+                                palette.buttonText: checked ? "#0078d7" : "white"
+                                background: Rectangle {
+                                    color: "transparent"
+                                    radius: 4
+                                    border.color: parent.hovered || parent.checked ? "#444" : "transparent"
+                                }
+                                onToggled: zapper.timeshift = checked
+                                ToolTip.visible: hovered
+                                ToolTip.text: zapper.timeshift
+                                              ? "Yozib olinmoqda: " + zapper.timeshiftBuffered + " s (Timeshift)"
+                                              : "Orqaga qaytarishni yoqish (Timeshift)"
+                            }
+
+                            Button {
+                                text: "-10s"
+                                visible: zapper.timeshift
+                                enabled: zapper.timeshiftBuffered > 10
+                                palette.buttonText: enabled ? "white" : "gray"
+                                background: Rectangle {
+                                    color: "transparent"
+                                    radius: 4
+                                    border.color: parent.hovered ? "#444" : "transparent"
+                                }
+                                onClicked: zapper.rewind(10)
+                            }
+
+                            Button {
+                                text: "Jonli (Live) -" + zapper.timeshiftDelay + "s"
+                                visible: zapper.timeshiftDelay > 0
+                                palette.buttonText: "#e81123"
+                                background: Rectangle {
+                                    color: "transparent"
+                                    radius: 4
+                                    border.color: parent.hovered ? "#444" : "transparent"
+                                }
+                                onClicked: zapper.goLive()
                             }
 
                             Text {
@@ -0,0 +1,299 @@
+// Measures the playlist core without the UI: parsing, rebuilding the
+// categories of a cached store, filtering while typing and global search,
+// on synthetic playlists of 10k, 100k and 1M channels.
+//
+//   iptv_playlistbench [--sizes 10000,100000] [--runs 3] [--label <commit>] [--output results.json]
+//
+// Results are written as JSON (to stdout without --output) so runs of two
+// commits can be compared side by side.
+
+#include "channelstore.h"
+#include "playlistbuilder.h"
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QRandomGenerator>
+#include <QSysInfo>
+#include <algorithm>
+#include <cstdio>
+
+#if defined(Q_OS_WIN)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(Q_OS_UNIX)
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+// Words with ASCII, Latin diacritics, Cyrillic, Greek and emoji, so both the
+// ASCII fast paths and UTF-8 decoding are exercised
+const char *const kWords[] = {
+    "Sport", "News", "Kino", "Music", "Kids", "Documentary", "HD", "FHD", "4K", "Plus",
+    "O'zbekiston", "Toshkent", "Dunyo", "Bolajon", "Новости", "Кино", "Мультфильмы",
+    "Ελληνικά", "Ειδήσεις", "Télé", "Música", "Ñandú", "Zürich", "Ćevapi", "🎬", "⚽", "Live",
+    "International", "Premium",
+};
+constexpr int kWordCount = int(sizeof(kWords) / sizeof(kWords[0]));
+
+QByteArray randomName(QRandomGenerator &random)
+{
+    // Mostly short names with a tail of very long ones
+    const int words = random.bounded(100) < 5 ? 12 + random.bounded(12) : 1 + random.bounded(4);
+    QByteArray name;
+    for (int i = 0; i < words; ++i) {
+        if (i > 0)
+            name += ' ';
+        name += kWords[random.bounded(kWordCount)];
+    }
+    name += ' ';
+    name += QByteArray::number(random.bounded(1000));
+    return name;
+}
+
+// A playlist in the shape providers serve: groups as group-title or as
+// #EXTGRP lines, some channels without any group, tvg attributes, and
+// consecutive channels mostly sharing a group
+QByteArray generatePlaylist(int channels, quint32 seed)
+{
+    QRandomGenerator random(seed);
+    const int groupCount = qBound(10, channels / 500, 2000);
+    QList<QByteArray> groups;
+    groups.reserve(groupCount);
+    for (int i = 0; i < groupCount; ++i)
+        groups.append(QByteArray(kWords[i % kWordCount]) + ' ' + QByteArray::number(i));
+
+    QByteArray playlist;
+    playlist.reserve(qsizetype(channels) * 220);
+    playlist += "#EXTM3U x-tvg-url=\"http://epg.example.com/guide.xml.gz\"\n";
+
+    int group = 0;
+    for (int i = 0; i < channels; ++i) {
+        if (random.bounded(100) < 3)
+            group = random.bounded(groupCount);
+        const QByteArray name = randomName(random);
+        const int style = random.bounded(100);
+
+        playlist += "#EXTINF:-1 tvg-id=\"ch";
+        playlist += QByteArray::number(i);
+        playlist += ".example\" tvg-logo=\"http://logos.example.com/";
+        playlist += QByteArray::number(i % 5000);
+        playlist += ".png\"";
+        if (style < 60) {
+            playlist += " group-title=\"";
+            playlist += groups[group];
+            playlist += '"';
+        }
+        playlist += ',';
+        playlist += name;
+        playlist += '\n';
+        if (style >= 60 && style < 90) {
+            playlist += "#EXTGRP:";
+            playlist += groups[group];
+            playlist += '\n';
+        }
+        playlist += "http://stream";
+        playlist += QByteArray::number(i % 50);
+        playlist += ".example.com/live/";
+        playlist += QByteArray::number(i);
+        playlist += "/index.m3u8\n";
+    }
+    return playlist;
+}
+
+qint64 peakRssBytes()
+{
+#if defined(Q_OS_WIN)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return qint64(counters.PeakWorkingSetSize);
+    return -1;
+#elif defined(Q_OS_UNIX)
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return -1;
+#if defined(Q_OS_MACOS)
+    return qint64(usage.ru_maxrss); // bytes
+#else
+    return qint64(usage.ru_maxrss) * 1024; // KiB
+#endif
+#else
+    return -1;
+#endif
+}
+
+double msecsOf(const QElapsedTimer &timer)
+{
+    return timer.nsecsElapsed() / 1e6;
+}
+
+QJsonObject summary(QList<double> samples)
+{
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (double sample : samples)
+        sum += sample;
+    QJsonObject object;
+    object["min"] = samples.isEmpty() ? 0 : samples.first();
+    object["median"] = samples.isEmpty() ? 0 : samples[samples.size() / 2];
+    object["max"] = samples.isEmpty() ? 0 : samples.last();
+    object["mean"] = samples.isEmpty() ? 0 : sum / samples.size();
+    return object;
+}
+
+// Category with the most channels, the worst case for filtering
+quint32 largestCategory(const ChannelStore &store)
+{
+    quint32 largest = 0;
+    qsizetype largestSize = -1;
+    for (qsizetype id = 0; id < store.categoryCount(); ++id) {
+        const qsizetype size = store.channelsInCategory(quint32(id)).size();
+        if (size > largestSize) {
+            largest = quint32(id);
+            largestSize = size;
+        }
+    }
+    return largest;
+}
+
+QJsonObject runSize(int channels, int runs)
+{
+    QJsonObject result;
+    result["channels"] = channels;
+
+    QElapsedTimer timer;
+    timer.start();
+    const QByteArray content = generatePlaylist(channels, 0x1234u + quint32(channels));
+    result["generateMs"] = msecsOf(timer);
+    result["bytes"] = content.size();
+
+    // Parse: the full background load of PlaylistModel, search index included
+    QList<double> parseMs;
+    ParsedPlaylist playlist;
+    for (int run = 0; run < runs; ++run) {
+        playlist = ParsedPlaylist();
+        timer.start();
+        playlist = PlaylistBuilder::parse(content);
+        parseMs.append(msecsOf(timer));
+    }
+    const QJsonObject parse = summary(parseMs);
+    result["parseMs"] = parse;
+    result["parseMBps"] = content.size() / (1024.0 * 1024.0) / (parse["median"].toDouble() / 1000.0);
+    result["categories"] = playlist.store.categoryCount();
+    result["storeBytes"] = playlist.store.memoryUsage();
+
+    // Category build: what a cached load does, validating the arrays and
+    // rebuilding the per-category lists, plus the sorted list for display
+    const ChannelStore &store = playlist.store;
+    QList<double> categoryMs;
+    for (int run = 0; run < runs; ++run) {
+        ChannelStore copy;
+        timer.start();
+        copy.assign(store.arena(), store.fieldOffsetBytes(), store.categoryIdBytes(), store.categoryNames());
+        const QList<CategoryInfo> categories = copy.categoryInfos();
+        categoryMs.append(msecsOf(timer));
+    }
+    result["categoryBuildMs"] = summary(categoryMs);
+
+    // Filter: typing a query into the search box of the largest category,
+    // one keystroke at a time, each narrowing the previous result the way
+    // PlaylistModel::filterChannels does
+    const quint32 category = largestCategory(store);
+    const QList<quint32> all = store.channelsInCategory(category);
+    const QString query = QStringLiteral("sport plus");
+    QList<double> keystrokeMs;
+    for (int run = 0; run < runs; ++run) {
+        QList<quint32> rows = all;
+        for (qsizetype length = 1; length <= query.size(); ++length) {
+            timer.start();
+            rows = store.filterByName(rows, query.left(length));
+            keystrokeMs.append(msecsOf(timer));
+        }
+    }
+    QJsonObject filter = summary(keystrokeMs);
+    filter["categoryChannels"] = all.size();
+    result["filterKeystrokeMs"] = filter;
+
+    // Global search over the trigram index
+    const QStringList queries = {"sport", "kino hd", "novosti", "zurich", "premum", "o'zbekiston 4k"};
+    QList<double> searchMs;
+    for (int run = 0; run < runs; ++run) {
+        for (const QString &text : queries) {
+            timer.start();
+            playlist.searchIndex.search(text, 50, [&store](quint32 channel) { return store.name(channel); });
+            searchMs.append(msecsOf(timer));
+        }
+    }
+    result["searchMs"] = summary(searchMs);
+
+    // Process-wide high-water mark, so sizes run smallest first
+    result["peakRssBytes"] = peakRssBytes();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Playlist core benchmark");
+    parser.addHelpOption();
+    const QCommandLineOption sizesOption("sizes", "Comma-separated channel counts.", "list", "10000,100000,1000000");
+    const QCommandLineOption runsOption("runs", "Repetitions per measurement.", "count", "3");
+    const QCommandLineOption labelOption("label", "Free-form tag stored with the results, e.g. a commit.", "text");
+    const QCommandLineOption outputOption("output", "JSON file to write instead of stdout.", "file");
+    parser.addOptions({sizesOption, runsOption, labelOption, outputOption});
+    parser.process(app);
+
+    QList<int> sizes;
+    for (const QString &size : parser.value(sizesOption).split(',', Qt::SkipEmptyParts)) {
+        bool ok = false;
+        const int count = size.trimmed().toInt(&ok);
+        if (!ok || count <= 0) {
+            fprintf(stderr, "Invalid size: %s\n", qPrintable(size));
+            return 1;
+        }
+        sizes.append(count);
+    }
+    std::sort(sizes.begin(), sizes.end());
+    const int runs = qMax(1, parser.value(runsOption).toInt());
+
+    QJsonArray results;
+    for (int size : std::as_const(sizes)) {
+        fprintf(stderr, "%d channels...\n", size);
+        results.append(runSize(size, runs));
+    }
+
+    QJsonObject report;
+    report["label"] = parser.value(labelOption);
+    report["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    report["qtVersion"] = QString::fromLatin1(qVersion());
+    report["cpu"] = QSysInfo::currentCpuArchitecture();
+    report["os"] = QSysInfo::prettyProductName();
+#ifdef QT_DEBUG
+    report["build"] = "debug";
+#else
+    report["build"] = "release";
+#endif
+    report["runs"] = runs;
+    report["results"] = results;
+
+    const QByteArray json = QJsonDocument(report).toJson();
+    if (!parser.isSet(outputOption)) {
+        fwrite(json.constData(), 1, size_t(json.size()), stdout);
+        return 0;
+    }
+    QFile file(parser.value(outputOption));
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+        fprintf(stderr, "Could not write %s\n", qPrintable(file.fileName()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+#include "categorylistmodel.h"
+
+CategoryListModel::CategoryListModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int CategoryListModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return int(m_categories.count());
+}
+
+QVariant CategoryListModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_categories.count())
+        return QVariant();
+
+    const CategoryInfo &category = m_categories[index.row()];
+
+    switch (role) {
+    case NameRole:
+        return category.name;
+    case CountRole:
+        return category.count;
+    case FirstChannelRole:
+        return category.firstChannel;
+    case LastChannelRole:
+        return category.lastChannel;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> CategoryListModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[NameRole] = "name";
+    roles[CountRole] = "count";
+    roles[FirstChannelRole] = "firstChannel";
+    roles[LastChannelRole] = "lastChannel";
+    return roles;
+}
+
+int CategoryListModel::count() const
+{
+    return int(m_categories.count());
+}
+
+void CategoryListModel::setCategories(QList<CategoryInfo> &&categories)
+{
+    const bool countChanging = categories.count() != m_categories.count();
+    beginResetModel();
+    m_categories = std::move(categories);
+    endResetModel();
+    if (countChanging)
+        emit countChanged();
+}
+
+void CategoryListModel::updateCategories(QList<CategoryInfo> &&categories)
+{
+    // Both lists are sorted by name: walk them together
+    const qsizetype oldCount = m_categories.count();
+    qsizetype row = 0;
+    qsizetype next = 0;
+    while (row < m_categories.size() || next < categories.size()) {
+        if (next >= categories.size()
+            || (row < m_categories.size() && m_categories[row].name < categories[next].name)) {
+            beginRemoveRows(QModelIndex(), int(row), int(row));
+            m_categories.removeAt(row);
+            endRemoveRows();
+            continue;
+        }
+        if (row >= m_categories.size() || categories[next].name < m_categories[row].name) {
+            beginInsertRows(QModelIndex(), int(row), int(row));
+            m_categories.insert(row, categories[next]);
+            endInsertRows();
+        } else {
+            CategoryInfo &current = m_categories[row];
+            const CategoryInfo &fresh = categories[next];
+            const bool changed = current.count != fresh.count || current.firstChannel != fresh.firstChannel
+                                 || current.lastChannel != fresh.lastChannel;
+            current = fresh;
+            if (changed)
+                emit dataChanged(index(int(row)), index(int(row)), {CountRole, FirstChannelRole, LastChannelRole});
+        }
+        ++row;
+        ++next;
+    }
+    if (m_categories.count() != oldCount)
+        emit countChanged();
+}
@@ -0,0 +1,45 @@
+#ifndef CATEGORYLISTMODEL_H
+#define CATEGORYLISTMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include "channelstore.h"
+
+// The categories of the playlist on screen, sorted by name, for QML to bind
+// to. Comes ready-made from the parse (ParsedPlaylist::categories), so
+// nothing here walks the channels. Updates during streaming and refreshes
+// are applied as row inserts, removals and count changes, so the list keeps
+// its scroll position.
+class CategoryListModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum CategoryRoles {
+        NameRole = Qt::UserRole + 1,
+        CountRole,
+        FirstChannelRole,
+        LastChannelRole
+    };
+
+    explicit CategoryListModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+    // categories must be sorted by name, as ChannelStore::categoryInfos() is
+    void setCategories(QList<CategoryInfo> &&categories);
+    void updateCategories(QList<CategoryInfo> &&categories);
+
+signals:
+    void countChanged();
+
+private:
+    QList<CategoryInfo> m_categories;
+};
+
+#endif // CATEGORYLISTMODEL_H
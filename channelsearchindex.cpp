@@ -0,0 +1,210 @@
+#include "channelsearchindex.h"
+#include <algorithm>
+
+namespace {
+
+quint32 trigramHash(char16_t a, char16_t b, char16_t c)
+{
+    // Folded names are mostly Latin/Cyrillic, so collisions are rare enough
+    // for ranking purposes
+    quint32 h = 2166136261u;
+    for (char16_t ch : {a, b, c}) {
+        h ^= ch;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+// Distinct trigram hashes of an already folded string, sorted
+std::vector<quint32> trigramsOf(const QString &folded)
+{
+    std::vector<quint32> grams;
+    const QChar *data = folded.constData();
+    const qsizetype size = folded.size();
+
+    qsizetype wordStart = 0;
+    while (wordStart < size) {
+        while (wordStart < size && data[wordStart] == QLatin1Char(' '))
+            ++wordStart;
+        qsizetype wordEnd = wordStart;
+        while (wordEnd < size && data[wordEnd] != QLatin1Char(' '))
+            ++wordEnd;
+        if (wordEnd == wordStart)
+            break;
+
+        // Pad the word with a space on both ends
+        const auto at = [&](qsizetype i) -> char16_t {
+            return (i < wordStart || i >= wordEnd) ? u' ' : data[i].unicode();
+        };
+        for (qsizetype i = wordStart - 1; i + 2 <= wordEnd; ++i)
+            grams.push_back(trigramHash(at(i), at(i + 1), at(i + 2)));
+
+        wordStart = wordEnd;
+    }
+
+    std::sort(grams.begin(), grams.end());
+    grams.erase(std::unique(grams.begin(), grams.end()), grams.end());
+    return grams;
+}
+
+} // namespace
+
+QString ChannelSearchIndex::fold(const QString &text)
+{
+    bool ascii = true;
+    for (QChar ch : text) {
+        if (ch.unicode() >= 0x80) {
+            ascii = false;
+            break;
+        }
+    }
+
+    // Decompose so that accents become separate marks that can be dropped
+    const QString source = ascii ? text : text.normalized(QString::NormalizationForm_KD);
+
+    QString folded;
+    folded.reserve(source.size());
+    bool pendingSpace = false;
+    for (QChar ch : source) {
+        if (ch.category() == QChar::Mark_NonSpacing || ch.category() == QChar::Mark_Enclosing)
+            continue;
+        if (!ch.isLetterOrNumber()) {
+            pendingSpace = !folded.isEmpty();
+            continue;
+        }
+        if (pendingSpace) {
+            folded.append(QLatin1Char(' '));
+            pendingSpace = false;
+        }
+        folded.append(ch.toCaseFolded());
+    }
+    return folded;
+}
+
+QString ChannelSearchIndex::fold(QByteArrayView utf8)
+{
+    for (char byte : utf8) {
+        if (uchar(byte) >= 0x80)
+            return fold(QString::fromUtf8(utf8));
+    }
+
+    QString folded;
+    folded.reserve(utf8.size());
+    bool pendingSpace = false;
+    for (char byte : utf8) {
+        const bool letterOrDigit = (byte >= 'a' && byte <= 'z') || (byte >= 'A' && byte <= 'Z')
+                                   || (byte >= '0' && byte <= '9');
+        if (!letterOrDigit) {
+            pendingSpace = !folded.isEmpty();
+            continue;
+        }
+        if (pendingSpace) {
+            folded.append(QLatin1Char(' '));
+            pendingSpace = false;
+        }
+        folded.append(QLatin1Char(byte >= 'A' && byte <= 'Z' ? char(byte + ('a' - 'A')) : byte));
+    }
+    return folded;
+}
+
+void ChannelSearchIndex::Builder::add(quint32 channel, QByteArrayView utf8Name)
+{
+    const std::vector<quint32> grams = trigramsOf(fold(utf8Name));
+    if (m_trigramCounts.size() <= channel)
+        m_trigramCounts.resize(channel + 1, 0);
+    m_trigramCounts[channel] = quint16(std::min<size_t>(grams.size(), 0xFFFF));
+
+    for (quint32 gram : grams)
+        m_postings.push_back((quint64(gram) << 32) | channel);
+}
+
+ChannelSearchIndex ChannelSearchIndex::Builder::build()
+{
+    ChannelSearchIndex index;
+
+    // Channels were added in ascending order, so sorting the packed pairs
+    // groups them by trigram with ascending posting lists
+    std::sort(m_postings.begin(), m_postings.end());
+
+    index.m_channels.reserve(m_postings.size());
+    for (size_t i = 0; i < m_postings.size(); ++i) {
+        const quint32 key = quint32(m_postings[i] >> 32);
+        if (index.m_keys.empty() || index.m_keys.back() != key) {
+            index.m_keys.push_back(key);
+            index.m_offsets.push_back(quint32(i));
+        }
+        index.m_channels.push_back(quint32(m_postings[i]));
+    }
+    index.m_offsets.push_back(quint32(m_postings.size()));
+    index.m_trigramCounts = std::move(m_trigramCounts);
+
+    m_postings = {};
+    m_trigramCounts = {};
+    return index;
+}
+
+QList<ChannelSearchIndex::Match> ChannelSearchIndex::search(const QString &query, int limit,
+                                                            const std::function<QString(quint32)> &nameOf) const
+{
+    QList<Match> matches;
+    const QString foldedQuery = fold(query);
+    const std::vector<quint32> grams = trigramsOf(foldedQuery);
+    if (grams.empty() || limit <= 0 || m_keys.empty())
+        return matches;
+
+    // Count shared trigrams per channel
+    if (m_scratch.size() != m_trigramCounts.size())
+        m_scratch.assign(m_trigramCounts.size(), 0);
+    std::vector<quint32> touched;
+    for (quint32 gram : grams) {
+        const auto it = std::lower_bound(m_keys.begin(), m_keys.end(), gram);
+        if (it == m_keys.end() || *it != gram)
+            continue;
+        const size_t key = size_t(it - m_keys.begin());
+        for (quint32 i = m_offsets[key]; i < m_offsets[key + 1]; ++i) {
+            const quint32 channel = m_channels[i];
+            if (m_scratch[channel]++ == 0)
+                touched.push_back(channel);
+        }
+    }
+
+    // A typo breaks up to three trigrams of a word; requiring 40% of the
+    // query's trigrams still lets a misspelled word through
+    const quint16 minShared = quint16(std::max<size_t>(1, (grams.size() * 2 + 4) / 5));
+    std::vector<Match> candidates;
+    for (quint32 channel : touched) {
+        const quint16 shared = m_scratch[channel];
+        m_scratch[channel] = 0;
+        if (shared < minShared)
+            continue;
+        // Dice coefficient: penalises long names that merely contain the query
+        const float dice = 2.0f * shared / float(grams.size() + m_trigramCounts[channel]);
+        candidates.push_back({channel, dice});
+    }
+
+    const auto byScore = [](const Match &a, const Match &b) {
+        return a.score != b.score ? a.score > b.score : a.channel < b.channel;
+    };
+
+    // Only the head of the list gets the (more expensive) text checks
+    const size_t shortlist = std::min(candidates.size(), size_t(limit) * 4);
+    std::partial_sort(candidates.begin(), candidates.begin() + shortlist, candidates.end(), byScore);
+    candidates.resize(shortlist);
+
+    if (nameOf) {
+        for (Match &match : candidates) {
+            const QString foldedName = fold(nameOf(match.channel));
+            if (foldedName.startsWith(foldedQuery))
+                match.score += 1.5f;
+            else if (foldedName.contains(foldedQuery))
+                match.score += 1.0f;
+        }
+        std::sort(candidates.begin(), candidates.end(), byScore);
+    }
+
+    const size_t count = std::min(candidates.size(), size_t(limit));
+    matches.reserve(qsizetype(count));
+    for (size_t i = 0; i < count; ++i)
+        matches.append(candidates[i]);
+    return matches;
+}
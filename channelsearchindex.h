@@ -0,0 +1,58 @@
+#ifndef CHANNELSEARCHINDEX_H
+#define CHANNELSEARCHINDEX_H
+
+#include <QByteArrayView>
+#include <QList>
+#include <QString>
+#include <functional>
+#include <vector>
+
+// Trigram index over channel names for ranked, typo-tolerant search across
+// the whole playlist. Names are case- and diacritic-folded, split into words
+// and each word is padded with spaces, so "BBC One" yields " bb", "bbc",
+// "bc ", " on", "one", "ne ". Postings are kept in one sorted CSR layout
+// (keys / offsets / channel ids) instead of a hash of lists.
+class ChannelSearchIndex
+{
+public:
+    struct Match {
+        quint32 channel;
+        float score;
+    };
+
+    // Collects trigrams while the playlist is parsed. Channels must be added
+    // with ascending ids; build() does the sorting once at the end.
+    class Builder
+    {
+    public:
+        void add(quint32 channel, QByteArrayView utf8Name);
+        ChannelSearchIndex build();
+
+    private:
+        std::vector<quint64> m_postings; // (trigram hash << 32) | channel
+        std::vector<quint16> m_trigramCounts;
+    };
+
+    // Lower case, diacritics removed, anything but letters and digits
+    // turned into single spaces
+    static QString fold(const QString &text);
+    // Same for UTF-8 input; pure ASCII is folded without decoding first
+    static QString fold(QByteArrayView utf8);
+
+    bool isEmpty() const { return m_keys.empty(); }
+
+    // Best matches first. nameOf returns the display name of a channel and is
+    // only called for the few candidates that get re-ranked. Not thread-safe:
+    // queries share a scratch buffer.
+    QList<Match> search(const QString &query, int limit,
+                        const std::function<QString(quint32)> &nameOf) const;
+
+private:
+    std::vector<quint32> m_keys;     // sorted unique trigram hashes
+    std::vector<quint32> m_offsets;  // m_keys.size() + 1 offsets into m_channels
+    std::vector<quint32> m_channels; // posting lists, ascending per key
+    std::vector<quint16> m_trigramCounts; // distinct trigrams per channel
+    mutable std::vector<quint16> m_scratch;
+};
+
+#endif // CHANNELSEARCHINDEX_H
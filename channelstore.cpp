@@ -0,0 +1,163 @@
+#include "channelstore.h"
+#include <QSet>
+#include <algorithm>
+
+quint32 ChannelStore::addCategory(const QString &name)
+{
+    const auto it = m_categoryLookup.constFind(name);
+    if (it != m_categoryLookup.cend())
+        return quint32(it.value());
+
+    const quint32 id = quint32(m_categoryNames.size());
+    m_categoryNames.append(name);
+    m_categoryLookup.insert(name, id);
+    m_categoryChannels.append(QList<quint32>());
+    return id;
+}
+
+quint32 ChannelStore::add(QByteArrayView name, QByteArrayView url, QByteArrayView tvgId, QByteArrayView logo,
+                          quint32 categoryId)
+{
+    const quint32 channel = quint32(size());
+
+    if (m_fieldOffsets.isEmpty())
+        m_fieldOffsets.append(0);
+    for (QByteArrayView value : {name, url, tvgId, logo}) {
+        m_arena.append(value.data(), value.size());
+        m_fieldOffsets.append(quint32(m_arena.size()));
+    }
+
+    m_categoryIds.append(categoryId);
+    m_categoryChannels[categoryId].append(channel);
+    return channel;
+}
+
+void ChannelStore::append(const ChannelStore &other, quint32 first, quint32 end)
+{
+    if (first >= end)
+        return;
+
+    // The fields of consecutive channels are consecutive in the arena, so
+    // they are copied in one go and only the offsets are moved
+    const quint32 otherBegin = other.m_fieldOffsets[qsizetype(first) * FieldCount];
+    const quint32 otherEnd = other.m_fieldOffsets[qsizetype(end) * FieldCount];
+    const quint32 begin = quint32(m_arena.size());
+    m_arena.append(other.m_arena.constData() + otherBegin, otherEnd - otherBegin);
+
+    if (m_fieldOffsets.isEmpty())
+        m_fieldOffsets.append(0);
+    for (qsizetype slot = qsizetype(first) * FieldCount + 1; slot <= qsizetype(end) * FieldCount; ++slot)
+        m_fieldOffsets.append(other.m_fieldOffsets[slot] - otherBegin + begin);
+
+    QList<qint64> categories(other.categoryCount(), -1);
+    for (quint32 channel = first; channel < end; ++channel) {
+        qint64 &id = categories[other.categoryId(channel)];
+        if (id < 0)
+            id = addCategory(other.categoryName(other.categoryId(channel)));
+        m_categoryChannels[id].append(quint32(size()));
+        m_categoryIds.append(quint32(id));
+    }
+}
+
+QByteArrayView ChannelStore::field(quint32 channel, Field field) const
+{
+    const qsizetype slot = qsizetype(channel) * FieldCount + field;
+    const quint32 begin = m_fieldOffsets[slot];
+    const quint32 end = m_fieldOffsets[slot + 1];
+    return QByteArrayView(m_arena.constData() + begin, end - begin);
+}
+
+QList<quint32> ChannelStore::filterByName(const QList<quint32> &channels, const QString &query) const
+{
+    if (query.isEmpty())
+        return channels;
+
+    QList<quint32> matches;
+    for (quint32 channel : channels) {
+        if (name(channel).contains(query, Qt::CaseInsensitive))
+            matches.append(channel);
+    }
+    return matches;
+}
+
+QList<CategoryInfo> ChannelStore::categoryInfos() const
+{
+    QList<CategoryInfo> infos;
+    infos.reserve(m_categoryNames.size());
+    for (qsizetype id = 0; id < m_categoryNames.size(); ++id) {
+        const QList<quint32> &channels = m_categoryChannels[id];
+        if (channels.isEmpty())
+            continue;
+        infos.append({m_categoryNames[id], quint32(id), quint32(channels.size()), channels.first(), channels.last()});
+    }
+    std::sort(infos.begin(), infos.end(),
+              [](const CategoryInfo &a, const CategoryInfo &b) { return a.name < b.name; });
+    return infos;
+}
+
+size_t ChannelStore::identityKey(quint32 channel) const
+{
+    const QByteArrayView id = tvgId(channel);
+    return qHashMulti(0, field(channel, UrlField), id.isEmpty() ? field(channel, NameField) : id);
+}
+
+size_t ChannelStore::contentKey(quint32 channel) const
+{
+    return qHashMulti(0, field(channel, UrlField), field(channel, NameField), tvgId(channel), logo(channel),
+                      m_categoryNames.value(m_categoryIds[channel]));
+}
+
+qsizetype ChannelStore::memoryUsage() const
+{
+    qsizetype bytes = m_arena.capacity() + m_fieldOffsets.capacityBytes() + m_categoryIds.capacityBytes();
+    for (const QString &name : m_categoryNames)
+        bytes += name.capacity() * qsizetype(sizeof(QChar));
+    for (const QList<quint32> &channels : m_categoryChannels)
+        bytes += channels.capacity() * qsizetype(sizeof(quint32));
+    return bytes;
+}
+
+bool ChannelStore::assign(const QByteArray &arena, const QByteArray &fieldOffsets, const QByteArray &categoryIds,
+                          const QStringList &categoryNames, std::shared_ptr<const void> keepAlive)
+{
+    if (fieldOffsets.size() % qsizetype(sizeof(quint32)) != 0
+        || categoryIds.size() % qsizetype(sizeof(quint32)) != 0)
+        return false;
+
+    const PodArray<quint32> offsets(fieldOffsets);
+    const PodArray<quint32> ids(categoryIds);
+    const qsizetype channels = ids.size();
+    if (channels == 0 ? offsets.size() > 1 : offsets.size() != channels * FieldCount + 1)
+        return false;
+    if (categoryNames.size() != QSet<QString>(categoryNames.cbegin(), categoryNames.cend()).size())
+        return false;
+
+    // Offsets are trusted by field(), so check them once here
+    quint32 previous = 0;
+    for (quint32 offset : offsets) {
+        if (offset < previous)
+            return false;
+        previous = offset;
+    }
+    if (!offsets.isEmpty() && (offsets[0] != 0 || previous != quint32(arena.size())))
+        return false;
+
+    QList<QList<quint32>> categoryChannels(categoryNames.size());
+    for (qsizetype channel = 0; channel < channels; ++channel) {
+        const quint32 id = ids[channel];
+        if (id >= quint32(categoryNames.size()))
+            return false;
+        categoryChannels[id].append(quint32(channel));
+    }
+
+    m_arena = arena;
+    m_fieldOffsets = offsets;
+    m_categoryIds = ids;
+    m_categoryNames = categoryNames;
+    m_categoryLookup.clear();
+    for (qsizetype id = 0; id < categoryNames.size(); ++id)
+        m_categoryLookup.insert(categoryNames[id], id);
+    m_categoryChannels = std::move(categoryChannels);
+    m_keepAlive = std::move(keepAlive);
+    return true;
+}
@@ -0,0 +1,141 @@
+#ifndef CHANNELSTORE_H
+#define CHANNELSTORE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <QUrl>
+#include <memory>
+#include <type_traits>
+
+// Growable array of trivially copyable values kept in a QByteArray, so the
+// same type can also wrap memory it does not own (a mapped cache file).
+template <typename T>
+class PodArray
+{
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    PodArray() = default;
+    explicit PodArray(const QByteArray &bytes) : m_bytes(bytes) {}
+
+    qsizetype size() const { return m_bytes.size() / qsizetype(sizeof(T)); }
+    bool isEmpty() const { return m_bytes.isEmpty(); }
+    const T *constData() const { return reinterpret_cast<const T *>(m_bytes.constData()); }
+    const T &operator[](qsizetype i) const { return constData()[i]; }
+    const T *begin() const { return constData(); }
+    const T *end() const { return constData() + size(); }
+
+    void append(T value) { m_bytes.append(reinterpret_cast<const char *>(&value), sizeof(T)); }
+    void reserve(qsizetype count) { m_bytes.reserve(count * qsizetype(sizeof(T))); }
+    void clear() { m_bytes.clear(); }
+
+    const QByteArray &bytes() const { return m_bytes; }
+    qsizetype capacityBytes() const { return m_bytes.capacity(); }
+
+private:
+    QByteArray m_bytes;
+};
+
+// A category as listed for the user
+struct CategoryInfo {
+    QString name;
+    quint32 id;
+    quint32 count;
+    // Lowest and highest channel index in the category
+    quint32 firstChannel;
+    quint32 lastChannel;
+};
+
+// Struct-of-arrays storage for a parsed playlist. The text of all channels
+// lives in one UTF-8 arena, laid out channel by channel as consecutive
+// fields; m_fieldOffsets has FieldCount entries per channel plus a final
+// end offset. Categories are stored once and referenced by id. Nothing is
+// decoded until a caller asks for a QString or QUrl.
+class ChannelStore
+{
+public:
+    enum Field {
+        NameField,
+        UrlField,
+        TvgIdField,
+        LogoField,
+        FieldCount
+    };
+
+    qsizetype size() const { return m_categoryIds.size(); }
+    bool isEmpty() const { return m_categoryIds.isEmpty(); }
+
+    // Returns the id of the category, adding it if it is new
+    quint32 addCategory(const QString &name);
+    // Returns the index of the new channel
+    quint32 add(QByteArrayView name, QByteArrayView url, QByteArrayView tvgId, QByteArrayView logo,
+                quint32 categoryId);
+    // Appends channels first..end-1 of other. Its categories are matched by
+    // name, so the two stores' ids need not agree.
+    void append(const ChannelStore &other, quint32 first, quint32 end);
+
+    QByteArrayView field(quint32 channel, Field field) const;
+    QString name(quint32 channel) const { return QString::fromUtf8(field(channel, NameField)); }
+    QUrl url(quint32 channel) const { return QUrl(QString::fromUtf8(field(channel, UrlField))); }
+    QByteArrayView tvgId(quint32 channel) const { return field(channel, TvgIdField); }
+    QByteArrayView logo(quint32 channel) const { return field(channel, LogoField); }
+    quint32 categoryId(quint32 channel) const { return m_categoryIds[channel]; }
+
+    // x-tvg-url of the playlist header, possibly several comma-separated URLs
+    const QByteArray &epgUrl() const { return m_epgUrl; }
+    void setEpgUrl(const QByteArray &url) { m_epgUrl = url; }
+
+    qsizetype categoryCount() const { return m_categoryNames.size(); }
+    QString categoryName(quint32 id) const { return m_categoryNames.value(id); }
+    const QStringList &categoryNames() const { return m_categoryNames; }
+    // -1 if there is no such category
+    int findCategory(const QString &name) const { return int(m_categoryLookup.value(name, -1)); }
+    // Channel indices of a category, ascending
+    QList<quint32> channelsInCategory(quint32 id) const { return m_categoryChannels.value(id); }
+    // Every non-empty category with its count and range, sorted by name.
+    // The per-category lists are filled as channels are added, so this
+    // costs a sort of the names, not a pass over the channels.
+    QList<CategoryInfo> categoryInfos() const;
+    // The channels whose name contains query (case-insensitive), in order;
+    // all of them for an empty query
+    QList<quint32> filterByName(const QList<quint32> &channels, const QString &query) const;
+
+    // Identifies a channel across reloads of the playlist: URL plus tvg-id,
+    // or plus name for channels without one
+    size_t identityKey(quint32 channel) const;
+    // Changes whenever anything the model shows for the channel changes
+    size_t contentKey(quint32 channel) const;
+
+    // Approximate heap footprint, for the bytes-per-channel readout
+    qsizetype memoryUsage() const;
+
+    // The raw arrays, as written to PlaylistCache
+    const QByteArray &arena() const { return m_arena; }
+    const QByteArray &fieldOffsetBytes() const { return m_fieldOffsets.bytes(); }
+    const QByteArray &categoryIdBytes() const { return m_categoryIds.bytes(); }
+
+    // Replaces the contents with arrays in the layout above, typically
+    // QByteArray::fromRawData() views of a mapped file that keepAlive owns.
+    // Returns false (leaving the store untouched) if they are inconsistent.
+    bool assign(const QByteArray &arena, const QByteArray &fieldOffsets, const QByteArray &categoryIds,
+                const QStringList &categoryNames, std::shared_ptr<const void> keepAlive = {});
+
+private:
+    QByteArray m_arena;
+    PodArray<quint32> m_fieldOffsets;
+    PodArray<quint32> m_categoryIds;
+
+    QStringList m_categoryNames;
+    QHash<QString, qint64> m_categoryLookup;
+    QList<QList<quint32>> m_categoryChannels;
+    QByteArray m_epgUrl;
+
+    // Owner of memory the arrays above point into without owning it
+    std::shared_ptr<const void> m_keepAlive;
+};
+
+#endif // CHANNELSTORE_H
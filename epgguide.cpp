@@ -0,0 +1,124 @@
+#include "epgguide.h"
+#include "channelsearchindex.h"
+#include <algorithm>
+
+namespace {
+
+quint32 toStoredTime(qint64 seconds)
+{
+    return quint32(std::clamp<qint64>(seconds, 0, 0xFFFFFFFFll));
+}
+
+} // namespace
+
+quint32 EpgGuide::Builder::channel(QStringView id)
+{
+    const QString key = id.toString();
+    const auto it = m_ids.constFind(key);
+    if (it != m_ids.cend())
+        return it.value();
+    const quint32 index = quint32(m_ids.size());
+    m_ids.insert(key, index);
+    return index;
+}
+
+void EpgGuide::Builder::addDisplayName(quint32 channel, QStringView name)
+{
+    const QString folded = ChannelSearchIndex::fold(name.toString());
+    if (!folded.isEmpty() && !m_names.contains(folded))
+        m_names.insert(folded, channel);
+}
+
+void EpgGuide::Builder::addProgramme(quint32 channel, qint64 start, qint64 stop, QStringView title)
+{
+    // Series repeat their titles all week, store each one once
+    const QByteArray utf8 = title.toUtf8();
+    auto it = m_titleIds.constFind(utf8);
+    if (it == m_titleIds.cend()) {
+        m_titles.append(utf8);
+        m_titleOffsets.push_back(quint32(m_titles.size()));
+        it = m_titleIds.insert(utf8, quint32(m_titleOffsets.size() - 2));
+    }
+    m_programmes.push_back({channel, toStoredTime(start), stop > 0 ? toStoredTime(stop) : 0, it.value()});
+}
+
+EpgGuide EpgGuide::Builder::build()
+{
+    std::sort(m_programmes.begin(), m_programmes.end(), [](const Pending &a, const Pending &b) {
+        return a.channel != b.channel ? a.channel < b.channel : a.start < b.start;
+    });
+
+    EpgGuide guide;
+    const quint32 channelCount = quint32(m_ids.size());
+    guide.m_offsets.assign(channelCount + 1, 0);
+    guide.m_programmes.reserve(m_programmes.size());
+    for (size_t i = 0; i < m_programmes.size(); ++i) {
+        const Pending &p = m_programmes[i];
+        // Feeds repeat programmes when several sources are merged
+        if (!guide.m_programmes.empty() && i > 0 && m_programmes[i - 1].channel == p.channel
+            && guide.m_programmes.back().start == p.start)
+            continue;
+
+        quint32 stop = p.stop;
+        if (stop <= p.start) {
+            // Missing stop time: runs until the next programme of the channel
+            const bool hasNext = i + 1 < m_programmes.size() && m_programmes[i + 1].channel == p.channel;
+            stop = hasNext ? m_programmes[i + 1].start : p.start;
+        }
+        guide.m_programmes.push_back({p.start, stop, p.title});
+        ++guide.m_offsets[p.channel + 1];
+    }
+    for (quint32 c = 0; c < channelCount; ++c)
+        guide.m_offsets[c + 1] += guide.m_offsets[c];
+
+    guide.m_ids = std::move(m_ids);
+    guide.m_names = std::move(m_names);
+    guide.m_titleOffsets = std::move(m_titleOffsets);
+    guide.m_titles = std::move(m_titles);
+
+    *this = Builder();
+    return guide;
+}
+
+int EpgGuide::findChannel(QByteArrayView tvgId, const QString &name) const
+{
+    if (!tvgId.isEmpty()) {
+        const auto it = m_ids.constFind(QString::fromUtf8(tvgId));
+        if (it != m_ids.cend())
+            return int(it.value());
+    }
+    const auto it = m_names.constFind(ChannelSearchIndex::fold(name));
+    return it != m_names.cend() ? int(it.value()) : -1;
+}
+
+QString EpgGuide::title(quint32 id) const
+{
+    const quint32 begin = m_titleOffsets[id];
+    return QString::fromUtf8(m_titles.constData() + begin, m_titleOffsets[id + 1] - begin);
+}
+
+EpgGuide::NowNext EpgGuide::nowNext(quint32 channel, qint64 now) const
+{
+    NowNext result;
+    if (channel + 1 >= m_offsets.size())
+        return result;
+
+    const auto begin = m_programmes.cbegin() + m_offsets[channel];
+    const auto end = m_programmes.cbegin() + m_offsets[channel + 1];
+    const quint32 t = toStoredTime(now);
+
+    // First programme that starts after now; the one before it may be running
+    const auto next = std::upper_bound(begin, end, t, [](quint32 time, const Programme &p) {
+        return time < p.start;
+    });
+    if (next != begin) {
+        const Programme &current = *(next - 1);
+        if (t < current.stop) {
+            result.nowTitle = title(current.title);
+            result.progress = qreal(t - current.start) / qreal(current.stop - current.start);
+        }
+    }
+    if (next != end)
+        result.nextTitle = title(next->title);
+    return result;
+}
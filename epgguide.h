@@ -0,0 +1,78 @@
+#ifndef EPGGUIDE_H
+#define EPGGUIDE_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QString>
+#include <vector>
+
+// Programme guide built from XMLTV. Programmes of all channels live in one
+// array, grouped by channel and sorted by start time, with an offset table
+// per channel (CSR layout); titles are deduplicated into a UTF-8 arena. A
+// now/next lookup is one binary search within a channel's range.
+class EpgGuide
+{
+public:
+    struct NowNext {
+        QString nowTitle;
+        QString nextTitle;
+        qreal progress = -1; // of the current programme, 0..1; -1 if none
+    };
+
+    // Collects channels and programmes in whatever order the feed has them
+    class Builder
+    {
+    public:
+        // Index of the XMLTV channel id, adding it on first sight
+        quint32 channel(QStringView id);
+        void addDisplayName(quint32 channel, QStringView name);
+        // Times in seconds since the epoch; stop <= 0 means "until the next one"
+        void addProgramme(quint32 channel, qint64 start, qint64 stop, QStringView title);
+
+        qsizetype programmeCount() const { return qsizetype(m_programmes.size()); }
+        EpgGuide build();
+
+    private:
+        struct Pending {
+            quint32 channel;
+            quint32 start;
+            quint32 stop;
+            quint32 title;
+        };
+
+        QHash<QString, quint32> m_ids;
+        QHash<QString, quint32> m_names; // folded display names
+        std::vector<Pending> m_programmes;
+        QHash<QByteArray, quint32> m_titleIds;
+        std::vector<quint32> m_titleOffsets{0};
+        QByteArray m_titles;
+    };
+
+    bool isEmpty() const { return m_programmes.empty(); }
+    qsizetype programmeCount() const { return qsizetype(m_programmes.size()); }
+
+    // Guide channel for a playlist entry: by tvg-id, else by display name.
+    // -1 if the guide does not know the channel.
+    int findChannel(QByteArrayView tvgId, const QString &name) const;
+
+    NowNext nowNext(quint32 channel, qint64 now) const;
+
+private:
+    struct Programme {
+        quint32 start;
+        quint32 stop;
+        quint32 title;
+    };
+
+    QString title(quint32 id) const;
+
+    QHash<QString, quint32> m_ids;
+    QHash<QString, quint32> m_names;
+    std::vector<quint32> m_offsets; // channel count + 1 offsets into m_programmes
+    std::vector<Programme> m_programmes;
+    std::vector<quint32> m_titleOffsets; // title count + 1 offsets into m_titles
+    QByteArray m_titles;
+};
+
+#endif // EPGGUIDE_H
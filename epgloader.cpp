@@ -0,0 +1,230 @@
+#include "epgloader.h"
+#include "gzipdecoder.h"
+#include "xmltvparser.h"
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QFutureWatcher>
+#include <QNetworkRequest>
+#include <QPromise>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <QUrl>
+#include <utility>
+
+namespace {
+
+// Guides cover a week or so and are regenerated daily by most providers
+constexpr qint64 kMaxCacheAgeSecs = 6 * 3600;
+constexpr qint64 kReadChunkSize = 1 << 20;
+
+} // namespace
+
+EpgLoader::EpgLoader(QNetworkAccessManager *network, QObject *parent)
+    : QObject(parent)
+    , m_network(network)
+{
+}
+
+EpgLoader::~EpgLoader()
+{
+    cancel();
+}
+
+QString EpgLoader::cachePath(const QString &url)
+{
+    const QString dir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/epg";
+    const QByteArray key = QCryptographicHash::hash(url.toUtf8(), QCryptographicHash::Sha1).toHex();
+    return dir + "/" + QString::fromLatin1(key) + ".xmltv";
+}
+
+void EpgLoader::load(const QStringList &sources)
+{
+    cancel();
+    m_pending = sources;
+    m_files.clear();
+    fetchNext();
+}
+
+void EpgLoader::cancel()
+{
+    ++m_generation;
+    m_pending.clear();
+    if (m_reply) {
+        m_reply->disconnect(this);
+        m_reply->abort();
+        m_reply->deleteLater();
+        m_reply = nullptr;
+    }
+    m_download.reset();
+    m_parseFuture.cancel();
+    m_parseFuture = QFuture<EpgGuide>();
+}
+
+EpgGuide EpgLoader::takeGuide()
+{
+    return std::exchange(m_guide, EpgGuide());
+}
+
+void EpgLoader::fetchNext()
+{
+    while (!m_pending.isEmpty()) {
+        const QString source = m_pending.takeFirst().trimmed();
+        const QUrl url(source);
+        if (url.scheme() != "http" && url.scheme() != "https") {
+            const QString localPath = url.toLocalFile();
+            m_files.append(localPath.isEmpty() ? source : localPath);
+            continue;
+        }
+
+        const QString path = cachePath(source);
+        const QFileInfo cached(path);
+        if (cached.exists()
+            && cached.lastModified().secsTo(QDateTime::currentDateTime()) < kMaxCacheAgeSecs) {
+            m_files.append(path);
+            continue;
+        }
+
+        QDir().mkpath(cached.absolutePath());
+        m_download = std::make_unique<QSaveFile>(path);
+        if (!m_download->open(QIODevice::WriteOnly)) {
+            qWarning() << "Could not write EPG cache:" << m_download->errorString();
+            m_download.reset();
+            continue;
+        }
+
+        QNetworkRequest request(url);
+        request.setRawHeader("User-Agent", "IPTV Player");
+        m_reply = m_network->get(request);
+        m_reply->setProperty("epgPath", path);
+        // Written to disk as it arrives, the feed is never held in memory
+        connect(m_reply, &QIODevice::readyRead, this, [this]() {
+            m_download->write(m_reply->readAll());
+        });
+        connect(m_reply, &QNetworkReply::finished, this, &EpgLoader::onDownloadFinished);
+        return;
+    }
+
+    if (m_files.isEmpty())
+        emit failed(QStringLiteral("No EPG source"));
+    else
+        parseInBackground();
+}
+
+void EpgLoader::onDownloadFinished()
+{
+    QNetworkReply *reply = m_reply;
+    m_reply = nullptr;
+    reply->deleteLater();
+
+    const QString path = reply->property("epgPath").toString();
+    if (reply->error() != QNetworkReply::NoError) {
+        qWarning() << "Could not download EPG:" << reply->errorString();
+        m_download->cancelWriting();
+        m_download.reset();
+        // A stale copy is better than no guide
+        if (QFile::exists(path))
+            m_files.append(path);
+    } else {
+        m_download->write(reply->readAll());
+        if (m_download->commit())
+            m_files.append(path);
+        else
+            qWarning() << "Could not write EPG cache:" << m_download->errorString();
+        m_download.reset();
+    }
+    fetchNext();
+}
+
+void EpgLoader::parseInBackground()
+{
+    const quint64 generation = m_generation;
+    auto promise = std::make_shared<QPromise<EpgGuide>>();
+    m_parseFuture = promise->future();
+    auto errorMessage = std::make_shared<QString>();
+
+    auto *watcher = new QFutureWatcher<EpgGuide>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation, errorMessage]() {
+        watcher->deleteLater();
+        QFuture<EpgGuide> future = watcher->future();
+        if (generation != m_generation || future.isCanceled() || future.resultCount() == 0)
+            return;
+        m_parseFuture = QFuture<EpgGuide>();
+        m_guide = future.takeResult();
+        if (m_guide.isEmpty() && !errorMessage->isEmpty())
+            emit failed(*errorMessage);
+        else
+            emit finished();
+    });
+    watcher->setFuture(m_parseFuture);
+
+    QThreadPool::globalInstance()->start([promise, errorMessage, files = m_files]() {
+        promise->start();
+        EpgGuide guide = parseFiles(files, [&promise]() { return promise->isCanceled(); }, errorMessage.get());
+        if (!promise->isCanceled())
+            promise->addResult(std::move(guide));
+        promise->finish();
+    });
+}
+
+EpgGuide EpgLoader::parseFiles(const QStringList &paths, const std::function<bool()> &isCanceled,
+                               QString *errorMessage)
+{
+    EpgGuide::Builder builder;
+    for (const QString &path : paths) {
+        QFile file(path);
+        if (!file.open(QIODevice::ReadOnly)) {
+            *errorMessage = QString("EPG faylini ochib bo'lmadi: %1").arg(path);
+            continue;
+        }
+
+        // A parser per file: every feed is a document of its own
+        XmltvParser parser(&builder);
+        std::unique_ptr<GzipDecoder> decoder;
+        QString error;
+        bool ok = true;
+        bool first = true;
+        while (ok && !file.atEnd()) {
+            if (isCanceled && isCanceled())
+                return EpgGuide();
+            QByteArray chunk = file.read(kReadChunkSize);
+            if (first) {
+                first = false;
+                if (GzipDecoder::isGzip(chunk))
+                    decoder = std::make_unique<GzipDecoder>();
+            }
+            if (decoder) {
+                QByteArray inflated;
+                if (!decoder->decode(chunk, inflated)) {
+                    error = decoder->errorString();
+                    ok = false;
+                    break;
+                }
+                chunk = std::move(inflated);
+            }
+            ok = parser.feed(chunk);
+        }
+        if (ok && decoder) {
+            QByteArray inflated;
+            if (decoder->finish(inflated)) {
+                ok = parser.feed(inflated);
+            } else {
+                error = decoder->errorString();
+                ok = false;
+            }
+        }
+        if (ok)
+            ok = parser.finish();
+        if (!ok) {
+            // Whatever was read before the error is kept
+            if (error.isEmpty())
+                error = parser.errorString();
+            qWarning() << "EPG parse error in" << path << ":" << error;
+            *errorMessage = error;
+        }
+    }
+    return builder.build();
+}
@@ -0,0 +1,60 @@
+#ifndef EPGLOADER_H
+#define EPGLOADER_H
+
+#include <QFuture>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QSaveFile>
+#include <QStringList>
+#include <functional>
+#include <memory>
+#include "epgguide.h"
+
+// Fetches the XMLTV feeds of a playlist (x-tvg-url) and builds an EpgGuide.
+// Downloads are streamed to files under the cache location, which are reused
+// for a few hours, and parsed chunk by chunk on a worker thread, so a
+// 100+ MB feed (plain or gzipped) never has to fit in memory as a whole.
+class EpgLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit EpgLoader(QNetworkAccessManager *network, QObject *parent = nullptr);
+    ~EpgLoader() override;
+
+    // Cancels whatever is in progress. Sources are URLs or local paths.
+    void load(const QStringList &sources);
+    void cancel();
+
+    // The guide after finished()
+    EpgGuide takeGuide();
+
+    static QString cachePath(const QString &url);
+
+    // Thread-safe. Reads the given XMLTV files (gzip or plain) into a guide;
+    // isCanceled is polled between chunks.
+    static EpgGuide parseFiles(const QStringList &paths, const std::function<bool()> &isCanceled,
+                               QString *errorMessage);
+
+signals:
+    void finished();
+    void failed(const QString &errorMessage);
+
+private:
+    void fetchNext();
+    void onDownloadFinished();
+    void parseInBackground();
+
+    QNetworkAccessManager *m_network;
+    quint64 m_generation = 0;
+    QStringList m_pending; // sources still to fetch
+    QStringList m_files;   // local files to parse
+    QPointer<QNetworkReply> m_reply;
+    std::unique_ptr<QSaveFile> m_download;
+    QFuture<EpgGuide> m_parseFuture;
+    EpgGuide m_guide;
+};
+
+#endif // EPGLOADER_H
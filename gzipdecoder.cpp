@@ -0,0 +1,117 @@
+#include "gzipdecoder.h"
+
+#ifdef IPTV_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+struct GzipDecoder::Private {
+#ifdef IPTV_HAVE_ZLIB
+    z_stream stream = {};
+    bool initialized = false;
+    bool ended = false; // the last member is complete
+#endif
+    QString error;
+};
+
+GzipDecoder::GzipDecoder()
+    : d(std::make_unique<Private>())
+{
+#ifdef IPTV_HAVE_ZLIB
+    // 32 + MAX_WBITS lets zlib detect gzip and zlib headers automatically
+    d->initialized = inflateInit2(&d->stream, 32 + MAX_WBITS) == Z_OK;
+    if (!d->initialized)
+        d->error = QStringLiteral("zlib initialisation failed");
+#else
+    d->error = QStringLiteral("Built without zlib support");
+#endif
+}
+
+GzipDecoder::~GzipDecoder()
+{
+#ifdef IPTV_HAVE_ZLIB
+    if (d->initialized)
+        inflateEnd(&d->stream);
+#endif
+}
+
+bool GzipDecoder::isAvailable()
+{
+#ifdef IPTV_HAVE_ZLIB
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool GzipDecoder::isGzip(QByteArrayView head)
+{
+    return head.size() >= 2 && uchar(head[0]) == 0x1f && uchar(head[1]) == 0x8b;
+}
+
+QString GzipDecoder::errorString() const
+{
+    return d->error;
+}
+
+bool GzipDecoder::decode(QByteArrayView input, QByteArray &output)
+{
+#ifdef IPTV_HAVE_ZLIB
+    if (!d->initialized)
+        return false;
+
+    constexpr qsizetype chunkSize = 64 * 1024;
+    d->stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(input.data()));
+    d->stream.avail_in = uInt(input.size());
+
+    // Also goes round while the output space was used up: zlib may still
+    // hold inflated data after taking in all of the input
+    do {
+        const qsizetype oldSize = output.size();
+        output.resize(oldSize + chunkSize);
+        d->stream.next_out = reinterpret_cast<Bytef *>(output.data() + oldSize);
+        d->stream.avail_out = uInt(chunkSize);
+
+        const int ret = inflate(&d->stream, Z_NO_FLUSH);
+        output.resize(oldSize + chunkSize - d->stream.avail_out);
+
+        if (ret == Z_STREAM_END) {
+            d->ended = true;
+            // Another gzip member may follow
+            if (d->stream.avail_in > 0) {
+                if (inflateReset(&d->stream) != Z_OK) {
+                    d->error = QStringLiteral("zlib reset failed");
+                    return false;
+                }
+                d->ended = false;
+            }
+        } else if (ret == Z_BUF_ERROR) {
+            // No progress possible: the input is used up and nothing is
+            // held back
+            break;
+        } else if (ret != Z_OK) {
+            d->error = QString::fromLatin1(d->stream.msg ? d->stream.msg : "corrupt compressed data");
+            return false;
+        }
+    } while (d->stream.avail_in > 0 || d->stream.avail_out == 0);
+    return true;
+#else
+    Q_UNUSED(input);
+    Q_UNUSED(output);
+    return false;
+#endif
+}
+
+bool GzipDecoder::finish(QByteArray &output)
+{
+    if (!decode(QByteArrayView(), output))
+        return false;
+#ifdef IPTV_HAVE_ZLIB
+    if (!d->ended) {
+        d->error = QStringLiteral("truncated compressed data");
+        return false;
+    }
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,36 @@
+#ifndef GZIPDECODER_H
+#define GZIPDECODER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QString>
+#include <memory>
+
+// Incremental gzip/zlib inflater for bodies that arrive compressed even after
+// QNetworkAccessManager has dealt with Content-Encoding (.m3u.gz / .xml.gz
+// files served as application/gzip). Needs zlib at build time; without it
+// isAvailable() is false and decode() always fails.
+class GzipDecoder
+{
+public:
+    GzipDecoder();
+    ~GzipDecoder();
+
+    static bool isAvailable();
+    // True if the data starts with the gzip magic bytes
+    static bool isGzip(QByteArrayView head);
+
+    // Inflates the next chunk and appends the result to output. Concatenated
+    // gzip members are decoded one after another. Returns false on corrupt input.
+    bool decode(QByteArrayView input, QByteArray &output);
+    // Appends whatever is still held back once the input has ended. Returns
+    // false if the last gzip member was cut short.
+    bool finish(QByteArray &output);
+    QString errorString() const;
+
+private:
+    struct Private;
+    std::unique_ptr<Private> d;
+};
+
+#endif // GZIPDECODER_H
@@ -0,0 +1,83 @@
+#ifndef LOCKFREERING_H
+#define LOCKFREERING_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstddef>
+#include <type_traits>
+
+// Bounded multi-producer queue without locks (Vyukov's sequence-per-slot
+// scheme). push() never blocks or allocates: when the ring is full the value
+// is dropped and counted instead. pop() is meant for a single consumer.
+template <typename T, size_t Capacity>
+class LockFreeRing
+{
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable_v<T>);
+
+public:
+    LockFreeRing()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    bool push(const T &value)
+    {
+        size_t position = m_head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[position & (Capacity - 1)];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(position);
+            if (diff == 0) {
+                if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.value = value;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    bool pop(T *value)
+    {
+        size_t position = m_tail.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot &slot = m_slots[position & (Capacity - 1)];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = std::ptrdiff_t(sequence) - std::ptrdiff_t(position + 1);
+            if (diff == 0) {
+                if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    *value = slot.value;
+                    slot.sequence.store(position + Capacity, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false; // empty, or the next slot is still being written
+            } else {
+                position = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    quint64 dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    // Producers and the consumer each get their own cache line
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+    alignas(64) std::atomic<quint64> m_dropped{0};
+    Slot m_slots[Capacity];
+};
+
+#endif // LOCKFREERING_H
@@ -0,0 +1,403 @@
+#include "logoprovider.h"
+#include <QBuffer>
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUrl>
+
+namespace {
+
+constexpr int kMaxActive = 12;
+constexpr int kPerHost = 4;
+constexpr qsizetype kMemoryBytes = 32 * 1024 * 1024;
+constexpr int kDefaultSize = 64;
+
+QString cacheKey(const QUrl &url, const QSize &size)
+{
+    return QString("%1@%2x%3").arg(url.toString()).arg(size.width()).arg(size.height());
+}
+
+QImage decodeThumbnail(const QByteArray &data, const QSize &size)
+{
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+
+    // Let the decoder scale down (JPEG does it almost for free) instead of
+    // decoding the full image and scaling afterwards
+    const QSize original = reader.size();
+    if (original.isValid() && (original.width() > size.width() || original.height() > size.height()))
+        reader.setScaledSize(original.scaled(size, Qt::KeepAspectRatio));
+
+    QImage image = reader.read();
+    if (image.isNull())
+        return image;
+    if (image.width() > size.width() || image.height() > size.height())
+        image = image.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation);
+    return image.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+}
+
+} // namespace
+
+void LogoJob::deliver(const QImage &image, const QString &error)
+{
+    QMutexLocker locker(&mutex);
+    if (response) {
+        response->complete(image, error);
+        response = nullptr;
+    }
+}
+
+LogoLoader::LogoLoader(QObject *parent)
+    : QObject(parent)
+    , m_memory(kMemoryBytes)
+    , m_network(new QNetworkAccessManager(this))
+{
+    m_ioPool.setMaxThreadCount(2);
+}
+
+LogoLoader::~LogoLoader()
+{
+    // Workers post their results back to this object
+    m_ioPool.clear();
+    m_ioPool.waitForDone();
+}
+
+QString LogoLoader::diskDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/logos";
+}
+
+QString LogoLoader::objectPath(const QByteArray &contentHash)
+{
+    const QString hex = QString::fromLatin1(contentHash.toHex());
+    return diskDirectory() + "/objects/" + hex.left(2) + "/" + hex;
+}
+
+QString LogoLoader::urlIndexPath(const QUrl &url)
+{
+    const QByteArray key = QCryptographicHash::hash(url.toEncoded(), QCryptographicHash::Sha1).toHex();
+    return diskDirectory() + "/urls/" + QString::fromLatin1(key);
+}
+
+bool LogoLoader::cached(const QString &key, QImage *image)
+{
+    QMutexLocker locker(&m_memoryMutex);
+    if (const QImage *hit = m_memory.object(key)) {
+        *image = *hit;
+        return true;
+    }
+    return false;
+}
+
+void LogoLoader::request(const std::shared_ptr<LogoJob> &job)
+{
+    QMetaObject::invokeMethod(this, [this, job]() { enqueue(job); }, Qt::QueuedConnection);
+}
+
+void LogoLoader::cancel(const std::shared_ptr<LogoJob> &job)
+{
+    QMetaObject::invokeMethod(this, [this, job]() { dequeue(job); }, Qt::QueuedConnection);
+}
+
+void LogoLoader::enqueue(const std::shared_ptr<LogoJob> &job)
+{
+    const QString urlKey = job->url.toString();
+    if (m_failed.contains(urlKey)) {
+        job->deliver(QImage(), QStringLiteral("Logo unavailable"));
+        return;
+    }
+    // Decoded for another request while this one was on its way
+    QImage image;
+    if (cached(job->key, &image)) {
+        job->deliver(image, QString());
+        return;
+    }
+
+    const bool isNew = !m_pending.contains(urlKey);
+    Pending &pending = m_pending[urlKey];
+    pending.jobs.append(job);
+    if (isNew) {
+        pending.url = job->url;
+        loadFromDisk(urlKey);
+    } else if (pending.state == State::Queued) {
+        // Asked for again: it is on screen now, move it to the front
+        QList<QString> &queue = m_hostQueues[pending.url.host()];
+        queue.removeOne(urlKey);
+        queue.append(urlKey);
+    }
+}
+
+void LogoLoader::dequeue(const std::shared_ptr<LogoJob> &job)
+{
+    const QString urlKey = job->url.toString();
+    const auto it = m_pending.find(urlKey);
+    if (it == m_pending.end())
+        return;
+    it->jobs.removeOne(job);
+    if (!it->jobs.isEmpty())
+        return;
+
+    // Nobody is waiting for this logo any more
+    switch (it->state) {
+    case State::Queued:
+        m_hostQueues[it->url.host()].removeOne(urlKey);
+        m_pending.erase(it);
+        break;
+    case State::Downloading:
+        if (it->reply)
+            it->reply->abort();
+        break;
+    case State::Probing:
+    case State::Decoding:
+        // Finishes anyway; the result still lands in the caches
+        break;
+    }
+}
+
+void LogoLoader::loadFromDisk(const QString &urlKey)
+{
+    const QUrl url = m_pending.value(urlKey).url;
+    m_ioPool.start([this, urlKey, url]() {
+        QByteArray data;
+        QFile index(urlIndexPath(url));
+        if (index.open(QIODevice::ReadOnly)) {
+            QFile object(objectPath(QByteArray::fromHex(index.readAll().trimmed())));
+            if (object.open(QIODevice::ReadOnly))
+                data = object.readAll();
+        }
+        QMetaObject::invokeMethod(this, [this, urlKey, data]() {
+            if (data.isEmpty())
+                queueDownload(urlKey);
+            else
+                decode(urlKey, data, false);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LogoLoader::queueDownload(const QString &urlKey)
+{
+    const auto it = m_pending.find(urlKey);
+    if (it == m_pending.end())
+        return;
+    if (it->jobs.isEmpty()) {
+        m_pending.erase(it);
+        return;
+    }
+    it->state = State::Queued;
+    m_hostQueues[it->url.host()].append(urlKey);
+    pump();
+}
+
+void LogoLoader::pump()
+{
+    while (m_active < kMaxActive) {
+        // Newest request of any host with a free slot
+        QList<QString> *queue = nullptr;
+        QString host;
+        for (auto it = m_hostQueues.begin(); it != m_hostQueues.end(); ++it) {
+            if (!it->isEmpty() && m_activePerHost.value(it.key()) < kPerHost) {
+                queue = &it.value();
+                host = it.key();
+                break;
+            }
+        }
+        if (!queue)
+            return;
+
+        const QString urlKey = queue->takeLast();
+        Pending &pending = m_pending[urlKey];
+        QNetworkRequest request(pending.url);
+        request.setRawHeader("User-Agent", "IPTV Player");
+        QNetworkReply *reply = m_network->get(request);
+        // The slot belongs to this host even if the reply is redirected
+        connect(reply, &QNetworkReply::finished, this, [this, urlKey, host, reply]() {
+            onDownloadFinished(urlKey, host, reply);
+        });
+        pending.state = State::Downloading;
+        pending.reply = reply;
+        ++m_active;
+        ++m_activePerHost[host];
+    }
+}
+
+void LogoLoader::onDownloadFinished(const QString &urlKey, const QString &host, QNetworkReply *reply)
+{
+    reply->deleteLater();
+    --m_active;
+    if (--m_activePerHost[host] <= 0)
+        m_activePerHost.remove(host);
+
+    const auto it = m_pending.find(urlKey);
+    if (it != m_pending.end()) {
+        if (reply->error() == QNetworkReply::OperationCanceledError && it->jobs.isEmpty()) {
+            m_pending.erase(it);
+        } else if (reply->error() != QNetworkReply::NoError) {
+            fail(urlKey, reply->errorString());
+        } else {
+            it->state = State::Decoding;
+            decode(urlKey, reply->readAll(), true);
+        }
+    }
+    pump();
+}
+
+void LogoLoader::decode(const QString &urlKey, const QByteArray &data, bool store)
+{
+    Pending &pending = m_pending[urlKey];
+    pending.state = State::Decoding;
+    QList<QSize> sizes;
+    for (const auto &job : std::as_const(pending.jobs)) {
+        if (!sizes.contains(job->size))
+            sizes.append(job->size);
+    }
+    const QUrl url = pending.url;
+
+    m_ioPool.start([this, urlKey, url, data, store, sizes]() {
+        if (store) {
+            // Content-addressed: the same logo behind many URLs is stored once
+            const QByteArray hash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+            const QString path = objectPath(hash);
+            if (!QFile::exists(path)) {
+                QDir().mkpath(QFileInfo(path).absolutePath());
+                QSaveFile object(path);
+                if (object.open(QIODevice::WriteOnly)) {
+                    object.write(data);
+                    object.commit();
+                }
+            }
+            const QString indexPath = urlIndexPath(url);
+            QDir().mkpath(QFileInfo(indexPath).absolutePath());
+            QSaveFile index(indexPath);
+            if (index.open(QIODevice::WriteOnly)) {
+                index.write(hash.toHex());
+                index.commit();
+            }
+        }
+
+        QList<QImage> images;
+        for (const QSize &size : sizes)
+            images.append(decodeThumbnail(data, size));
+        QMetaObject::invokeMethod(this, [this, urlKey, data, images, sizes]() {
+            onDecoded(urlKey, data, images, sizes);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void LogoLoader::onDecoded(const QString &urlKey, const QByteArray &data, const QList<QImage> &images,
+                           const QList<QSize> &sizes)
+{
+    const auto it = m_pending.find(urlKey);
+    if (it == m_pending.end())
+        return;
+    if (!images.isEmpty() && images.first().isNull()) {
+        fail(urlKey, QStringLiteral("Unsupported image"));
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_memoryMutex);
+        for (qsizetype i = 0; i < sizes.size(); ++i)
+            m_memory.insert(cacheKey(it->url, sizes[i]), new QImage(images[i]), images[i].sizeInBytes());
+    }
+
+    // Requests for a size that was not decoded yet arrived in the meantime
+    QList<std::shared_ptr<LogoJob>> waiting;
+    for (const auto &job : std::as_const(it->jobs)) {
+        const qsizetype index = sizes.indexOf(job->size);
+        if (index >= 0)
+            job->deliver(images[index], QString());
+        else
+            waiting.append(job);
+    }
+    it->jobs = waiting;
+    if (waiting.isEmpty())
+        m_pending.erase(it);
+    else
+        decode(urlKey, data, false);
+}
+
+void LogoLoader::fail(const QString &urlKey, const QString &error)
+{
+    m_failed.insert(urlKey);
+    const auto it = m_pending.find(urlKey);
+    if (it == m_pending.end())
+        return;
+    for (const auto &job : std::as_const(it->jobs))
+        job->deliver(QImage(), error);
+    m_pending.erase(it);
+}
+
+LogoProvider::LogoProvider()
+    : m_loader(new LogoLoader)
+{
+}
+
+LogoProvider::~LogoProvider()
+{
+    delete m_loader;
+}
+
+QQuickImageResponse *LogoProvider::requestImageResponse(const QString &id, const QSize &requestedSize)
+{
+    auto job = std::make_shared<LogoJob>();
+    job->url = QUrl(QUrl::fromPercentEncoding(id.toUtf8()));
+    job->size = requestedSize.isEmpty() ? QSize(kDefaultSize, kDefaultSize) : requestedSize;
+    job->key = cacheKey(job->url, job->size);
+
+    auto *response = new LogoResponse(job, m_loader);
+    job->response = response;
+
+    QImage image;
+    if (m_loader->cached(job->key, &image)) {
+        // finished() must not fire before the engine has connected to it
+        QMetaObject::invokeMethod(response, [job, image]() { job->deliver(image, QString()); },
+                                  Qt::QueuedConnection);
+    } else {
+        m_loader->request(job);
+    }
+    return response;
+}
+
+LogoResponse::LogoResponse(std::shared_ptr<LogoJob> job, LogoLoader *loader)
+    : m_job(std::move(job))
+    , m_loader(loader)
+{
+}
+
+QQuickTextureFactory *LogoResponse::textureFactory() const
+{
+    return QQuickTextureFactory::textureFactoryForImage(m_image);
+}
+
+QString LogoResponse::errorString() const
+{
+    return m_error;
+}
+
+void LogoResponse::cancel()
+{
+    // The delegate was destroyed, typically scrolled out of view
+    {
+        QMutexLocker locker(&m_job->mutex);
+        if (!m_job->response)
+            return; // already delivered
+        m_job->response = nullptr;
+    }
+    m_loader->cancel(m_job);
+    emit finished();
+}
+
+void LogoResponse::complete(const QImage &image, const QString &error)
+{
+    m_image = image;
+    m_error = error;
+    emit finished();
+}
@@ -0,0 +1,123 @@
+#ifndef LOGOPROVIDER_H
+#define LOGOPROVIDER_H
+
+#include <QCache>
+#include <QHash>
+#include <QImage>
+#include <QMutex>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QQuickAsyncImageProvider>
+#include <QSet>
+#include <QThreadPool>
+#include <memory>
+
+class LogoResponse;
+
+// One request of the engine for a logo. Shared between the response, which
+// lives on the engine's image thread, and the loader on the GUI thread.
+struct LogoJob {
+    QString key; // url + requested size
+    QUrl url;
+    QSize size;
+
+    QMutex mutex;
+    LogoResponse *response = nullptr; // null once finished or cancelled
+
+    void deliver(const QImage &image, const QString &error);
+};
+
+// Fetches logos for LogoProvider. Everything but the memory cache is only
+// touched on the GUI thread.
+//
+// - Memory: decoded thumbnails in a QCache whose cost is their byte size
+// - Disk: original files stored under their SHA-1 (logos shared by many
+//   channels are kept once) plus a small url -> hash index
+// - Network: a queue per host, newest request first so the rows that just
+//   scrolled into view win, at most kPerHost downloads per host
+class LogoLoader : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit LogoLoader(QObject *parent = nullptr);
+    ~LogoLoader() override;
+
+    // Thread-safe
+    bool cached(const QString &key, QImage *image);
+    void request(const std::shared_ptr<LogoJob> &job);
+    void cancel(const std::shared_ptr<LogoJob> &job);
+
+private:
+    enum class State { Probing, Queued, Downloading, Decoding };
+
+    // All requests for one logo URL, whatever their size
+    struct Pending {
+        QUrl url;
+        State state = State::Probing;
+        QList<std::shared_ptr<LogoJob>> jobs;
+        QPointer<QNetworkReply> reply;
+    };
+
+    void enqueue(const std::shared_ptr<LogoJob> &job);
+    void dequeue(const std::shared_ptr<LogoJob> &job);
+    void loadFromDisk(const QString &urlKey);
+    void queueDownload(const QString &urlKey);
+    void pump();
+    void onDownloadFinished(const QString &urlKey, const QString &host, QNetworkReply *reply);
+    void decode(const QString &urlKey, const QByteArray &data, bool store);
+    void onDecoded(const QString &urlKey, const QByteArray &data, const QList<QImage> &images,
+                   const QList<QSize> &sizes);
+    void fail(const QString &urlKey, const QString &error);
+
+    static QString diskDirectory();
+    static QString objectPath(const QByteArray &contentHash);
+    static QString urlIndexPath(const QUrl &url);
+
+    QMutex m_memoryMutex;
+    QCache<QString, QImage> m_memory;
+
+    QNetworkAccessManager *m_network;
+    QThreadPool m_ioPool; // disk reads, writes and decoding
+    QHash<QString, Pending> m_pending; // by url
+    QHash<QString, QList<QString>> m_hostQueues;
+    QHash<QString, int> m_activePerHost;
+    int m_active = 0;
+    QSet<QString> m_failed; // not retried during this session
+};
+
+// image://logos/<percent-encoded logo URL>
+class LogoProvider : public QQuickAsyncImageProvider
+{
+public:
+    LogoProvider();
+    ~LogoProvider() override;
+
+    QQuickImageResponse *requestImageResponse(const QString &id, const QSize &requestedSize) override;
+
+private:
+    LogoLoader *m_loader;
+};
+
+class LogoResponse : public QQuickImageResponse
+{
+public:
+    LogoResponse(std::shared_ptr<LogoJob> job, LogoLoader *loader);
+
+    QQuickTextureFactory *textureFactory() const override;
+    QString errorString() const override;
+    void cancel() override;
+
+    // Called by LogoJob::deliver with the job's mutex held
+    void complete(const QImage &image, const QString &error);
+
+private:
+    std::shared_ptr<LogoJob> m_job;
+    LogoLoader *m_loader;
+    QImage m_image;
+    QString m_error;
+};
+
+#endif // LOGOPROVIDER_H
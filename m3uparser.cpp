@@ -0,0 +1,212 @@
+#include "m3uparser.h"
+#include <cstring>
+
+namespace {
+
+const QByteArrayView kUnknownName("Unknown Channel");
+
+// Length in bytes of the whitespace character QChar::isSpace() would accept
+// at the start of s, or 0. Covers ASCII plus the UTF-8 encodings of U+0085
+// and the Zs/Zl/Zp separators.
+qsizetype leadingSpace(QByteArrayView s)
+{
+    if (s.isEmpty())
+        return 0;
+    const auto b = reinterpret_cast<const uchar *>(s.data());
+    if (b[0] == ' ' || (b[0] >= '\t' && b[0] <= '\r'))
+        return 1;
+    if (b[0] < 0x80)
+        return 0;
+    if (s.size() >= 2 && b[0] == 0xC2 && (b[1] == 0x85 || b[1] == 0xA0))
+        return 2;
+    if (s.size() >= 3) {
+        if (b[0] == 0xE1 && b[1] == 0x9A && b[2] == 0x80)
+            return 3;
+        if (b[0] == 0xE2 && b[1] == 0x80
+            && ((b[2] >= 0x80 && b[2] <= 0x8A) || b[2] == 0xA8 || b[2] == 0xA9 || b[2] == 0xAF))
+            return 3;
+        if (b[0] == 0xE2 && b[1] == 0x81 && b[2] == 0x9F)
+            return 3;
+        if (b[0] == 0xE3 && b[1] == 0x80 && b[2] == 0x80)
+            return 3;
+    }
+    return 0;
+}
+
+qsizetype trailingSpace(QByteArrayView s)
+{
+    if (s.isEmpty())
+        return 0;
+    const uchar last = uchar(s.back());
+    if (last < 0x80)
+        return (last == ' ' || (last >= '\t' && last <= '\r')) ? 1 : 0;
+    // Multi-byte candidates end in a continuation byte; check the 2 and 3
+    // byte sequences ending here.
+    if (s.size() >= 2 && leadingSpace(s.last(2)) == 2)
+        return 2;
+    if (s.size() >= 3 && leadingSpace(s.last(3)) == 3)
+        return 3;
+    return 0;
+}
+
+} // namespace
+
+M3uParser::M3uParser() = default;
+
+M3uParser::M3uParser(QByteArrayView content)
+    : m_content(content)
+    , m_finished(true)
+{
+}
+
+void M3uParser::feed(QByteArrayView chunk)
+{
+    // Drop what has been consumed. The pending #EXTINF may live in that
+    // part of the buffer, so it gets its own copy first.
+    if (m_pos > 0) {
+        detachPendingState();
+        m_buffer.remove(0, m_pos);
+        m_consumed += m_pos;
+        m_pos = 0;
+    }
+    m_buffer.append(chunk.data(), chunk.size());
+    m_content = m_buffer;
+}
+
+void M3uParser::finish()
+{
+    m_finished = true;
+}
+
+void M3uParser::detachPendingState()
+{
+    const char *bufferBegin = m_buffer.constData();
+    const char *bufferEnd = bufferBegin + m_buffer.size();
+    const auto inBuffer = [=](QByteArrayView view) {
+        return view.data() && view.data() >= bufferBegin && view.data() + view.size() <= bufferEnd;
+    };
+
+    if (inBuffer(m_attributes)) {
+        const QByteArrayView oldAttributes = m_attributes;
+        m_pendingAttributes = oldAttributes.toByteArray();
+        m_attributes = m_pendingAttributes;
+
+        // Name and group-title are slices of the same #EXTINF line
+        const auto rebase = [&](QByteArrayView &view) {
+            if (view.data() >= oldAttributes.data()
+                && view.data() + view.size() <= oldAttributes.data() + oldAttributes.size())
+                view = m_attributes.sliced(view.data() - oldAttributes.data(), view.size());
+        };
+        if (inBuffer(m_name))
+            rebase(m_name);
+        if (inBuffer(m_category))
+            rebase(m_category);
+    }
+
+    // A #EXTGRP value comes from its own line
+    if (inBuffer(m_category)) {
+        m_pendingCategory = m_category.toByteArray();
+        m_category = m_pendingCategory;
+    }
+}
+
+QByteArrayView M3uParser::trimmed(QByteArrayView text)
+{
+    while (qsizetype n = leadingSpace(text))
+        text = text.sliced(n);
+    while (qsizetype n = trailingSpace(text))
+        text.chop(n);
+    return text;
+}
+
+QByteArrayView M3uParser::attribute(QByteArrayView extinf, QByteArrayView key)
+{
+    // Matches the old indexOf("key=\"") lookup: first occurrence wins and an
+    // unterminated value counts as missing.
+    qsizetype from = 0;
+    while (true) {
+        const qsizetype keyIndex = extinf.indexOf(key, from);
+        if (keyIndex == -1)
+            return {};
+        const qsizetype valueStart = keyIndex + key.size();
+        if (extinf.size() > valueStart + 1 && extinf[valueStart] == '=' && extinf[valueStart + 1] == '"') {
+            const qsizetype endQuote = extinf.indexOf('"', valueStart + 2);
+            if (endQuote == -1)
+                return {};
+            return extinf.sliced(valueStart + 2, endQuote - valueStart - 2);
+        }
+        from = keyIndex + 1;
+    }
+}
+
+bool M3uParser::nextLine(QByteArrayView &line)
+{
+    if (m_pos >= m_content.size())
+        return false;
+
+    const char *begin = m_content.data() + m_pos;
+    const qsizetype remaining = m_content.size() - m_pos;
+    const auto newline = static_cast<const char *>(std::memchr(begin, '\n', size_t(remaining)));
+    // Without a newline the line may continue in the next chunk
+    if (!newline && !m_finished)
+        return false;
+    const qsizetype length = newline ? newline - begin : remaining;
+
+    line = QByteArrayView(begin, length);
+    m_pos += length + 1;
+    return true;
+}
+
+bool M3uParser::next(M3uEntry &entry)
+{
+    // QTextStream used to swallow a UTF-8 BOM, keep doing that
+    if (!m_bomChecked) {
+        if (m_content.size() < 3 && !m_finished)
+            return false;
+        if (m_content.startsWith("\xEF\xBB\xBF"))
+            m_pos = 3;
+        m_bomChecked = true;
+    }
+
+    QByteArrayView line;
+    while (nextLine(line)) {
+        line = trimmed(line);
+        if (line.isEmpty())
+            continue;
+
+        if (line.startsWith("#EXTINF")) {
+            // Every #EXTINF starts over with the default category
+            m_attributes = line;
+            m_hasCategory = false;
+            m_category = {};
+
+            const QByteArrayView groupTitle = attribute(line, "group-title");
+            if (groupTitle.data()) {
+                m_category = groupTitle;
+                m_hasCategory = true;
+            }
+
+            const qsizetype commaIndex = line.lastIndexOf(',');
+            m_name = commaIndex != -1 ? trimmed(line.sliced(commaIndex + 1)) : kUnknownName;
+        } else if (line.startsWith("#EXTM3U")) {
+            if (m_header.isNull())
+                m_header = line.toByteArray();
+        } else if (line.startsWith("#EXTGRP:")) {
+            m_category = trimmed(line.sliced(8));
+            m_hasCategory = true;
+        } else if (line.front() != '#') {
+            // Anything else that is not a comment is a URL
+            if (m_name.isEmpty())
+                continue;
+
+            entry.name = m_name;
+            entry.url = line;
+            entry.category = m_category;
+            entry.attributes = m_attributes;
+            entry.hasCategory = m_hasCategory;
+            m_name = {};
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,76 @@
+#ifndef M3UPARSER_H
+#define M3UPARSER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+
+// One playlist entry. All fields are slices of the parser's input and stay
+// valid until the next call to M3uParser::feed() (or, for a parser built on
+// a fixed buffer, as long as that buffer is alive).
+struct M3uEntry {
+    QByteArrayView name;
+    QByteArrayView url;
+    QByteArrayView category;   // group-title or #EXTGRP value
+    QByteArrayView attributes; // the whole #EXTINF line, see M3uParser::attribute()
+    bool hasCategory = false;  // false means "use the default category"
+};
+
+// Byte-level M3U/M3U8 reader. Works directly on the raw UTF-8 bytes: lines
+// are split with memchr and nothing is decoded or copied, so callers only
+// pay for the QString conversions of the fields they keep.
+//
+// Either construct it on a complete buffer, or default-construct it, feed()
+// chunks as they arrive and call finish() after the last one.
+class M3uParser
+{
+public:
+    M3uParser();
+    explicit M3uParser(QByteArrayView content);
+
+    // Streaming input. A partial trailing line is kept until the rest of it
+    // arrives, and an #EXTINF waiting for its URL survives across chunks.
+    void feed(QByteArrayView chunk);
+    void finish();
+
+    // Returns the next complete entry (an #EXTINF followed by a URL line),
+    // or false once the available input is exhausted.
+    bool next(M3uEntry &entry);
+
+    // The #EXTM3U line once it has been read, for playlist-wide attributes
+    // such as x-tvg-url. Stays valid for the lifetime of the parser.
+    QByteArrayView header() const { return m_header; }
+
+    // Byte offset of the parser within the content, for progress reporting
+    qsizetype position() const { return m_consumed + m_pos; }
+
+    // Value of key="..." inside an #EXTINF line. A missing attribute gives a
+    // null view, while key="" gives an empty but non-null one.
+    static QByteArrayView attribute(QByteArrayView extinf, QByteArrayView key);
+    // Same whitespace rules as QString::trimmed(), applied to UTF-8 bytes.
+    static QByteArrayView trimmed(QByteArrayView text);
+
+private:
+    bool nextLine(QByteArrayView &line);
+    void detachPendingState();
+
+    QByteArrayView m_content;
+    qsizetype m_pos = 0;
+    qsizetype m_consumed = 0; // bytes already dropped from the front of m_buffer
+    bool m_finished = false;
+    bool m_bomChecked = false;
+
+    // Streaming mode only: the unconsumed input, plus private copies of the
+    // #EXTINF / #EXTGRP lines once the chunk they came from is discarded
+    QByteArray m_buffer;
+    QByteArray m_pendingAttributes;
+    QByteArray m_pendingCategory;
+    QByteArray m_header;
+
+    // State carried between lines, mirrors the #EXTINF -> URL sequence
+    QByteArrayView m_name;
+    QByteArrayView m_category;
+    QByteArrayView m_attributes;
+    bool m_hasCategory = false;
+};
+
+#endif // M3UPARSER_H
@@ -1,9 +1,18 @@
+#include "logoprovider.h"
+#include "mosaiccontroller.h"
 #include "playlistmanager.h"
 #include "playlistmodel.h"
+#include "startuptrace.h"
+#include "statestore.h"
+#include "telemetry.h"
+#include "userstate.h"
+#include "zappingcontroller.h"
+#include <QElapsedTimer>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
 #include <QQmlContext>
 #include <QQuickStyle>
+#include <QQuickWindow>
 
 #include <QIcon>
 
@@ -12,8 +21,13 @@
 #include <QIcon>
 
 int main(int argc, char *argv[]) {
+  QElapsedTimer startupClock;
+  startupClock.start();
   QGuiApplication app(argc, argv);
 
+  // Launch phases, logged and optionally written out (see startuptrace.h)
+  StartupTrace startupTrace(startupClock);
+
   QString iconPath = ":/qt/qml/iptv_player/icons/iptv.png";
   if (!QFile::exists(iconPath)) {
     // Fallback or try alternative path (older Qt6 versions might differ)
@@ -29,15 +43,52 @@ int main(int argc, char *argv[]) {
   QQuickStyle::setStyle("Fusion");
 
   qmlRegisterType<PlaylistModel>("iptv.player", 1, 0, "PlaylistModel");
+  qmlRegisterUncreatableType<SearchResultsModel>(
+      "iptv.player", 1, 0, "SearchResultsModel",
+      "SearchResultsModel is provided by PlaylistModel.searchResults");
+  qmlRegisterUncreatableType<CategoryListModel>(
+      "iptv.player", 1, 0, "CategoryListModel",
+      "CategoryListModel is provided by PlaylistModel.categories");
+  qmlRegisterType<ZappingController>("iptv.player", 1, 0, "ZappingController");
+  qmlRegisterType<MosaicController>("iptv.player", 1, 0, "MosaicController");
+  qmlRegisterUncreatableType<StartupTrace>(
+      "iptv.player", 1, 0, "StartupTrace",
+      "StartupTrace is provided as startupTrace");
+
+  // Playlists, favourites and history; loads on its own thread while the
+  // window comes up
+  StateStore stateStore;
+  QObject::connect(&stateStore, &StateStore::ready, &startupTrace,
+                   [&startupTrace]() { startupTrace.mark(StartupTrace::StateLoaded); });
 
   // Register PlaylistManager globally
-  PlaylistManager playlistManager;
+  PlaylistManager playlistManager(&stateStore);
+  UserState userState(&stateStore);
+
+  // Playback and load metrics, optionally exported (see telemetry.h)
+  Telemetry telemetry;
+  if (const int port = qEnvironmentVariableIntValue("IPTV_METRICS_PORT"); port > 0)
+    telemetry.listen(quint16(port));
+  if (qEnvironmentVariableIsSet("IPTV_METRICS_FILE"))
+    telemetry.writeJsonPeriodically(qEnvironmentVariable("IPTV_METRICS_FILE"), 30);
 
   QQmlApplicationEngine engine;
   engine.rootContext()->setContextProperty("playlistManager", &playlistManager);
+  engine.rootContext()->setContextProperty("userState", &userState);
+  engine.rootContext()->setContextProperty("startupTrace", &startupTrace);
+  engine.rootContext()->setContextProperty("telemetry", &telemetry);
+  // Channel logos (tvg-logo), see PlaylistModel's "logo" role
+  engine.addImageProvider("logos", new LogoProvider);
   QObject::connect(
       &engine, &QQmlApplicationEngine::objectCreationFailed, &app,
       []() { QCoreApplication::exit(-1); }, Qt::QueuedConnection);
+  QObject::connect(&engine, &QQmlApplicationEngine::objectCreated, &startupTrace,
+                   [&startupTrace](QObject *object) {
+                     if (!object)
+                       return;
+                     startupTrace.mark(StartupTrace::EngineReady);
+                     startupTrace.setWindow(qobject_cast<QQuickWindow *>(object));
+                   });
   engine.loadFromModule("iptv_player", "Main");
 
   return app.exec();
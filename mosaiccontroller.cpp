@@ -0,0 +1,551 @@
+#include "mosaiccontroller.h"
+#include "playlistmodel.h"
+#include <QDebug>
+#include <QMediaMetaData>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSize>
+#include <QThread>
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace {
+
+// Paused tiles take turns at least this often
+constexpr int kRotateMs = 5000;
+
+// Costs in 1080p30 streams until the metadata tells
+constexpr qreal kGuessedCost = 1.0;
+// Lowest variants are rarely above 480p
+constexpr qreal kGuessedVariantCost = 0.25;
+constexpr qreal kReferencePixelRate = 1920.0 * 1080.0 * 30.0;
+
+// Master playlists are small; anything longer is a stream
+constexpr qint64 kMaxPlaylistBytes = 256 * 1024;
+
+bool isRemote(const QUrl &url)
+{
+    return url.scheme() == "http" || url.scheme() == "https";
+}
+
+// URI of the variant with the lowest BANDWIDTH in an HLS master playlist,
+// resolved against base; empty if playlist is not a master playlist
+QUrl lowestVariant(const QByteArray &playlist, const QUrl &base)
+{
+    static const QByteArray streamInf = "#EXT-X-STREAM-INF:";
+
+    QUrl lowest;
+    qint64 lowestBandwidth = -1;
+    qint64 bandwidth = -1; // of the #EXT-X-STREAM-INF waiting for its URI
+    for (QByteArray line : playlist.split('\n')) {
+        line = line.trimmed();
+        if (line.startsWith(streamInf)) {
+            bandwidth = 0;
+            for (const QByteArray &attribute : line.mid(streamInf.size()).split(',')) {
+                // Not AVERAGE-BANDWIDTH
+                if (attribute.startsWith("BANDWIDTH="))
+                    bandwidth = attribute.mid(10).toLongLong();
+            }
+            continue;
+        }
+        if (line.isEmpty() || line.startsWith('#') || bandwidth < 0)
+            continue;
+        if (lowestBandwidth < 0 || bandwidth < lowestBandwidth) {
+            lowestBandwidth = bandwidth;
+            lowest = base.resolved(QUrl(QString::fromUtf8(line)));
+        }
+        bandwidth = -1;
+    }
+    return lowest;
+}
+
+} // namespace
+
+MosaicController::MosaicController(QObject *parent)
+    : QAbstractListModel(parent)
+    , m_audioOutput(new QAudioOutput(this))
+    , m_rotateTimer(new QTimer(this))
+    , m_scheduleTimer(new QTimer(this))
+{
+    m_tiles.resize(m_columns * m_columns);
+
+    // Software decoding of one 1080p30 stream keeps about two cores busy
+    m_budget = qMax(1.0, QThread::idealThreadCount() / 2.0);
+    if (const qreal budget = qEnvironmentVariable("IPTV_DECODE_BUDGET").toDouble(); budget > 0)
+        m_budget = budget;
+
+    m_rotateTimer->setInterval(kRotateMs);
+    connect(m_rotateTimer, &QTimer::timeout, this, &MosaicController::schedule);
+    m_scheduleTimer->setSingleShot(true);
+    m_scheduleTimer->setInterval(0);
+    connect(m_scheduleTimer, &QTimer::timeout, this, &MosaicController::schedule);
+}
+
+MosaicController::~MosaicController()
+{
+    for (Tile &tile : m_tiles) {
+        if (tile.player)
+            tile.player->stop();
+    }
+}
+
+int MosaicController::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return int(m_tiles.count());
+}
+
+QVariant MosaicController::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_tiles.count())
+        return QVariant();
+
+    const Tile &tile = m_tiles[index.row()];
+
+    switch (role) {
+    case NameRole:
+        return tile.name;
+    case UrlRole:
+        return tile.url;
+    case TierRole:
+        return int(tile.tier);
+    case FocusedRole:
+        return index.row() == m_focused;
+    case FailedRole:
+        return tile.failed;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> MosaicController::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[NameRole] = "name";
+    roles[UrlRole] = "url";
+    roles[TierRole] = "tier";
+    roles[FocusedRole] = "focused";
+    roles[FailedRole] = "failed";
+    return roles;
+}
+
+PlaylistModel *MosaicController::model() const
+{
+    return m_model;
+}
+
+void MosaicController::setModel(PlaylistModel *model)
+{
+    if (m_model == model)
+        return;
+    m_model = model;
+    emit modelChanged();
+}
+
+int MosaicController::columns() const
+{
+    return m_columns;
+}
+
+void MosaicController::setColumns(int columns)
+{
+    columns = qBound(2, columns, 3);
+    if (m_columns == columns)
+        return;
+    m_columns = columns;
+
+    const int count = columns * columns;
+    const int oldCount = int(m_tiles.size());
+    if (count < oldCount) {
+        beginRemoveRows(QModelIndex(), count, oldCount - 1);
+        for (int i = count; i < oldCount; ++i) {
+            if (m_tiles[i].player)
+                releasePlayer(m_tiles[i]);
+        }
+        m_tiles.resize(count);
+        endRemoveRows();
+        if (m_focused >= count)
+            setFocusedTile(0);
+    } else {
+        beginInsertRows(QModelIndex(), oldCount, count - 1);
+        m_tiles.resize(count);
+        endInsertRows();
+        if (m_firstRow >= 0)
+            showRows(m_firstRow);
+    }
+    emit columnsChanged();
+    scheduleSoon();
+}
+
+int MosaicController::focusedTile() const
+{
+    return m_focused;
+}
+
+void MosaicController::setFocusedTile(int tile)
+{
+    if (tile < 0 || tile >= m_tiles.size() || tile == m_focused)
+        return;
+    const int previous = m_focused;
+    m_focused = tile;
+    if (previous < m_tiles.size())
+        emit dataChanged(index(previous), index(previous), {FocusedRole});
+    emit dataChanged(index(tile), index(tile), {FocusedRole});
+    emit focusedTileChanged();
+    // Sound and resolution should follow the click at once
+    schedule();
+}
+
+bool MosaicController::isActive() const
+{
+    return m_active;
+}
+
+void MosaicController::setActive(bool active)
+{
+    if (m_active == active)
+        return;
+    m_active = active;
+    emit activeChanged();
+    schedule();
+}
+
+qreal MosaicController::volume() const
+{
+    return m_audioOutput->volume();
+}
+
+void MosaicController::setVolume(qreal volume)
+{
+    if (qFuzzyCompare(m_audioOutput->volume(), float(volume)))
+        return;
+    m_audioOutput->setVolume(float(volume));
+    emit volumeChanged();
+}
+
+qreal MosaicController::decodeBudget() const
+{
+    return m_budget;
+}
+
+void MosaicController::setDecodeBudget(qreal budget)
+{
+    budget = qMax(0.0, budget);
+    if (qFuzzyCompare(m_budget, budget))
+        return;
+    m_budget = budget;
+    emit decodeBudgetChanged();
+    scheduleSoon();
+}
+
+qreal MosaicController::usedBudget() const
+{
+    return m_used;
+}
+
+void MosaicController::showRows(int row)
+{
+    if (!m_model || row < 0)
+        return;
+    m_firstRow = row;
+    // The whole category, fetched or not
+    const int count = m_model->totalCount();
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        // Same wrap-around as zapping, but never the same channel twice
+        if (i < count) {
+            const int channelRow = (row + i) % count;
+            setTileChannel(i, m_model->getChannelUrl(channelRow), m_model->getChannelName(channelRow));
+        } else {
+            setTileChannel(i, QUrl(), QString());
+        }
+    }
+}
+
+void MosaicController::setTileChannel(int tile, const QUrl &url, const QString &name)
+{
+    if (tile < 0 || tile >= m_tiles.size())
+        return;
+    Tile &current = m_tiles[tile];
+    if (current.url == url && current.name == name)
+        return;
+    if (current.player)
+        releasePlayer(current);
+    current.url = url;
+    current.name = name;
+    current.failed = false;
+    current.tier = Released;
+    current.waiting.invalidate();
+    if (!url.isEmpty())
+        resolveVariant(url);
+    emit dataChanged(index(tile), index(tile));
+    scheduleSoon();
+}
+
+void MosaicController::setTileOutput(int tile, QObject *videoOutput)
+{
+    if (tile < 0 || tile >= m_tiles.size())
+        return;
+    Tile &current = m_tiles[tile];
+    current.output = videoOutput;
+    if (current.player)
+        current.player->setVideoOutput(videoOutput);
+    scheduleSoon();
+}
+
+void MosaicController::setTileVisible(int tile, bool visible)
+{
+    if (tile < 0 || tile >= m_tiles.size() || m_tiles[tile].visible == visible)
+        return;
+    m_tiles[tile].visible = visible;
+    scheduleSoon();
+}
+
+void MosaicController::scheduleSoon()
+{
+    if (!m_scheduleTimer->isActive())
+        m_scheduleTimer->start();
+}
+
+QUrl MosaicController::sourceFor(const Tile &tile, Tier tier) const
+{
+    if (tier == Full)
+        return tile.url;
+    const QUrl variant = m_variants.value(tile.url);
+    return variant.isEmpty() ? tile.url : variant;
+}
+
+qreal MosaicController::estimatedCost(const Tile &tile, Tier tier) const
+{
+    const QUrl source = sourceFor(tile, tier);
+    if (source == tile.playing && tile.cost >= 0)
+        return tile.cost;
+    return source == tile.url ? kGuessedCost : kGuessedVariantCost;
+}
+
+void MosaicController::schedule()
+{
+    m_scheduleTimer->stop();
+
+    const int count = int(m_tiles.size());
+    QList<Tier> tiers(count, Released);
+    QList<int> candidates;
+    qreal used = 0;
+    for (int i = 0; i < count; ++i) {
+        const Tile &tile = m_tiles[i];
+        if (!m_active || !tile.visible || !tile.output || tile.url.isEmpty() || tile.failed)
+            continue;
+        if (i == m_focused) {
+            // Always plays, even over budget
+            tiers[i] = Full;
+            used += estimatedCost(tile, Full);
+        } else if (m_resolving.contains(tile.url)) {
+            tiers[i] = Paused; // until it is known what to decode
+        } else {
+            candidates.append(i);
+        }
+    }
+
+    // Tiles that only just started keep going, then the ones that waited
+    // longest (or never ran) get their turn before the ones that ran longest
+    const auto turn = [this](int i) -> std::pair<int, qint64> {
+        const Tile &tile = m_tiles[i];
+        const bool decoding = tile.tier == Reduced || tile.tier == Full;
+        if (decoding && tile.running.isValid() && tile.running.elapsed() < kRotateMs)
+            return {0, 0};
+        if (!decoding)
+            return {1, tile.waiting.isValid() ? -tile.waiting.elapsed() : std::numeric_limits<qint64>::min()};
+        return {2, tile.running.elapsed()};
+    };
+    std::stable_sort(candidates.begin(), candidates.end(), [&turn](int a, int b) { return turn(a) < turn(b); });
+
+    bool waiting = false;
+    for (int i : std::as_const(candidates)) {
+        const qreal cost = estimatedCost(m_tiles[i], Reduced);
+        if (used + cost <= m_budget + 1e-6) {
+            tiers[i] = Reduced;
+            used += cost;
+        } else {
+            tiers[i] = Paused;
+            waiting = true;
+        }
+    }
+
+    // The audio output moves to the Full tile last, once the others let go
+    for (int i = 0; i < count; ++i) {
+        if (tiers[i] != Full)
+            applyTier(i, tiers[i]);
+    }
+    for (int i = 0; i < count; ++i) {
+        if (tiers[i] == Full)
+            applyTier(i, Full);
+    }
+
+    if (waiting && !m_rotateTimer->isActive())
+        m_rotateTimer->start();
+    else if (!waiting)
+        m_rotateTimer->stop();
+
+    m_used = used;
+    emit scheduled();
+}
+
+void MosaicController::applyTier(int index, Tier tier)
+{
+    Tile &tile = m_tiles[index];
+    const Tier previous = tile.tier;
+
+    if (tier == Released) {
+        if (tile.player)
+            releasePlayer(tile);
+    } else if (tier == Paused) {
+        if (previous != Paused)
+            tile.waiting.start();
+        // Keeps showing its last frame at no decoding cost
+        if (tile.player) {
+            tile.player->setAudioOutput(nullptr);
+            if (previous != Paused)
+                tile.player->pause();
+        }
+    } else {
+        if (!tile.player) {
+            tile.player = createPlayer();
+            tile.player->setVideoOutput(tile.output.data());
+        }
+        tile.player->setAudioOutput(tier == Full ? m_audioOutput : nullptr);
+        const QUrl source = sourceFor(tile, tier);
+        if (source != tile.playing) {
+            tile.player->setSource(source);
+            tile.playing = source;
+            tile.cost = -1;
+            tile.player->play();
+            tile.running.start();
+        } else if (previous == Paused || previous == Released) {
+            // A live stream resumes at the live edge, not where it stopped
+            if (!tile.player->isSeekable())
+                tile.player->stop();
+            tile.player->play();
+            tile.running.start();
+        }
+    }
+
+    tile.tier = tier;
+    if (tier != previous)
+        emit dataChanged(this->index(index), this->index(index), {TierRole});
+}
+
+QMediaPlayer *MosaicController::createPlayer()
+{
+    if (!m_spare.isEmpty())
+        return m_spare.takeLast();
+
+    auto *player = new QMediaPlayer(this);
+    connect(player, &QMediaPlayer::metaDataChanged, this, [this, player]() { updateCost(player); });
+    connect(player, &QMediaPlayer::errorOccurred, this, [this, player]() { onPlayerError(player); });
+    return player;
+}
+
+void MosaicController::releasePlayer(Tile &tile)
+{
+    // Dropping the source closes the connection and frees the decoder
+    tile.player->stop();
+    tile.player->setSource(QUrl());
+    tile.player->setVideoOutput(nullptr);
+    tile.player->setAudioOutput(nullptr);
+    m_spare.append(tile.player);
+    tile.player = nullptr;
+    tile.playing = QUrl();
+    tile.cost = -1;
+    tile.running.invalidate();
+}
+
+int MosaicController::tileOf(const QMediaPlayer *player) const
+{
+    for (int i = 0; i < m_tiles.size(); ++i) {
+        if (m_tiles[i].player == player)
+            return i;
+    }
+    return -1;
+}
+
+void MosaicController::updateCost(QMediaPlayer *player)
+{
+    const int index = tileOf(player);
+    if (index < 0)
+        return;
+    const QMediaMetaData metaData = player->metaData();
+    const QSize size = metaData.value(QMediaMetaData::Resolution).toSize();
+    if (size.isEmpty())
+        return;
+    qreal fps = metaData.value(QMediaMetaData::VideoFrameRate).toReal();
+    if (fps <= 0)
+        fps = 25;
+
+    Tile &tile = m_tiles[index];
+    const qreal cost = size.width() * size.height() * fps / kReferencePixelRate;
+    if (qAbs(cost - tile.cost) < 0.01)
+        return;
+    tile.cost = cost;
+    scheduleSoon();
+}
+
+void MosaicController::onPlayerError(QMediaPlayer *player)
+{
+    const int index = tileOf(player);
+    if (index < 0)
+        return;
+    Tile &tile = m_tiles[index];
+    qWarning() << "Mosaic tile" << tile.name << "failed:" << player->errorString();
+
+    if (tile.playing != tile.url) {
+        // The light variant is broken; the channel itself may still play
+        m_variants.insert(tile.url, QUrl());
+    } else {
+        tile.failed = true;
+        emit dataChanged(this->index(index), this->index(index), {FailedRole});
+    }
+    releasePlayer(tile);
+    tile.tier = Released;
+    emit dataChanged(this->index(index), this->index(index), {TierRole});
+    scheduleSoon();
+}
+
+void MosaicController::resolveVariant(const QUrl &url)
+{
+    if (m_variants.contains(url) || m_resolving.contains(url))
+        return;
+    if (!isRemote(url)) {
+        m_variants.insert(url, QUrl());
+        return;
+    }
+
+    if (!m_network)
+        m_network = new QNetworkAccessManager(this);
+    QNetworkRequest request(url);
+    request.setRawHeader("User-Agent", "IPTV Player");
+    QNetworkReply *reply = m_network->get(request);
+    m_resolving.insert(url);
+
+    // Plain streams start with binary data: give up on them right away
+    connect(reply, &QIODevice::readyRead, this, [reply]() {
+        const QByteArray head = reply->peek(7);
+        if ((head.size() == 7 && head != "#EXTM3U") || reply->bytesAvailable() > kMaxPlaylistBytes)
+            reply->abort();
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, url, reply]() {
+        reply->deleteLater();
+        onVariantReply(url, reply);
+    });
+}
+
+void MosaicController::onVariantReply(const QUrl &url, QNetworkReply *reply)
+{
+    m_resolving.remove(url);
+    QUrl variant;
+    if (reply->error() == QNetworkReply::NoError)
+        variant = lowestVariant(reply->readAll(), reply->url());
+    m_variants.insert(url, variant);
+    scheduleSoon();
+}
@@ -0,0 +1,160 @@
+#ifndef MOSAICCONTROLLER_H
+#define MOSAICCONTROLLER_H
+
+#include <QAbstractListModel>
+#include <QAudioOutput>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QMediaPlayer>
+#include <QPointer>
+#include <QSet>
+#include <QTimer>
+#include <QUrl>
+
+class PlaylistModel;
+Q_MOC_INCLUDE("playlistmodel.h")
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Several channels at once, as a 2x2 or 3x3 grid of tiles, with the decoding
+// kept within a budget. The budget is counted in 1080p30 streams
+// (decodeBudget, by default half a stream per core) and each tile is given a
+// tier:
+//
+//   Full      the focused tile: the channel's own URL, with sound
+//   Reduced   muted, on the lowest variant of an HLS master playlist
+//   Paused    holds its last frame and decodes nothing
+//   Released  no player at all: hidden, off-screen, empty or inactive
+//
+// The focused tile always plays. The other visible tiles are Reduced for as
+// long as the budget lasts; the rest wait Paused, and every rotation
+// interval the tiles that waited longest take over from those that ran
+// longest. Sources that have no lighter variant (plain MPEG-TS, local
+// files) thus get a lower frame rate rather than a lower resolution.
+//
+// A tile's cost is width x height x fps of what it decodes, from the
+// stream's metadata once known and a cautious guess before that.
+//
+// The controller is a list model of the tiles (name, url, tier, focused,
+// failed); each tile's VideoOutput registers itself with setTileOutput().
+class MosaicController : public QAbstractListModel
+{
+    Q_OBJECT
+
+    Q_PROPERTY(PlaylistModel *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(int columns READ columns WRITE setColumns NOTIFY columnsChanged)
+    Q_PROPERTY(int focusedTile READ focusedTile WRITE setFocusedTile NOTIFY focusedTileChanged)
+    // Off while the mosaic is not on screen: every decoder is released
+    Q_PROPERTY(bool active READ isActive WRITE setActive NOTIFY activeChanged)
+    Q_PROPERTY(qreal volume READ volume WRITE setVolume NOTIFY volumeChanged)
+    Q_PROPERTY(qreal decodeBudget READ decodeBudget WRITE setDecodeBudget NOTIFY decodeBudgetChanged)
+    Q_PROPERTY(qreal usedBudget READ usedBudget NOTIFY scheduled)
+
+public:
+    enum Tier {
+        Released,
+        Paused,
+        Reduced,
+        Full
+    };
+    Q_ENUM(Tier)
+
+    enum TileRoles {
+        NameRole = Qt::UserRole + 1,
+        UrlRole,
+        TierRole,
+        FocusedRole,
+        FailedRole // the stream could not be played
+    };
+
+    explicit MosaicController(QObject *parent = nullptr);
+    ~MosaicController() override;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    PlaylistModel *model() const;
+    void setModel(PlaylistModel *model);
+    int columns() const;
+    // 2 or 3
+    void setColumns(int columns);
+    int focusedTile() const;
+    void setFocusedTile(int tile);
+    bool isActive() const;
+    void setActive(bool active);
+    qreal volume() const;
+    void setVolume(qreal volume);
+    qreal decodeBudget() const;
+    void setDecodeBudget(qreal budget);
+    // Sum of the costs of the decoding tiles
+    qreal usedBudget() const;
+
+    // Fills the tiles with the model's rows from row on
+    Q_INVOKABLE void showRows(int row);
+    Q_INVOKABLE void setTileChannel(int tile, const QUrl &url, const QString &name);
+    Q_INVOKABLE void setTileOutput(int tile, QObject *videoOutput);
+    // A tile scrolled out of view or covered is released until shown again
+    Q_INVOKABLE void setTileVisible(int tile, bool visible);
+
+signals:
+    void modelChanged();
+    void columnsChanged();
+    void focusedTileChanged();
+    void activeChanged();
+    void volumeChanged();
+    void decodeBudgetChanged();
+    // Tiers were assigned again
+    void scheduled();
+
+private:
+    struct Tile {
+        QUrl url;
+        QString name;
+        QPointer<QObject> output;
+        bool visible = true;
+        bool failed = false;
+        Tier tier = Released;
+        QMediaPlayer *player = nullptr;
+        QUrl playing;          // source of player: url or its light variant
+        qreal cost = -1;       // of playing, -1 until its metadata is known
+        QElapsedTimer running; // since it last started decoding
+        QElapsedTimer waiting; // since it was last paused
+    };
+
+    void schedule();
+    void applyTier(int index, Tier tier);
+    QMediaPlayer *createPlayer();
+    void releasePlayer(Tile &tile);
+    void onPlayerError(QMediaPlayer *player);
+    QUrl sourceFor(const Tile &tile, Tier tier) const;
+    qreal estimatedCost(const Tile &tile, Tier tier) const;
+    void updateCost(QMediaPlayer *player);
+    int tileOf(const QMediaPlayer *player) const;
+    void resolveVariant(const QUrl &url);
+    void onVariantReply(const QUrl &url, QNetworkReply *reply);
+    void scheduleSoon();
+
+    QPointer<PlaylistModel> m_model;
+    QList<Tile> m_tiles;
+    int m_columns = 2;
+    int m_focused = 0;
+    int m_firstRow = -1; // of showRows(), to fill tiles added later
+    bool m_active = true;
+    qreal m_budget;
+    qreal m_used = 0;
+    QAudioOutput *m_audioOutput;
+    QList<QMediaPlayer *> m_spare; // stopped, ready for reuse
+
+    // Lowest variant of each HLS master playlist; empty if the URL is not
+    // one. Tiles wait Paused while theirs is in m_resolving.
+    QHash<QUrl, QUrl> m_variants;
+    QSet<QUrl> m_resolving;
+    QNetworkAccessManager *m_network = nullptr; // created on first use
+
+    QTimer *m_rotateTimer;
+    QTimer *m_scheduleTimer; // coalesces the reasons to schedule again
+};
+
+#endif // MOSAICCONTROLLER_H
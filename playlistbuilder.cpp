@@ -0,0 +1,94 @@
+#include "playlistbuilder.h"
+#include "m3uparser.h"
+#include <algorithm>
+#include <utility>
+
+PlaylistBuilder::PlaylistBuilder(ChannelStore *store)
+    : m_store(store)
+{
+    m_batch.firstChannel = quint32(store->size());
+    m_batch.endChannel = m_batch.firstChannel;
+}
+
+ParsedPlaylist PlaylistBuilder::parse(QByteArrayView content, const std::function<bool(qreal)> &progress)
+{
+    ParsedPlaylist playlist;
+    PlaylistBuilder builder(&playlist.store);
+    M3uParser parser(content);
+    M3uEntry entry;
+    while (parser.next(entry)) {
+        // Report (and allow cancelling) every few thousand entries
+        if (progress && (builder.channelCount() & 0xFFF) == 0 && !content.isEmpty()) {
+            if (!progress(qreal(parser.position()) / content.size()))
+                return ParsedPlaylist();
+        }
+        builder.add(entry);
+    }
+
+    playlist.store.setEpgUrl(epgUrl(parser.header()));
+    playlist.categories = playlist.store.categoryInfos();
+    playlist.searchIndex = builder.takeSearchIndexBuilder().build();
+    return playlist;
+}
+
+QString PlaylistBuilder::defaultCategory()
+{
+    return QStringLiteral("Boshqa (Others)");
+}
+
+QByteArray PlaylistBuilder::epgUrl(QByteArrayView header)
+{
+    QByteArrayView url = M3uParser::attribute(header, "x-tvg-url");
+    if (url.isEmpty())
+        url = M3uParser::attribute(header, "url-tvg");
+    return url.toByteArray();
+}
+
+quint32 PlaylistBuilder::categoryId(const QString &name)
+{
+    const qsizetype known = m_store->categoryCount();
+    const quint32 id = m_store->addCategory(name);
+    if (qsizetype(id) >= known)
+        m_batch.newCategories.append(id);
+    return id;
+}
+
+void PlaylistBuilder::add(const M3uEntry &entry)
+{
+    quint32 category;
+    if (!entry.hasCategory) {
+        if (m_defaultCategoryId < 0)
+            m_defaultCategoryId = categoryId(defaultCategory());
+        category = quint32(m_defaultCategoryId);
+    } else if (m_hasLastCategory && entry.category == QByteArrayView(m_lastCategoryBytes)) {
+        // Entries of a group are usually adjacent
+        category = m_lastCategoryId;
+    } else {
+        const QByteArray key = QByteArray::fromRawData(entry.category.data(), entry.category.size());
+        auto it = m_categoryIds.find(key);
+        if (it == m_categoryIds.end())
+            it = m_categoryIds.insert(entry.category.toByteArray(), categoryId(QString::fromUtf8(entry.category)));
+        m_lastCategoryBytes = it.key();
+        m_lastCategoryId = it.value();
+        m_hasLastCategory = true;
+        category = m_lastCategoryId;
+    }
+
+    const quint32 channel = m_store->add(entry.name, entry.url, M3uParser::attribute(entry.attributes, "tvg-id"),
+                                         M3uParser::attribute(entry.attributes, "tvg-logo"), category);
+    m_searchBuilder.add(channel, entry.name);
+    m_batch.endChannel = channel + 1;
+}
+
+PlaylistBatch PlaylistBuilder::takeBatch()
+{
+    PlaylistBatch batch = std::exchange(m_batch, PlaylistBatch());
+    m_batch.firstChannel = batch.endChannel;
+    m_batch.endChannel = batch.endChannel;
+    return batch;
+}
+
+ChannelSearchIndex::Builder PlaylistBuilder::takeSearchIndexBuilder()
+{
+    return std::exchange(m_searchBuilder, ChannelSearchIndex::Builder());
+}
@@ -0,0 +1,69 @@
+#ifndef PLAYLISTBUILDER_H
+#define PLAYLISTBUILDER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QStringList>
+#include <functional>
+#include "channelsearchindex.h"
+#include "channelstore.h"
+
+struct M3uEntry;
+
+// A whole parsed playlist, produced on a worker thread and moved into the
+// model as a whole.
+struct ParsedPlaylist {
+    ChannelStore store;
+    QList<CategoryInfo> categories; // sorted for display
+    ChannelSearchIndex searchIndex;
+    QString errorMessage;
+};
+
+// Channels appended to the store since the previous PlaylistBuilder::takeBatch()
+struct PlaylistBatch {
+    quint32 firstChannel = 0;
+    quint32 endChannel = 0;
+    QList<quint32> newCategories; // ids, in order of first appearance
+};
+
+// Appends parser entries to a ChannelStore. Category names are interned by
+// their UTF-8 bytes, so a group costs one lookup when it first shows up and
+// nothing for the channels that follow it.
+class PlaylistBuilder
+{
+public:
+    explicit PlaylistBuilder(ChannelStore *store);
+
+    // Parses a whole playlist. Thread-safe; progress receives 0..1 and
+    // returns false to abort, which yields an empty result.
+    static ParsedPlaylist parse(QByteArrayView content, const std::function<bool(qreal)> &progress = {});
+
+    static QString defaultCategory();
+    // Guide URL(s) announced by the #EXTM3U line (x-tvg-url, or url-tvg)
+    static QByteArray epgUrl(QByteArrayView header);
+
+    void add(const M3uEntry &entry);
+    qsizetype channelCount() const { return m_store->size(); }
+
+    PlaylistBatch takeBatch();
+
+    // Trigrams of every channel added so far, across all batches
+    ChannelSearchIndex::Builder takeSearchIndexBuilder();
+
+private:
+    quint32 categoryId(const QString &name);
+
+    ChannelStore *m_store;
+    PlaylistBatch m_batch;
+    ChannelSearchIndex::Builder m_searchBuilder;
+
+    QHash<QByteArray, quint32> m_categoryIds;
+    QByteArray m_lastCategoryBytes;
+    quint32 m_lastCategoryId = 0;
+    bool m_hasLastCategory = false;
+    qint64 m_defaultCategoryId = -1;
+};
+
+#endif // PLAYLISTBUILDER_H
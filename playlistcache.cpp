@@ -0,0 +1,291 @@
+#include "playlistcache.h"
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+#include <memory>
+
+namespace {
+
+enum Section {
+    MetaSection,
+    CategorySection,
+    FieldOffsetSection,
+    CategoryIdSection,
+    ArenaSection,
+    SectionCount
+};
+
+struct Header {
+    char magic[8];
+    quint32 version;
+    quint32 byteOrder;
+    quint32 channelCount;
+    quint32 categoryCount;
+    struct {
+        quint64 offset;
+        quint64 size;
+    } sections[SectionCount];
+};
+
+const char kMagic[8] = {'I', 'P', 'T', 'V', 'P', 'L', 'S', 'T'};
+constexpr quint32 kByteOrder = 0x01020304;
+constexpr qint64 kAlignment = 8;
+
+qint64 aligned(qint64 offset)
+{
+    return (offset + kAlignment - 1) & ~(kAlignment - 1);
+}
+
+// Files currently mapped by some store, and those of them to delete once
+// they are not
+struct MappedFiles {
+    QMutex mutex;
+    QHash<QString, int> mapCounts;
+    QSet<QString> retired;
+};
+
+MappedFiles &mappedFiles()
+{
+    static MappedFiles files;
+    return files;
+}
+
+// Deletes a superseded cache file, or marks it for deletion while mapped
+void retire(const QString &path)
+{
+    MappedFiles &files = mappedFiles();
+    QMutexLocker locker(&files.mutex);
+    if (files.mapCounts.contains(path))
+        files.retired.insert(path);
+    else
+        QFile::remove(path);
+}
+
+// QFile::map() memory lives as long as the QFile; the store holds on to it
+struct MappedFile {
+    QFile file;
+    uchar *data = nullptr;
+
+    ~MappedFile()
+    {
+        if (!data)
+            return;
+        const QString path = file.fileName();
+        file.unmap(data);
+        file.close();
+
+        MappedFiles &files = mappedFiles();
+        QMutexLocker locker(&files.mutex);
+        if (--files.mapCounts[path] > 0)
+            return;
+        files.mapCounts.remove(path);
+        if (files.retired.remove(path))
+            QFile::remove(path);
+    }
+};
+
+// Saves and removals of the same source must not pick the same serial
+QMutex &writeMutex()
+{
+    static QMutex mutex;
+    return mutex;
+}
+
+QString cacheDirectory()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/playlists";
+}
+
+QString cacheKey(const QString &source)
+{
+    return QString::fromLatin1(QCryptographicHash::hash(source.toUtf8(), QCryptographicHash::Sha1).toHex());
+}
+
+// <key>-<serial>.bin
+QString cachePath(const QString &key, quint64 serial)
+{
+    return cacheDirectory() + "/" + key + QString("-%1.bin").arg(serial);
+}
+
+// Serials of the cache files of source, ascending
+QList<quint64> cacheSerials(const QString &source)
+{
+    const QString key = cacheKey(source);
+    QList<quint64> serials;
+    const QStringList names = QDir(cacheDirectory()).entryList({key + "-*.bin"}, QDir::Files);
+    for (const QString &name : names) {
+        bool ok = false;
+        const quint64 serial = QStringView(name).sliced(key.size() + 1).chopped(4).toULongLong(&ok); // ".bin"
+        if (ok && serial > 0)
+            serials.append(serial);
+    }
+    std::sort(serials.begin(), serials.end());
+    return serials;
+}
+
+} // namespace
+
+bool PlaylistCache::load(const QString &source, ChannelStore *store, PlaylistCacheInfo *info)
+{
+    const QList<quint64> serials = cacheSerials(source);
+    if (serials.isEmpty())
+        return false;
+    const QString key = cacheKey(source);
+    const QString path = cachePath(key, serials.last());
+    // Leftovers that could not be deleted before, e.g. by an earlier run
+    for (qsizetype i = 0; i + 1 < serials.size(); ++i)
+        retire(cachePath(key, serials[i]));
+
+    auto mapped = std::make_shared<MappedFile>();
+    mapped->file.setFileName(path);
+    if (!mapped->file.open(QIODevice::ReadOnly))
+        return false;
+
+    const qint64 fileSize = mapped->file.size();
+    if (fileSize < qint64(sizeof(Header)))
+        return false;
+    {
+        MappedFiles &files = mappedFiles();
+        QMutexLocker locker(&files.mutex);
+        // Removed in the meantime, and only still there because it is mapped
+        if (files.retired.contains(path))
+            return false;
+        mapped->data = mapped->file.map(0, fileSize);
+        if (!mapped->data) {
+            qWarning() << "Could not map playlist cache:" << mapped->file.errorString();
+            return false;
+        }
+        ++files.mapCounts[path];
+    }
+
+    Header header;
+    std::memcpy(&header, mapped->data, sizeof(Header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != Version
+        || header.byteOrder != kByteOrder)
+        return false;
+
+    QByteArray sections[SectionCount];
+    for (int i = 0; i < SectionCount; ++i) {
+        const quint64 offset = header.sections[i].offset;
+        const quint64 size = header.sections[i].size;
+        if (offset % kAlignment != 0 || offset > quint64(fileSize) || size > quint64(fileSize) - offset)
+            return false;
+        sections[i] = QByteArray::fromRawData(reinterpret_cast<const char *>(mapped->data) + offset,
+                                              qsizetype(size));
+    }
+
+    PlaylistCacheInfo cached;
+    QByteArray epgUrl;
+    {
+        QDataStream stream(sections[MetaSection]);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream >> cached.source >> cached.etag >> cached.lastModified >> cached.sourceSize
+               >> cached.sourceModified >> epgUrl;
+        if (stream.status() != QDataStream::Ok || cached.source != source)
+            return false;
+    }
+
+    QStringList categoryNames;
+    {
+        QDataStream stream(sections[CategorySection]);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream >> categoryNames;
+        if (stream.status() != QDataStream::Ok || categoryNames.size() != qsizetype(header.categoryCount))
+            return false;
+    }
+
+    if (sections[CategoryIdSection].size() != qsizetype(header.channelCount) * qsizetype(sizeof(quint32)))
+        return false;
+
+    ChannelStore loaded;
+    if (!loaded.assign(sections[ArenaSection], sections[FieldOffsetSection], sections[CategoryIdSection],
+                       categoryNames, mapped)) {
+        qWarning() << "Discarding damaged playlist cache:" << mapped->file.fileName();
+        return false;
+    }
+    loaded.setEpgUrl(epgUrl);
+
+    *store = std::move(loaded);
+    *info = std::move(cached);
+    return true;
+}
+
+bool PlaylistCache::save(const ChannelStore &store, const PlaylistCacheInfo &info)
+{
+    QByteArray meta;
+    {
+        QDataStream stream(&meta, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << info.source << info.etag << info.lastModified << info.sourceSize << info.sourceModified
+               << store.epgUrl();
+    }
+    QByteArray categories;
+    {
+        QDataStream stream(&categories, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        stream << store.categoryNames();
+    }
+
+    const QByteArray *contents[SectionCount] = {&meta, &categories, &store.fieldOffsetBytes(),
+                                                &store.categoryIdBytes(), &store.arena()};
+
+    Header header;
+    std::memset(&header, 0, sizeof(Header));
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = Version;
+    header.byteOrder = kByteOrder;
+    header.channelCount = quint32(store.size());
+    header.categoryCount = quint32(store.categoryCount());
+    qint64 offset = aligned(sizeof(Header));
+    for (int i = 0; i < SectionCount; ++i) {
+        header.sections[i].offset = quint64(offset);
+        header.sections[i].size = quint64(contents[i]->size());
+        offset = aligned(offset + contents[i]->size());
+    }
+
+    QMutexLocker locker(&writeMutex());
+    const QString key = cacheKey(info.source);
+    const QList<quint64> serials = cacheSerials(info.source);
+    QDir().mkpath(cacheDirectory());
+    QSaveFile file(cachePath(key, serials.isEmpty() ? 1 : serials.last() + 1));
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write playlist cache:" << file.errorString();
+        return false;
+    }
+
+    const QByteArray padding(kAlignment, '\0');
+    file.write(reinterpret_cast<const char *>(&header), sizeof(Header));
+    qint64 written = sizeof(Header);
+    for (int i = 0; i < SectionCount; ++i) {
+        file.write(padding.constData(), qint64(header.sections[i].offset) - written);
+        file.write(*contents[i]);
+        written = qint64(header.sections[i].offset) + contents[i]->size();
+    }
+
+    if (!file.commit()) {
+        qWarning() << "Could not write playlist cache:" << file.errorString();
+        return false;
+    }
+    for (quint64 serial : serials)
+        retire(cachePath(key, serial));
+    return true;
+}
+
+void PlaylistCache::remove(const QString &source)
+{
+    QMutexLocker locker(&writeMutex());
+    const QString key = cacheKey(source);
+    for (quint64 serial : cacheSerials(source))
+        retire(cachePath(key, serial));
+}
@@ -0,0 +1,45 @@
+#ifndef PLAYLISTCACHE_H
+#define PLAYLISTCACHE_H
+
+#include <QByteArray>
+#include <QString>
+#include "channelstore.h"
+
+// What a cached playlist was built from, to tell whether it is still current
+struct PlaylistCacheInfo {
+    QString source;
+    // HTTP validators for conditional GET
+    QByteArray etag;
+    QByteArray lastModified;
+    // Local files: size and modification time (ms since epoch)
+    qint64 sourceSize = -1;
+    qint64 sourceModified = 0;
+};
+
+// Parsed playlists kept on disk, one file per PlaylistInfo::source, in a
+// layout that can be mapped and used as is:
+//
+//   Header | meta | category names | field offsets | category ids | arena
+//
+// The last three sections are the ChannelStore arrays verbatim (native byte
+// order, 8-byte aligned); only the two small leading sections go through
+// QDataStream. A changed Version or byte order makes old files a miss.
+//
+// A mapped file can be neither replaced nor deleted on Windows, so a save
+// never overwrites: each one writes the next serial of the source's file
+// name, and the older serials are deleted at once or, while a store still
+// maps them, as soon as the last such store lets go.
+class PlaylistCache
+{
+public:
+    static constexpr quint32 Version = 3;
+
+    // Maps the newest cache file of source into store. Returns false if
+    // there is no usable cache; store is then left untouched. Thread-safe.
+    static bool load(const QString &source, ChannelStore *store, PlaylistCacheInfo *info);
+    // Thread-safe; the new file appears atomically
+    static bool save(const ChannelStore &store, const PlaylistCacheInfo &info);
+    static void remove(const QString &source);
+};
+
+#endif // PLAYLISTCACHE_H
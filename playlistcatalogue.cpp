@@ -0,0 +1,359 @@
+#include "playlistcatalogue.h"
+#include "gzipdecoder.h"
+#include "playlistbuilder.h"
+#include "playlistmanager.h"
+#include "telemetry.h"
+#include <QDebug>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QFutureWatcher>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QPromise>
+#include <QThreadPool>
+#include <chrono>
+#include <memory>
+
+namespace {
+
+bool isRemote(const QUrl &url)
+{
+    return url.scheme() == "http" || url.scheme() == "https";
+}
+
+QString localPathOf(const QString &source)
+{
+    const QString localPath = QUrl(source).toLocalFile();
+    return localPath.isEmpty() ? source : localPath;
+}
+
+} // namespace
+
+PlaylistCatalogue::PlaylistCatalogue(QObject *parent)
+    : QObject(parent)
+    , m_network(new QNetworkAccessManager(this))
+    , m_changeTimer(new QTimer(this))
+    , m_refreshTimer(new QTimer(this))
+{
+    m_changeTimer->setSingleShot(true);
+    m_changeTimer->setInterval(200);
+    connect(m_changeTimer, &QTimer::timeout, this, &PlaylistCatalogue::changed);
+    connect(m_refreshTimer, &QTimer::timeout, this, &PlaylistCatalogue::refresh);
+}
+
+PlaylistCatalogue::~PlaylistCatalogue()
+{
+    for (Entry &entry : m_entries)
+        abandon(entry);
+}
+
+void PlaylistCatalogue::abandon(Entry &entry)
+{
+    entry.generation = ++m_generation;
+    if (entry.reply)
+        entry.reply->abort();
+    entry.reply = nullptr;
+}
+
+void PlaylistCatalogue::setManager(PlaylistManager *manager)
+{
+    for (const QMetaObject::Connection &connection : std::as_const(m_managerConnections))
+        disconnect(connection);
+    m_managerConnections.clear();
+    m_manager = manager;
+
+    if (manager) {
+        const auto resync = [this]() { sync(); };
+        m_managerConnections = {
+            connect(manager, &QAbstractItemModel::rowsInserted, this, resync),
+            connect(manager, &QAbstractItemModel::rowsRemoved, this, resync),
+            connect(manager, &QAbstractItemModel::rowsMoved, this, resync),
+            connect(manager, &QAbstractItemModel::dataChanged, this, resync),
+            connect(manager, &QAbstractItemModel::modelReset, this, resync),
+        };
+    }
+    sync();
+}
+
+PlaylistManager *PlaylistCatalogue::manager() const
+{
+    return m_manager;
+}
+
+void PlaylistCatalogue::sync()
+{
+    // Enabled playlists by source; the first of two identical ones wins
+    QHash<QString, std::pair<int, QString>> wanted; // rank, name
+    int shortestRefresh = 0;
+    if (m_manager) {
+        const QList<PlaylistInfo> &playlists = m_manager->playlists();
+        for (int rank = 0; rank < playlists.size(); ++rank) {
+            const PlaylistInfo &info = playlists[rank];
+            if (!info.enabled || info.source.isEmpty() || wanted.contains(info.source))
+                continue;
+            wanted.insert(info.source, {rank, info.name});
+            if (info.refreshInterval > 0 && (shortestRefresh == 0 || info.refreshInterval < shortestRefresh))
+                shortestRefresh = info.refreshInterval;
+        }
+    }
+
+    bool changed = false;
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (wanted.contains(it.key())) {
+            ++it;
+            continue;
+        }
+        abandon(*it);
+        m_merger.removePlaylist(it.key());
+        changed = changed || it->merged;
+        it = m_entries.erase(it);
+    }
+
+    QStringList added;
+    for (auto it = wanted.cbegin(); it != wanted.cend(); ++it) {
+        const auto existing = m_entries.find(it.key());
+        if (existing == m_entries.end()) {
+            Entry &entry = m_entries[it.key()];
+            entry.rank = it->first;
+            entry.name = it->second;
+            added.append(it.key());
+            continue;
+        }
+        existing->name = it->second;
+        if (existing->rank != it->first) {
+            existing->rank = it->first;
+            m_merger.setRank(it.key(), it->first);
+            changed = changed || existing->merged;
+        }
+    }
+    for (const QString &source : std::as_const(added))
+        load(source, false);
+
+    if (shortestRefresh > 0) {
+        m_refreshTimer->setInterval(std::chrono::minutes(shortestRefresh));
+        if (!m_refreshTimer->isActive())
+            m_refreshTimer->start();
+    } else {
+        m_refreshTimer->stop();
+    }
+
+    updatePending();
+    if (changed)
+        m_changeTimer->start();
+}
+
+void PlaylistCatalogue::refresh()
+{
+    for (auto it = m_entries.cbegin(); it != m_entries.cend(); ++it) {
+        // One load per playlist at a time
+        if (it->merged && !it->reply)
+            load(it.key(), true);
+    }
+}
+
+int PlaylistCatalogue::pendingCount() const
+{
+    return m_pending;
+}
+
+PlaylistMerger PlaylistCatalogue::merger() const
+{
+    return m_merger;
+}
+
+QList<QUrl> PlaylistCatalogue::sources(QByteArrayView url) const
+{
+    return m_merger.sources(url);
+}
+
+bool PlaylistCatalogue::isCurrent(const QString &source, quint64 generation) const
+{
+    const auto it = m_entries.constFind(source);
+    return it != m_entries.cend() && it->generation == generation;
+}
+
+void PlaylistCatalogue::load(const QString &source, bool refresh)
+{
+    Entry &entry = m_entries[source];
+    entry.generation = ++m_generation;
+
+    // Same order as PlaylistModel::loadPlaylist(): a usable cache first
+    if (!refresh) {
+        ChannelStore cached;
+        PlaylistCacheInfo cacheInfo;
+        if (PlaylistCache::load(source, &cached, &cacheInfo)) {
+            if (isRemote(QUrl(source))) {
+                merge(source, cached, cacheInfo);
+                download(source); // conditional now that it is merged
+                return;
+            }
+            const QFileInfo fileInfo(localPathOf(source));
+            if (cacheInfo.sourceSize == fileInfo.size()
+                && cacheInfo.sourceModified == fileInfo.lastModified().toMSecsSinceEpoch()) {
+                merge(source, cached, cacheInfo);
+                return;
+            }
+        }
+    }
+
+    if (isRemote(QUrl(source))) {
+        download(source);
+        return;
+    }
+
+    const QString localPath = localPathOf(source);
+    const QFileInfo fileInfo(localPath);
+    PlaylistCacheInfo current;
+    current.source = source;
+    current.sourceSize = fileInfo.size();
+    current.sourceModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    if (entry.merged && current.sourceSize == entry.info.sourceSize
+        && current.sourceModified == entry.info.sourceModified)
+        return;
+
+    parseInBackground(source, [localPath](QString *errorMessage) {
+        QFile file(localPath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            *errorMessage = QString("Faylni ochib bo'lmadi: %1").arg(localPath);
+            return QByteArray();
+        }
+        return file.readAll();
+    }, current);
+}
+
+void PlaylistCatalogue::download(const QString &source)
+{
+    Entry &entry = m_entries[source];
+    QNetworkRequest request{QUrl(source)};
+    request.setRawHeader("User-Agent", "IPTV Player");
+    if (entry.merged) {
+        if (!entry.info.etag.isEmpty())
+            request.setRawHeader("If-None-Match", entry.info.etag);
+        if (!entry.info.lastModified.isEmpty())
+            request.setRawHeader("If-Modified-Since", entry.info.lastModified);
+    }
+
+    QNetworkReply *reply = m_network->get(request);
+    entry.reply = reply;
+    entry.downloadTimer.start();
+    connect(reply, &QNetworkReply::finished, this, [this, source, generation = entry.generation, reply]() {
+        reply->deleteLater();
+        if (isCurrent(source, generation))
+            onDownloaded(source, reply);
+    });
+}
+
+void PlaylistCatalogue::onDownloaded(const QString &source, QNetworkReply *reply)
+{
+    Entry &entry = m_entries[source];
+    entry.reply = nullptr;
+
+    const quint64 subject = Telemetry::subject(source);
+    if (reply->error() != QNetworkReply::NoError) {
+        Telemetry::record(TelemetryEvent::PlaylistError, subject, reply->error());
+        // A cached or earlier copy stays in the catalogue
+        if (entry.merged)
+            qWarning() << "Could not refresh playlist" << entry.name << ":" << reply->errorString();
+        else
+            fail(source, QString("URL yuklab bo'lmadi: %1").arg(reply->errorString()));
+        return;
+    }
+    Telemetry::record(TelemetryEvent::PlaylistDownload, subject, qint32(entry.downloadTimer.elapsed()));
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+        return;
+
+    PlaylistCacheInfo cacheInfo;
+    cacheInfo.source = source;
+    cacheInfo.etag = reply->rawHeader("ETag");
+    cacheInfo.lastModified = reply->rawHeader("Last-Modified");
+
+    parseInBackground(source, [body = reply->readAll()](QString *errorMessage) {
+        if (!GzipDecoder::isGzip(body))
+            return body;
+        GzipDecoder decoder;
+        QByteArray inflated;
+        if (!decoder.decode(body, inflated) || !decoder.finish(inflated))
+            *errorMessage = QString("URL yuklab bo'lmadi: %1").arg(decoder.errorString());
+        return inflated;
+    }, cacheInfo);
+}
+
+void PlaylistCatalogue::parseInBackground(const QString &source, std::function<QByteArray(QString *)> &&readContent,
+                                          const PlaylistCacheInfo &info)
+{
+    const quint64 generation = m_entries[source].generation;
+    auto promise = std::make_shared<QPromise<ParsedPlaylist>>();
+
+    auto *watcher = new QFutureWatcher<ParsedPlaylist>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, source, generation, info]() {
+        watcher->deleteLater();
+        QFuture<ParsedPlaylist> future = watcher->future();
+        if (!isCurrent(source, generation) || future.resultCount() == 0)
+            return;
+
+        ParsedPlaylist playlist = future.takeResult();
+        if (!playlist.errorMessage.isEmpty()) {
+            if (m_entries[source].merged)
+                qWarning() << "Could not refresh playlist" << m_entries[source].name << ":" << playlist.errorMessage;
+            else
+                fail(source, playlist.errorMessage);
+            return;
+        }
+        merge(source, playlist.store, info);
+        QThreadPool::globalInstance()->start([store = std::move(playlist.store), info]() {
+            PlaylistCache::save(store, info);
+        });
+    });
+    watcher->setFuture(promise->future());
+
+    const quint64 subject = Telemetry::subject(source);
+    QThreadPool::globalInstance()->start([promise, subject, readContent = std::move(readContent)]() {
+        promise->start();
+        QString errorMessage;
+        const QByteArray bytes = readContent(&errorMessage);
+        ParsedPlaylist playlist;
+        if (errorMessage.isEmpty()) {
+            QElapsedTimer parseTimer;
+            parseTimer.start();
+            playlist = PlaylistBuilder::parse(bytes);
+            Telemetry::record(TelemetryEvent::PlaylistParse, subject, qint32(parseTimer.elapsed()));
+        } else {
+            playlist.errorMessage = errorMessage;
+        }
+        promise->addResult(std::move(playlist));
+        promise->finish();
+    });
+}
+
+void PlaylistCatalogue::merge(const QString &source, const ChannelStore &store, const PlaylistCacheInfo &info)
+{
+    Entry &entry = m_entries[source];
+    entry.info = info;
+    entry.merged = true;
+    entry.pending = false;
+    m_merger.setPlaylist(source, entry.rank, store);
+    updatePending();
+    m_changeTimer->start();
+}
+
+void PlaylistCatalogue::fail(const QString &source, const QString &errorMessage)
+{
+    Entry &entry = m_entries[source];
+    qWarning() << "Could not load playlist" << entry.name << ":" << errorMessage;
+    entry.pending = false;
+    updatePending();
+    emit failed(entry.name, errorMessage);
+}
+
+void PlaylistCatalogue::updatePending()
+{
+    int pending = 0;
+    for (const Entry &entry : std::as_const(m_entries))
+        pending += entry.pending ? 1 : 0;
+    if (m_pending == pending)
+        return;
+    m_pending = pending;
+    emit pendingCountChanged();
+}
@@ -0,0 +1,89 @@
+#ifndef PLAYLISTCATALOGUE_H
+#define PLAYLISTCATALOGUE_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <functional>
+#include "playlistcache.h"
+#include "playlistmerger.h"
+
+class PlaylistManager;
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Keeps a PlaylistMerger in step with the enabled playlists of a
+// PlaylistManager. Each playlist loads on its own: from its cache, with a
+// conditional GET or a download, and with the parse on the thread pool. So
+// they all load at once and each is merged as soon as it is ready.
+//
+// The manager's row signals drive sync(), which only loads what was added
+// or edited and only drops what was removed or disabled; reordering just
+// changes ranks. changed() is coalesced, so a burst of playlists finishing
+// together costs one rebuild of the catalogue.
+class PlaylistCatalogue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistCatalogue(QObject *parent = nullptr);
+    ~PlaylistCatalogue() override;
+
+    // nullptr stops loading and empties the catalogue
+    void setManager(PlaylistManager *manager);
+    PlaylistManager *manager() const;
+    // Checks every playlist for changes; unchanged ones cost a 304 or a stat
+    void refresh();
+    // Playlists still loading for the first time
+    int pendingCount() const;
+
+    // A copy of the merger as it stands, to build() the catalogue on
+    // another thread. The copy shares the playlists' data with this one.
+    PlaylistMerger merger() const;
+    QList<QUrl> sources(QByteArrayView url) const;
+
+signals:
+    void changed();
+    void pendingCountChanged();
+    void failed(const QString &name, const QString &errorMessage);
+
+private:
+    struct Entry {
+        QString name;
+        int rank = 0;
+        PlaylistCacheInfo info; // of the copy that is merged
+        quint64 generation = 0; // of the load in flight
+        QPointer<QNetworkReply> reply;
+        QElapsedTimer downloadTimer;
+        bool merged = false;
+        bool pending = true; // until merged or failed the first time
+    };
+
+    void sync();
+    void load(const QString &source, bool refresh);
+    void download(const QString &source);
+    void onDownloaded(const QString &source, QNetworkReply *reply);
+    // Makes whatever is in flight for the entry stale and aborts its download
+    void abandon(Entry &entry);
+    // readContent runs on the worker thread and sets its argument on failure
+    void parseInBackground(const QString &source, std::function<QByteArray(QString *)> &&readContent,
+                           const PlaylistCacheInfo &info);
+    void merge(const QString &source, const ChannelStore &store, const PlaylistCacheInfo &info);
+    void fail(const QString &source, const QString &errorMessage);
+    bool isCurrent(const QString &source, quint64 generation) const;
+    void updatePending();
+
+    QNetworkAccessManager *m_network;
+    QPointer<PlaylistManager> m_manager;
+    QList<QMetaObject::Connection> m_managerConnections;
+    QHash<QString, Entry> m_entries; // by PlaylistInfo::source
+    quint64 m_generation = 0;
+    PlaylistMerger m_merger;
+    QTimer *m_changeTimer;
+    QTimer *m_refreshTimer; // at the shortest refreshInterval of the playlists
+    int m_pending = 0;
+};
+
+#endif // PLAYLISTCATALOGUE_H
@@ -1,13 +1,23 @@
 #include "playlistmanager.h"
-#include <QDebug>
-#include <QDir>
-#include <QFile>
-#include <QStandardPaths>
+#include "playlistcache.h"
+#include "statestore.h"
+#include <QDateTime>
 #include <QUrl>
+#include <QUuid>
+#include <algorithm>
 
+namespace {
+const QString kPlaylistsPrefix = QStringLiteral("playlists/");
 
-PlaylistManager::PlaylistManager(QObject *parent) : QAbstractListModel(parent) {
-  loadPlaylists();
+QString newId() { return QUuid::createUuid().toString(QUuid::WithoutBraces); }
+} // namespace
+
+PlaylistManager::PlaylistManager(StateStore *store, QObject *parent)
+    : QAbstractListModel(parent), m_store(store) {
+  if (m_store->isReady())
+    loadPlaylists();
+  else
+    connect(m_store, &StateStore::ready, this, &PlaylistManager::loadPlaylists);
 }
 
 int PlaylistManager::rowCount(const QModelIndex &parent) const {
@@ -29,6 +39,10 @@ QVariant PlaylistManager::data(const QModelIndex &index, int role) const {
     return playlist.source;
   case IsUrlRole:
     return playlist.isUrl;
+  case RefreshIntervalRole:
+    return playlist.refreshInterval;
+  case EnabledRole:
+    return playlist.enabled;
   default:
     return QVariant();
   }
@@ -39,15 +53,22 @@ QHash<int, QByteArray> PlaylistManager::roleNames() const {
   roles[NameRole] = "name";
   roles[SourceRole] = "source";
   roles[IsUrlRole] = "isUrl";
+  roles[RefreshIntervalRole] = "refreshInterval";
+  roles[EnabledRole] = "enabled";
   return roles;
 }
 
-void PlaylistManager::addPlaylist(const QString &name, const QString &source) {
+void PlaylistManager::addPlaylist(const QString &name, const QString &source,
+                                  int refreshInterval) {
   beginInsertRows(QModelIndex(), m_playlists.count(), m_playlists.count());
 
   PlaylistInfo info;
+  info.id = newId();
+  // Sorts after the ones loaded, even if the store is not ready yet
+  info.position = QDateTime::currentMSecsSinceEpoch();
   info.name = name;
   info.source = source;
+  info.refreshInterval = qMax(0, refreshInterval);
 
   QUrl url(source);
   // Simple heuristic: if it has schemes http/https/ftp, assume URL. Otherwise
@@ -57,34 +78,50 @@ void PlaylistManager::addPlaylist(const QString &name, const QString &source) {
   m_playlists.append(info);
   endInsertRows();
 
-  savePlaylists();
+  savePlaylist(info);
 }
 
 void PlaylistManager::removePlaylist(int index) {
   if (index < 0 || index >= m_playlists.count())
     return;
 
+  PlaylistCache::remove(m_playlists[index].source);
+  m_store->remove(kPlaylistsPrefix + m_playlists[index].id);
+
   beginRemoveRows(QModelIndex(), index, index);
   m_playlists.removeAt(index);
   endRemoveRows();
-
-  savePlaylists();
 }
 
 void PlaylistManager::editPlaylist(int index, const QString &name,
-                                   const QString &source) {
+                                   const QString &source,
+                                   int refreshInterval) {
   if (index < 0 || index >= m_playlists.count())
     return;
 
+  if (m_playlists[index].source != source)
+    PlaylistCache::remove(m_playlists[index].source);
+
   m_playlists[index].name = name;
   m_playlists[index].source = source;
+  m_playlists[index].refreshInterval = qMax(0, refreshInterval);
 
   QUrl url(source);
   m_playlists[index].isUrl =
       (url.scheme().startsWith("http") || url.scheme() == "ftp");
 
   emit dataChanged(this->index(index), this->index(index));
-  savePlaylists();
+  savePlaylist(m_playlists[index]);
+}
+
+void PlaylistManager::setEnabled(int index, bool enabled) {
+  if (index < 0 || index >= m_playlists.count() ||
+      m_playlists[index].enabled == enabled)
+    return;
+
+  m_playlists[index].enabled = enabled;
+  emit dataChanged(this->index(index), this->index(index), {EnabledRole});
+  savePlaylist(m_playlists[index]);
 }
 
 QString PlaylistManager::getSource(int index) const {
@@ -99,56 +136,42 @@ QString PlaylistManager::getName(int index) const {
   return m_playlists[index].name;
 }
 
-QString PlaylistManager::getConfigPath() const {
-  QString path =
-      QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
-  QDir dir(path);
-  if (!dir.exists()) {
-    dir.mkpath(path);
-  }
-  return path + "/playlists.json";
+int PlaylistManager::getRefreshInterval(int index) const {
+  if (index < 0 || index >= m_playlists.count())
+    return 0;
+  return m_playlists[index].refreshInterval;
 }
 
-void PlaylistManager::savePlaylists() {
-  QJsonArray array;
-  for (const auto &p : m_playlists) {
-    QJsonObject obj;
-    obj["name"] = p.name;
-    obj["source"] = p.source;
-    obj["isUrl"] = p.isUrl;
-    array.append(obj);
+int PlaylistManager::indexOfSource(const QString &source) const {
+  for (int i = 0; i < m_playlists.count(); ++i) {
+    if (m_playlists[i].source == source)
+      return i;
   }
+  return -1;
+}
 
-  QJsonDocument doc(array);
-  QFile file(getConfigPath());
-  if (file.open(QIODevice::WriteOnly)) {
-    file.write(doc.toJson());
-    file.close();
-  } else {
-    qWarning() << "Failed to save playlists to" << getConfigPath();
-  }
+void PlaylistManager::savePlaylist(const PlaylistInfo &info) {
+  QJsonObject obj;
+  obj["position"] = info.position;
+  obj["name"] = info.name;
+  obj["source"] = info.source;
+  obj["isUrl"] = info.isUrl;
+  obj["refreshInterval"] = info.refreshInterval;
+  obj["enabled"] = info.enabled;
+
+  // Written on the store's thread, see StateStore
+  m_store->setValue(kPlaylistsPrefix + info.id, obj);
 }
 
 void PlaylistManager::loadPlaylists() {
-  QFile file(getConfigPath());
-  if (!file.open(QIODevice::ReadOnly)) {
-    return; // File doesn't exist or can't be opened, just start empty
-  }
-
-  QByteArray data = file.readAll();
-  file.close();
-
-  QJsonDocument doc = QJsonDocument::fromJson(data);
-  if (!doc.isArray())
-    return;
-
   beginResetModel();
   m_playlists.clear();
 
-  QJsonArray array = doc.array();
-  for (const auto &val : array) {
-    QJsonObject obj = val.toObject();
+  for (const QString &key : m_store->keys(kPlaylistsPrefix)) {
+    QJsonObject obj = m_store->value(key).toObject();
     PlaylistInfo info;
+    info.id = key.mid(kPlaylistsPrefix.size());
+    info.position = qint64(obj["position"].toDouble());
     info.name = obj["name"].toString();
     info.source = obj["source"].toString();
     // If "isUrl" is missing (old files), infer it
@@ -158,7 +181,13 @@ void PlaylistManager::loadPlaylists() {
       QUrl url(info.source);
       info.isUrl = (url.scheme().startsWith("http") || url.scheme() == "ftp");
     }
+    info.refreshInterval = obj["refreshInterval"].toInt(0);
+    info.enabled = obj["enabled"].toBool(true);
     m_playlists.append(info);
   }
+  std::stable_sort(m_playlists.begin(), m_playlists.end(),
+                   [](const PlaylistInfo &a, const PlaylistInfo &b) {
+                     return a.position < b.position;
+                   });
   endResetModel();
 }
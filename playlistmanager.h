@@ -7,39 +7,59 @@
 #include <QJsonObject>
 #include <QString>
 
+class StateStore;
 
 struct PlaylistInfo {
+  QString id;          // key in the StateStore, stays the same across edits
+  qint64 position = 0; // sort key of the list
   QString name;
   QString source; // URL or File Path
   bool isUrl;
+  int refreshInterval = 0; // minutes between automatic refreshes, 0 = off
+  bool enabled = true;     // part of the merged catalogue
 };
 
 class PlaylistManager : public QAbstractListModel {
   Q_OBJECT
 public:
-  enum PlaylistRoles { NameRole = Qt::UserRole + 1, SourceRole, IsUrlRole };
+  enum PlaylistRoles {
+    NameRole = Qt::UserRole + 1,
+    SourceRole,
+    IsUrlRole,
+    RefreshIntervalRole,
+    EnabledRole
+  };
 
-  explicit PlaylistManager(QObject *parent = nullptr);
+  // The list lives in store as one playlists/<id> key per playlist; it shows
+  // up once the store has loaded, merged with any added before then
+  explicit PlaylistManager(StateStore *store, QObject *parent = nullptr);
 
   int rowCount(const QModelIndex &parent = QModelIndex()) const override;
   QVariant data(const QModelIndex &index,
                 int role = Qt::DisplayRole) const override;
   QHash<int, QByteArray> roleNames() const override;
 
-  Q_INVOKABLE void addPlaylist(const QString &name, const QString &source);
+  Q_INVOKABLE void addPlaylist(const QString &name, const QString &source,
+                               int refreshInterval = 0);
   Q_INVOKABLE void removePlaylist(int index);
   Q_INVOKABLE void editPlaylist(int index, const QString &name,
-                                const QString &source);
+                                const QString &source, int refreshInterval = 0);
+  Q_INVOKABLE void setEnabled(int index, bool enabled);
 
   // Getters for specific playlist details (helper for QML)
   Q_INVOKABLE QString getSource(int index) const;
   Q_INVOKABLE QString getName(int index) const;
+  Q_INVOKABLE int getRefreshInterval(int index) const;
+  // Index of the playlist with this source, or -1
+  Q_INVOKABLE int indexOfSource(const QString &source) const;
+
+  const QList<PlaylistInfo> &playlists() const { return m_playlists; }
 
 private:
   void loadPlaylists();
-  void savePlaylists();
-  QString getConfigPath() const;
+  void savePlaylist(const PlaylistInfo &info);
 
+  StateStore *m_store;
   QList<PlaylistInfo> m_playlists;
 };
 
@@ -0,0 +1,291 @@
+#include "playlistmerger.h"
+#include <QStringList>
+#include <algorithm>
+
+namespace {
+
+constexpr quint64 kFnvOffset = 14695981039346656037ull;
+constexpr quint64 kFnvPrime = 1099511628211ull;
+
+quint64 fnv1a(QByteArrayView bytes, quint64 hash = kFnvOffset)
+{
+    for (const char c : bytes) {
+        hash ^= quint8(c);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+} // namespace
+
+QByteArray PlaylistMerger::normalizeUrl(QByteArrayView url)
+{
+    QByteArray result = url.trimmed().toByteArray();
+    const qsizetype fragment = result.indexOf('#');
+    if (fragment >= 0)
+        result.truncate(fragment);
+
+    const qsizetype schemeEnd = result.indexOf("://");
+    if (schemeEnd < 0)
+        return result;
+    qsizetype authorityEnd = schemeEnd + 3;
+    while (authorityEnd < result.size() && result[authorityEnd] != '/' && result[authorityEnd] != '?')
+        ++authorityEnd;
+
+    // User info is case-sensitive, scheme and host are not
+    const qsizetype at = result.lastIndexOf('@', authorityEnd - 1);
+    const qsizetype hostStart = at > schemeEnd ? at + 1 : schemeEnd + 3;
+    for (qsizetype i = 0; i < authorityEnd; ++i) {
+        const bool caseless = i < schemeEnd || i >= hostStart;
+        if (caseless && result[i] >= 'A' && result[i] <= 'Z')
+            result[i] = char(result[i] + ('a' - 'A'));
+    }
+
+    const QByteArrayView scheme(result.constData(), schemeEnd);
+    const QByteArrayView authority(result.constData() + hostStart, authorityEnd - hostStart);
+    qsizetype defaultPort = 0;
+    if (scheme == "http" && authority.endsWith(":80"))
+        defaultPort = 3;
+    else if (scheme == "https" && authority.endsWith(":443"))
+        defaultPort = 4;
+    if (defaultPort > 0) {
+        result.remove(authorityEnd - defaultPort, defaultPort);
+        authorityEnd -= defaultPort;
+    }
+
+    if (result.size() > authorityEnd + 1 && result.endsWith('/'))
+        result.chop(1);
+    return result;
+}
+
+quint64 PlaylistMerger::urlKey(QByteArrayView url)
+{
+    return fnv1a(normalizeUrl(url));
+}
+
+quint64 PlaylistMerger::tvgIdKey(QByteArrayView tvgId)
+{
+    // Separate key space from URLs; ids differ in case between providers
+    return fnv1a(tvgId.trimmed().toByteArray().toLower(), fnv1a("tvg-id:"));
+}
+
+qsizetype PlaylistMerger::slotOf(const QString &id) const
+{
+    for (qsizetype slot = 0; slot < m_playlists.size(); ++slot) {
+        if (m_playlists[slot].id == id)
+            return slot;
+    }
+    return -1;
+}
+
+bool PlaylistMerger::contains(const QString &id) const
+{
+    return !id.isEmpty() && slotOf(id) >= 0;
+}
+
+QStringList PlaylistMerger::playlists() const
+{
+    QStringList ids;
+    for (const Playlist &playlist : m_playlists) {
+        if (!playlist.id.isEmpty())
+            ids.append(playlist.id);
+    }
+    return ids;
+}
+
+void PlaylistMerger::clear()
+{
+    *this = PlaylistMerger();
+}
+
+void PlaylistMerger::setPlaylist(const QString &id, int rank, const ChannelStore &store)
+{
+    Q_ASSERT(!id.isEmpty());
+    qsizetype slot = slotOf(id);
+    if (slot >= 0) {
+        detach(quint32(slot));
+    } else {
+        slot = slotOf(QString());
+        if (slot < 0) {
+            slot = m_playlists.size();
+            m_playlists.append(Playlist());
+        }
+    }
+
+    Playlist &playlist = m_playlists[slot];
+    playlist.id = id;
+    playlist.rank = rank;
+    playlist.store = store;
+    attach(quint32(slot));
+}
+
+void PlaylistMerger::removePlaylist(const QString &id)
+{
+    const qsizetype slot = slotOf(id);
+    if (slot < 0)
+        return;
+    detach(quint32(slot));
+    m_playlists[slot] = Playlist();
+}
+
+void PlaylistMerger::setRank(const QString &id, int rank)
+{
+    // Groups are not ordered; the rank is only consulted by build()
+    const qsizetype slot = slotOf(id);
+    if (slot >= 0)
+        m_playlists[slot].rank = rank;
+}
+
+void PlaylistMerger::attach(quint32 slot)
+{
+    Playlist &playlist = m_playlists[slot];
+    const ChannelStore &store = playlist.store;
+    playlist.groups.resize(store.size());
+    m_byUrl.reserve(m_byUrl.size() + store.size());
+
+    for (quint32 channel = 0; channel < quint32(store.size()); ++channel) {
+        const quint64 urlKey = PlaylistMerger::urlKey(store.field(channel, ChannelStore::UrlField));
+        const QByteArrayView tvgId = store.tvgId(channel);
+        const quint64 tvgKey = tvgId.isEmpty() ? 0 : tvgIdKey(tvgId);
+
+        quint32 group = m_byUrl.value(urlKey, NoGroup);
+        if (group == NoGroup && tvgKey != 0)
+            group = m_byTvgId.value(tvgKey, NoGroup);
+        if (group != NoGroup) {
+            const QList<Source> &sources = m_groups[group];
+            if (std::any_of(sources.cbegin(), sources.cend(), [slot](const Source &s) { return s.playlist == slot; }))
+                group = NoGroup;
+        }
+        if (group == NoGroup) {
+            if (!m_freeGroups.isEmpty()) {
+                group = m_freeGroups.takeLast();
+            } else {
+                group = quint32(m_groups.size());
+                m_groups.append(QList<Source>());
+            }
+        }
+
+        m_groups[group].append({slot, channel});
+        // The first group to claim a key keeps it
+        if (!m_byUrl.contains(urlKey))
+            m_byUrl.insert(urlKey, group);
+        if (tvgKey != 0 && !m_byTvgId.contains(tvgKey))
+            m_byTvgId.insert(tvgKey, group);
+        playlist.groups[channel] = group;
+    }
+}
+
+void PlaylistMerger::detach(quint32 slot)
+{
+    const Playlist &playlist = m_playlists[slot];
+    const ChannelStore &store = playlist.store;
+
+    for (quint32 channel = 0; channel < quint32(playlist.groups.size()); ++channel) {
+        const quint32 group = playlist.groups[channel];
+        QList<Source> &sources = m_groups[group];
+        sources.removeIf([slot, channel](const Source &s) { return s.playlist == slot && s.channel == channel; });
+
+        // Keys that now lead nowhere, or only to sources without them, go
+        const quint64 urlKey = PlaylistMerger::urlKey(store.field(channel, ChannelStore::UrlField));
+        const QByteArrayView tvgId = store.tvgId(channel);
+        const quint64 tvgKey = tvgId.isEmpty() ? 0 : tvgIdKey(tvgId);
+        const auto stillKeyed = [&](quint64 url, quint64 tvg) {
+            return std::any_of(sources.cbegin(), sources.cend(),
+                               [&](const Source &s) { return hasKey(s, url, tvg); });
+        };
+        if (m_byUrl.value(urlKey, NoGroup) == group && !stillKeyed(urlKey, 0))
+            m_byUrl.remove(urlKey);
+        if (tvgKey != 0 && m_byTvgId.value(tvgKey, NoGroup) == group && !stillKeyed(0, tvgKey))
+            m_byTvgId.remove(tvgKey);
+
+        if (sources.isEmpty()) {
+            sources.squeeze();
+            m_freeGroups.append(group);
+        }
+    }
+}
+
+bool PlaylistMerger::hasKey(const Source &source, quint64 urlKey, quint64 tvgKey) const
+{
+    const ChannelStore &store = m_playlists[source.playlist].store;
+    if (urlKey != 0)
+        return PlaylistMerger::urlKey(store.field(source.channel, ChannelStore::UrlField)) == urlKey;
+    const QByteArrayView tvgId = store.tvgId(source.channel);
+    return !tvgId.isEmpty() && tvgIdKey(tvgId) == tvgKey;
+}
+
+bool PlaylistMerger::isBetter(const Source &a, const Source &b) const
+{
+    const int rankA = m_playlists[a.playlist].rank;
+    const int rankB = m_playlists[b.playlist].rank;
+    if (rankA != rankB)
+        return rankA < rankB;
+    if (a.playlist != b.playlist)
+        return a.playlist < b.playlist;
+    return a.channel < b.channel;
+}
+
+const PlaylistMerger::Source &PlaylistMerger::primary(quint32 group) const
+{
+    const QList<Source> &sources = m_groups[group];
+    return *std::min_element(sources.cbegin(), sources.cend(),
+                             [this](const Source &a, const Source &b) { return isBetter(a, b); });
+}
+
+ChannelStore PlaylistMerger::build()
+{
+    QList<quint32> slots;
+    for (quint32 slot = 0; slot < quint32(m_playlists.size()); ++slot) {
+        if (!m_playlists[slot].id.isEmpty())
+            slots.append(slot);
+    }
+    std::stable_sort(slots.begin(), slots.end(), [this](quint32 a, quint32 b) {
+        return m_playlists[a].rank < m_playlists[b].rank;
+    });
+
+    ChannelStore merged;
+    QList<QByteArray> epgUrls;
+    m_duplicates = 0;
+    for (const quint32 slot : std::as_const(slots)) {
+        const Playlist &playlist = m_playlists[slot];
+        const ChannelStore &store = playlist.store;
+        for (const QByteArray &url : store.epgUrl().split(',')) {
+            if (!url.isEmpty() && !epgUrls.contains(url))
+                epgUrls.append(url);
+        }
+
+        // Category ids of this playlist in the merged store, added on first use
+        QList<qint64> categories(store.categoryCount(), -1);
+        for (quint32 channel = 0; channel < quint32(store.size()); ++channel) {
+            const Source &first = primary(playlist.groups[channel]);
+            if (first.playlist != slot || first.channel != channel) {
+                ++m_duplicates;
+                continue;
+            }
+            qint64 &category = categories[store.categoryId(channel)];
+            if (category < 0)
+                category = merged.addCategory(store.categoryName(store.categoryId(channel)));
+            merged.add(store.field(channel, ChannelStore::NameField), store.field(channel, ChannelStore::UrlField),
+                       store.tvgId(channel), store.logo(channel), quint32(category));
+        }
+    }
+    merged.setEpgUrl(epgUrls.join(','));
+    return merged;
+}
+
+QList<QUrl> PlaylistMerger::sources(QByteArrayView url) const
+{
+    const quint32 group = m_byUrl.value(urlKey(url), NoGroup);
+    if (group == NoGroup)
+        return {};
+
+    QList<Source> sorted = m_groups[group];
+    std::sort(sorted.begin(), sorted.end(), [this](const Source &a, const Source &b) { return isBetter(a, b); });
+    QList<QUrl> urls;
+    for (const Source &source : std::as_const(sorted)) {
+        const QUrl sourceUrl = m_playlists[source.playlist].store.url(source.channel);
+        if (!urls.contains(sourceUrl))
+            urls.append(sourceUrl);
+    }
+    return urls;
+}
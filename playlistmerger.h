@@ -0,0 +1,81 @@
+#ifndef PLAYLISTMERGER_H
+#define PLAYLISTMERGER_H
+
+#include <QByteArray>
+#include <QByteArrayView>
+#include <QHash>
+#include <QList>
+#include <QString>
+#include <QUrl>
+#include "channelstore.h"
+
+// Merges several playlists into one catalogue, one channel per distinct
+// stream. Channels are the same if their normalized URLs match or, across
+// playlists, if their tvg-ids do. The copies are kept as fallback sources of
+// the merged channel, ordered by playlist rank; the best ranked one is the
+// primary and decides name, logo and category.
+//
+// The index is two hashes from 64-bit keys to 32-bit group ids, plus one
+// group id per source channel. setPlaylist() and removePlaylist() only touch
+// the channels of that playlist; build() then lays out the merged store
+// again, which is a copy of the primaries' fields.
+//
+// A playlist listing the same stream twice keeps both: duplicates are only
+// folded across playlists.
+class PlaylistMerger
+{
+public:
+    // Adds a playlist, or replaces the one with the same id. Lower ranks
+    // come first.
+    void setPlaylist(const QString &id, int rank, const ChannelStore &store);
+    void removePlaylist(const QString &id);
+    void setRank(const QString &id, int rank);
+    bool contains(const QString &id) const;
+    QStringList playlists() const;
+    void clear();
+
+    // The merged catalogue. Channels follow the order of their primaries:
+    // by playlist rank, then by position in the playlist.
+    ChannelStore build();
+    // Every source of the channel with this URL, primary first; empty if
+    // the URL is not in the catalogue
+    QList<QUrl> sources(QByteArrayView url) const;
+    // Source channels folded into another one at the last build()
+    qsizetype duplicateCount() const { return m_duplicates; }
+
+    // Lower-case scheme and host, no default port, fragment or trailing slash
+    static QByteArray normalizeUrl(QByteArrayView url);
+    static quint64 urlKey(QByteArrayView url);
+    static quint64 tvgIdKey(QByteArrayView tvgId);
+
+private:
+    struct Source {
+        quint32 playlist; // slot in m_playlists
+        quint32 channel;
+    };
+
+    struct Playlist {
+        QString id; // empty for a free slot
+        int rank = 0;
+        ChannelStore store;
+        QList<quint32> groups; // per channel
+    };
+
+    static constexpr quint32 NoGroup = 0xffffffffu;
+
+    void attach(quint32 slot);
+    void detach(quint32 slot);
+    qsizetype slotOf(const QString &id) const;
+    bool isBetter(const Source &a, const Source &b) const;
+    const Source &primary(quint32 group) const;
+    bool hasKey(const Source &source, quint64 urlKey, quint64 tvgKey) const;
+
+    QList<Playlist> m_playlists;
+    QList<QList<Source>> m_groups; // empty for a free group
+    QList<quint32> m_freeGroups;
+    QHash<quint64, quint32> m_byUrl;
+    QHash<quint64, quint32> m_byTvgId;
+    qsizetype m_duplicates = 0;
+};
+
+#endif // PLAYLISTMERGER_H
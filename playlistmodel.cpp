@@ -1,42 +1,166 @@
 #include "playlistmodel.h"
+#include "playliststreamworker.h"
+#include "gzipdecoder.h"
+#include "epgloader.h"
+#include "streamprober.h"
+#include "playlistcatalogue.h"
+#include "playlistmanager.h"
+#include "telemetry.h"
 #include <QFile>
-#include <QTextStream>
+#include <QFileInfo>
+#include <QDateTime>
 #include <QDebug>
 #include <QNetworkRequest>
 #include <QNetworkReply>
 #include <QUrl>
-#include <QSet>
+#include <QFutureWatcher>
+#include <QPromise>
+#include <QThreadPool>
+#include <memory>
+#include <utility>
 #include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Beyond this many scattered insert/remove runs a model reset is cheaper
+constexpr qsizetype kMaxRowRuns = 512;
+// Rows handed to the view at once; the rest wait for fetchMore()
+constexpr qsizetype kRowPage = 500;
+
+std::function<QByteArray(QString *)> localFileReader(const QString &localPath)
+{
+    return [localPath](QString *errorMessage) {
+        QFile file(localPath);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "Could not open playlist file:" << localPath;
+            *errorMessage = QString("Faylni ochib bo'lmadi: %1").arg(localPath);
+            return QByteArray();
+        }
+        return file.readAll();
+    };
+}
+
+bool isRemote(const QUrl &url)
+{
+    return url.scheme() == "http" || url.scheme() == "https";
+}
+
+QString localPathOf(const QString &source)
+{
+    const QString localPath = QUrl(source).toLocalFile();
+    return localPath.isEmpty() ? source : localPath;
+}
+
+} // namespace
 
 PlaylistModel::PlaylistModel(QObject *parent)
     : QAbstractListModel(parent)
+    , m_searchResults(new SearchResultsModel(this))
+    , m_categories(new CategoryListModel(this))
     , m_networkManager(new QNetworkAccessManager(this))
+    , m_refreshTimer(new QTimer(this))
+    , m_streamWorker(new PlaylistStreamWorker)
+    , m_epgLoader(new EpgLoader(m_networkManager, this))
+    , m_epgTimer(new QTimer(this))
+    , m_prober(new StreamProber(this))
 {
     connect(m_networkManager, &QNetworkAccessManager::finished,
             this, &PlaylistModel::onNetworkReplyFinished);
+
+    m_streamWorker->moveToThread(&m_streamThread);
+    connect(&m_streamThread, &QThread::finished, m_streamWorker, &QObject::deleteLater);
+    connect(m_streamWorker, &PlaylistStreamWorker::rowsReady, this, &PlaylistModel::onStreamRows);
+    connect(m_streamWorker, &PlaylistStreamWorker::finished, this, &PlaylistModel::onStreamFinished);
+    connect(m_streamWorker, &PlaylistStreamWorker::failed, this,
+            [this](quint64 generation, const QString &errorMessage) {
+                if (generation != m_loadGeneration)
+                    return;
+                cancelLoad();
+                emit loadError(QString("URL yuklab bo'lmadi: %1").arg(errorMessage));
+            });
+    m_streamThread.setObjectName("PlaylistStream");
+    m_streamThread.start();
+
+    connect(m_refreshTimer, &QTimer::timeout, this, &PlaylistModel::refresh);
+
+    connect(m_epgLoader, &EpgLoader::finished, this, &PlaylistModel::onEpgLoaded);
+    connect(m_epgLoader, &EpgLoader::failed, this, [](const QString &errorMessage) {
+        qWarning() << "Could not load EPG:" << errorMessage;
+    });
+    m_epgTimer->setInterval(std::chrono::seconds(30));
+    connect(m_epgTimer, &QTimer::timeout, this, &PlaylistModel::emitEpgChanged);
+
+    connect(m_prober, &StreamProber::updated, this, &PlaylistModel::onStreamHealthUpdated);
+
+    // Row changes are announced anyway; rows going only to m_unfetchedRows
+    // are handled where that happens
+    connect(this, &QAbstractItemModel::rowsInserted, this, &PlaylistModel::updateTotalCount);
+    connect(this, &QAbstractItemModel::rowsRemoved, this, &PlaylistModel::updateTotalCount);
+    connect(this, &QAbstractItemModel::modelReset, this, &PlaylistModel::updateTotalCount);
+}
+
+PlaylistModel::~PlaylistModel()
+{
+    // Let a running parse bail out early instead of finishing for nobody
+    m_parseFuture.cancel();
+    m_streamThread.quit();
+    m_streamThread.wait();
 }
 
 int PlaylistModel::rowCount(const QModelIndex &parent) const
 {
     if (parent.isValid())
         return 0;
-    return m_displayedChannels.count();
+    return int(m_displayedRows.count());
 }
 
 QVariant PlaylistModel::data(const QModelIndex &index, int role) const
 {
-    if (!index.isValid() || index.row() < 0 || index.row() >= m_displayedChannels.count())
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_displayedRows.count())
         return QVariant();
 
-    const Channel &channel = m_displayedChannels[index.row()];
+    const quint32 channel = m_displayedRows[index.row()];
 
     switch (role) {
     case NameRole:
-        return channel.name;
+        return m_store.name(channel);
     case UrlRole:
-        return channel.url;
+        return m_store.url(channel);
     case CategoryRole:
-        return channel.category;
+        return m_store.categoryName(m_store.categoryId(channel));
+    case LogoRole: {
+        // Served by LogoProvider, which queues, caches and scales them
+        const QByteArrayView logo = m_store.logo(channel);
+        if (logo.isEmpty())
+            return QString();
+        return QString("image://logos/") + QString::fromLatin1(QUrl::toPercentEncoding(QString::fromUtf8(logo)));
+    }
+    case NowTitleRole:
+    case NextTitleRole:
+    case ProgressRole: {
+        const int epg = epgChannel(channel);
+        if (epg < 0)
+            return QVariant();
+        const EpgGuide::NowNext nowNext = m_epg.nowNext(quint32(epg), QDateTime::currentSecsSinceEpoch());
+        if (role == NowTitleRole)
+            return nowNext.nowTitle;
+        if (role == NextTitleRole)
+            return nowNext.nextTitle;
+        return nowNext.progress;
+    }
+    case AliveRole:
+    case LatencyRole:
+    case LastCheckedRole: {
+        const StreamHealth health = m_prober->health(m_store.field(channel, ChannelStore::UrlField));
+        if (health.state == StreamHealth::Unknown)
+            return QVariant();
+        if (role == AliveRole)
+            return health.state == StreamHealth::Alive;
+        if (role == LatencyRole)
+            return health.latency;
+        return QDateTime::fromSecsSinceEpoch(health.checked);
+    }
     default:
         return QVariant();
     }
@@ -48,160 +172,1086 @@ QHash<int, QByteArray> PlaylistModel::roleNames() const
     roles[NameRole] = "name";
     roles[UrlRole] = "url";
     roles[CategoryRole] = "category";
+    roles[NowTitleRole] = "nowTitle";
+    roles[NextTitleRole] = "nextTitle";
+    roles[ProgressRole] = "progress";
+    roles[LogoRole] = "logo";
+    roles[AliveRole] = "alive";
+    roles[LatencyRole] = "latency";
+    roles[LastCheckedRole] = "lastChecked";
     return roles;
 }
 
-QStringList PlaylistModel::categories() const
+bool PlaylistModel::canFetchMore(const QModelIndex &parent) const
+{
+    return !parent.isValid() && !m_unfetchedRows.isEmpty();
+}
+
+void PlaylistModel::fetchMore(const QModelIndex &parent)
+{
+    if (parent.isValid() || m_unfetchedRows.isEmpty())
+        return;
+    const qsizetype count = qMin(kRowPage, m_unfetchedRows.size());
+    const int row = int(m_displayedRows.size());
+    beginInsertRows(QModelIndex(), row, row + int(count) - 1);
+    m_displayedRows.append(m_unfetchedRows.first(count));
+    m_unfetchedRows.remove(0, count);
+    endInsertRows();
+}
+
+int PlaylistModel::totalCount() const
+{
+    return int(m_displayedRows.size() + m_unfetchedRows.size());
+}
+
+void PlaylistModel::updateTotalCount()
+{
+    const int count = totalCount();
+    if (m_totalCount == count)
+        return;
+    m_totalCount = count;
+    emit totalCountChanged();
+}
+
+int PlaylistModel::fetchRow(int row)
+{
+    if (row < 0 || row >= totalCount())
+        return -1;
+    if (row < m_displayedRows.size())
+        return row;
+    return rowForChannel(int(m_unfetchedRows[row - m_displayedRows.size()]));
+}
+
+int PlaylistModel::neighbourRow(int row, int step)
+{
+    const int count = totalCount();
+    if (count == 0)
+        return -1;
+    return fetchRow(((row + step) % count + count) % count);
+}
+
+void PlaylistModel::setDisplayedRows(QList<quint32> &&rows)
+{
+    m_unfetchedRows.clear();
+    if (rows.size() > kRowPage) {
+        m_unfetchedRows = rows.sliced(kRowPage);
+        rows.resize(kRowPage);
+    }
+    m_displayedRows = std::move(rows);
+}
+
+CategoryListModel *PlaylistModel::categories() const
 {
     return m_categories;
 }
 
-void PlaylistModel::loadPlaylist(const QString &filePath)
+SearchResultsModel *PlaylistModel::searchResults() const
 {
-    QUrl url(filePath);
-    
+    return m_searchResults;
+}
+
+bool PlaylistModel::hideDeadChannels() const
+{
+    return m_hideDead;
+}
+
+QString PlaylistModel::source() const
+{
+    return isCatalogueActive() ? QStringLiteral("catalogue") : m_sourceInfo.source;
+}
+
+void PlaylistModel::setHideDeadChannels(bool hide)
+{
+    if (m_hideDead == hide)
+        return;
+    m_hideDead = hide;
+    if (m_categorySelected)
+        applyDisplayedRows(filteredRows(m_store));
+    emit hideDeadChannelsChanged();
+}
+
+bool PlaylistModel::isLoading() const
+{
+    return m_loading;
+}
+
+qreal PlaylistModel::loadProgress() const
+{
+    return m_loadProgress;
+}
+
+void PlaylistModel::setLoading(bool loading)
+{
+    if (m_loading == loading)
+        return;
+    m_loading = loading;
+    emit loadingChanged();
+}
+
+void PlaylistModel::setLoadProgress(qreal progress)
+{
+    if (m_loadProgress == progress)
+        return;
+    m_loadProgress = progress;
+    emit loadProgressChanged();
+}
+
+void PlaylistModel::loadPlaylist(const QString &filePath, int refreshMinutes)
+{
+    // Whatever was still in flight belongs to the previous playlist
+    cancelLoad();
+
+    m_sourceInfo = PlaylistCacheInfo();
+    m_sourceInfo.source = filePath;
+    emit sourceChanged();
+    if (refreshMinutes > 0) {
+        m_refreshTimer->setInterval(std::chrono::minutes(refreshMinutes));
+        m_refreshTimer->start();
+    }
+
+    setLoading(true);
+    loadCacheInBackground(filePath);
+}
+
+void PlaylistModel::loadCacheInBackground(const QString &filePath)
+{
+    // Mapping the cache checks every channel's offsets, too slow for the
+    // GUI thread on a large playlist
+    const quint64 generation = m_loadGeneration;
+    auto promise = std::make_shared<QPromise<CachedPlaylist>>();
+    m_cacheFuture = promise->future();
+
+    auto *watcher = new QFutureWatcher<CachedPlaylist>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation, filePath]() {
+        watcher->deleteLater();
+        QFuture<CachedPlaylist> future = watcher->future();
+        if (generation != m_loadGeneration || future.resultCount() == 0)
+            return;
+        m_cacheFuture = QFuture<CachedPlaylist>();
+        continueLoad(filePath, future.takeResult());
+    });
+    watcher->setFuture(m_cacheFuture);
+
+    QThreadPool::globalInstance()->start([promise, filePath]() {
+        promise->start();
+        CachedPlaylist cached;
+        cached.found = PlaylistCache::load(filePath, &cached.playlist.store, &cached.info);
+        if (cached.found)
+            cached.playlist.categories = cached.playlist.store.categoryInfos();
+        promise->addResult(std::move(cached));
+        promise->finish();
+    });
+}
+
+void PlaylistModel::continueLoad(const QString &filePath, CachedPlaylist &&cached)
+{
+    const QUrl url(filePath);
+
     // Check if it's a URL (http/https)
-    if (url.scheme() == "http" || url.scheme() == "https") {
-        // Load from URL
+    if (isRemote(url)) {
+        if (cached.found) {
+            setLoading(false);
+            m_sourceInfo = cached.info;
+            applyCachedPlaylist(std::move(cached.playlist));
+            revalidate(url);
+            return;
+        }
+
+        // Load from URL. Accept-Encoding is deliberately left alone: the
+        // network manager then negotiates gzip/deflate itself and readyRead
+        // already delivers decompressed data.
         QNetworkRequest request(url);
         request.setRawHeader("User-Agent", "IPTV Player");
         QNetworkReply *reply = m_networkManager->get(request);
-        // Store the reply pointer for cleanup in onNetworkReplyFinished
         reply->setProperty("originalUrl", filePath);
+        reply->setProperty("generation", m_loadGeneration);
+        m_pendingReply = reply;
+        m_downloadTimer.start();
+
+        // Streamed rows go into a fresh store right away
+        clearPlaylist();
+        const quint64 generation = m_loadGeneration;
+        m_streaming = true;
+        QMetaObject::invokeMethod(m_streamWorker, [worker = m_streamWorker, generation]() {
+            worker->start(generation);
+        });
+
+        connect(reply, &QIODevice::readyRead, this, [this, reply, generation]() {
+            if (generation == m_loadGeneration)
+                feedStream(reply);
+        });
+        connect(reply, &QNetworkReply::downloadProgress, this,
+                [this, generation](qint64 received, qint64 total) {
+                    if (generation == m_loadGeneration && total > 0)
+                        setLoadProgress(qreal(received) / total);
+                });
         return;
     }
     
     // Load from local file
-    QString localPath = url.toLocalFile();
-    if (localPath.isEmpty()) {
-        localPath = filePath;
+    const QString localPath = localPathOf(filePath);
+    const QFileInfo fileInfo(localPath);
+    PlaylistCacheInfo current;
+    current.source = filePath;
+    current.sourceSize = fileInfo.size();
+    current.sourceModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    if (cached.found && cached.info.sourceSize == current.sourceSize
+        && cached.info.sourceModified == current.sourceModified) {
+        setLoading(false);
+        m_sourceInfo = cached.info;
+        applyCachedPlaylist(std::move(cached.playlist));
+        return;
+    }
+
+    parseInBackground(localFileReader(localPath), current);
+}
+
+void PlaylistModel::loadCatalogue(PlaylistManager *manager)
+{
+    cancelLoad();
+    m_sourceInfo = PlaylistCacheInfo();
+    clearPlaylist();
+
+    if (!m_catalogue) {
+        m_catalogue = new PlaylistCatalogue(this);
+        connect(m_catalogue, &PlaylistCatalogue::changed, this, &PlaylistModel::onCatalogueChanged);
+        connect(m_catalogue, &PlaylistCatalogue::pendingCountChanged, this, [this]() {
+            setLoading(m_catalogue->pendingCount() > 0);
+        });
+        connect(m_catalogue, &PlaylistCatalogue::failed, this,
+                [this](const QString &name, const QString &errorMessage) {
+                    emit loadError(QString("%1: %2").arg(name, errorMessage));
+                });
     }
+    // Cached playlists are merged at once, the rest as they arrive
+    m_catalogue->setManager(manager);
+    setLoading(m_catalogue->pendingCount() > 0);
+    emit sourceChanged();
+}
 
-    QFile file(localPath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        qWarning() << "Could not open playlist file:" << localPath;
-        emit loadError(QString("Faylni ochib bo'lmadi: %1").arg(localPath));
+bool PlaylistModel::isCatalogueActive() const
+{
+    return m_catalogue && m_catalogue->manager();
+}
+
+void PlaylistModel::onCatalogueChanged()
+{
+    // A single playlist has been loaded since
+    if (!isCatalogueActive())
+        return;
+
+    // Building the merged store, indexing it and diffing the rows on screen
+    // against it all run on the thread pool, on copies that share their
+    // data; only the row signals are left for the GUI thread
+    const quint64 build = ++m_catalogueBuild;
+    const ChannelStore old = m_store;
+    const quint64 storeGeneration = m_storeGeneration;
+    const QList<quint32> displayed = m_displayedRows;
+    const bool categorySelected = m_categorySelected;
+    const QString category = m_currentCategory;
+    const QString query = m_currentQuery;
+
+    auto promise = std::make_shared<QPromise<CatalogueBuild>>();
+    auto *watcher = new QFutureWatcher<CatalogueBuild>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this,
+            [this, watcher, build, storeGeneration, displayed, categorySelected, category, query]() {
+                watcher->deleteLater();
+                QFuture<CatalogueBuild> future = watcher->future();
+                if (build != m_catalogueBuild || !isCatalogueActive() || future.resultCount() == 0)
+                    return;
+                CatalogueBuild result = future.takeResult();
+
+                // The view moved on meanwhile (another category, more rows fetched):
+                // diff again against what it shows now
+                if (storeGeneration != m_storeGeneration || categorySelected != m_categorySelected
+                    || category != m_currentCategory || query != m_currentQuery || displayed != m_displayedRows) {
+                    QList<quint32> rows;
+                    if (m_categorySelected)
+                        rows = filteredRows(result.playlist.store);
+                    result.diff = diffRows(m_store, m_displayedRows, result.playlist.store, std::move(rows));
+                }
+
+                // Same row diff as a refresh, so the view stays put while playlists
+                // join or leave
+                applyRowDiff(std::move(result.playlist), std::move(result.diff));
+            });
+    watcher->setFuture(promise->future());
+
+    QThreadPool::globalInstance()->start(
+        [promise, merger = m_catalogue->merger(), old, displayed, categorySelected, category, query]() mutable {
+            promise->start();
+            CatalogueBuild result;
+            ChannelStore &store = result.playlist.store;
+            store = merger.build();
+            result.playlist.categories = store.categoryInfos();
+
+            ChannelSearchIndex::Builder builder;
+            for (qsizetype channel = 0; channel < store.size(); ++channel)
+                builder.add(quint32(channel), store.field(quint32(channel), ChannelStore::NameField));
+            result.playlist.searchIndex = builder.build();
+
+            // Same as filteredRows(), but for stream health; see applyRowDiff()
+            QList<quint32> rows;
+            const int categoryId = store.findCategory(category);
+            if (categorySelected && categoryId >= 0)
+                rows = store.filterByName(store.channelsInCategory(quint32(categoryId)), query);
+            result.diff = diffRows(old, displayed, store, std::move(rows));
+
+            promise->addResult(std::move(result));
+            promise->finish();
+        });
+}
+
+QList<QUrl> PlaylistModel::channelSources(const QUrl &url) const
+{
+    if (!isCatalogueActive())
+        return {};
+    return m_catalogue->sources(url.toString().toUtf8());
+}
+
+void PlaylistModel::refresh()
+{
+    if (isCatalogueActive()) {
+        m_catalogue->refresh();
         return;
     }
 
-    QByteArray content = file.readAll();
-    file.close();
-    
-    parsePlaylistContent(content);
+    // One request or parse at a time; the next tick tries again
+    if (m_sourceInfo.source.isEmpty() || m_pendingReply || m_parseFuture.isRunning() || m_cacheFuture.isRunning()
+        || m_streaming)
+        return;
+
+    const QUrl url(m_sourceInfo.source);
+    if (isRemote(url)) {
+        revalidate(url);
+        return;
+    }
+
+    const QString localPath = localPathOf(m_sourceInfo.source);
+    const QFileInfo fileInfo(localPath);
+    PlaylistCacheInfo current = m_sourceInfo;
+    current.sourceSize = fileInfo.size();
+    current.sourceModified = fileInfo.lastModified().toMSecsSinceEpoch();
+    if (current.sourceSize == m_sourceInfo.sourceSize && current.sourceModified == m_sourceInfo.sourceModified)
+        return;
+    parseInBackground(localFileReader(localPath), current, true);
+}
+
+void PlaylistModel::cancelLoad()
+{
+    ++m_loadGeneration;
+
+    if (m_pendingReply) {
+        m_pendingReply->abort();
+        m_pendingReply = nullptr;
+    }
+    m_parseFuture.cancel();
+    m_parseFuture = QFuture<ParsedPlaylist>();
+    m_cacheFuture = QFuture<CachedPlaylist>();
+    ++m_catalogueBuild;
+    resetStream();
+    m_refreshTimer->stop();
+    if (isCatalogueActive()) {
+        m_catalogue->setManager(nullptr);
+        emit sourceChanged();
+    }
+
+    setLoadProgress(0);
+    setLoading(false);
+}
+
+void PlaylistModel::resetStream()
+{
+    if (!m_streaming)
+        return;
+    m_streaming = false;
+    QMetaObject::invokeMethod(m_streamWorker, &PlaylistStreamWorker::cancel);
+}
+
+void PlaylistModel::clearPlaylist()
+{
+    beginResetModel();
+    m_store = ChannelStore();
+    ++m_storeGeneration;
+    m_displayedRows.clear();
+    m_unfetchedRows.clear();
+    m_categorySelected = false;
+    m_searchIndex = ChannelSearchIndex();
+    endResetModel();
+    m_categories->setCategories({});
+    m_prober->cancel();
+    m_lastSearchQuery.clear();
+    m_searchResults->setResults({});
+}
+
+void PlaylistModel::feedStream(QNetworkReply *reply)
+{
+    const QByteArray chunk = reply->readAll();
+    if (chunk.isEmpty() || !m_streaming)
+        return;
+    QMetaObject::invokeMethod(m_streamWorker, [worker = m_streamWorker, generation = m_loadGeneration, chunk]() {
+        worker->feed(generation, chunk);
+    });
+}
+
+void PlaylistModel::onStreamRows(quint64 generation, const ChannelStore &rows)
+{
+    if (generation != m_loadGeneration || !m_streaming)
+        return;
+
+    const quint32 firstChannel = quint32(m_store.size());
+    m_store.append(rows, 0, quint32(rows.size()));
+    const quint32 endChannel = quint32(m_store.size());
+
+    // Rows of the category on screen go straight into the view
+    QList<quint32> visible;
+    if (m_categorySelected) {
+        for (quint32 channel = firstChannel; channel < endChannel; ++channel) {
+            if (channelMatchesFilter(channel))
+                visible.append(channel);
+        }
+    }
+    // Beyond the first page they wait for the view to scroll down
+    const qsizetype room = m_unfetchedRows.isEmpty() ? qMax<qsizetype>(0, kRowPage - m_displayedRows.size()) : 0;
+    if (visible.size() > room) {
+        m_unfetchedRows.append(visible.sliced(room));
+        visible.resize(room);
+        updateTotalCount();
+    }
+    if (!visible.isEmpty()) {
+        const int row = int(m_displayedRows.size());
+        beginInsertRows(QModelIndex(), row, row + int(visible.size()) - 1);
+        m_displayedRows.append(std::move(visible));
+        endInsertRows();
+    }
+
+    // New categories show up in place, the others only change their counts
+    m_categories->updateCategories(m_store.categoryInfos());
 }
 
 void PlaylistModel::onNetworkReplyFinished(QNetworkReply *reply)
 {
+    reply->deleteLater();
+
+    // A newer load (or cancelLoad) has taken over since this was requested
+    if (reply->property("generation").toULongLong() != m_loadGeneration)
+        return;
+    m_pendingReply = nullptr;
+
+    const quint64 subject = Telemetry::subject(reply->property("originalUrl").toString());
+    if (reply->error() != QNetworkReply::NoError)
+        Telemetry::record(TelemetryEvent::PlaylistError, subject, reply->error());
+    else
+        Telemetry::record(TelemetryEvent::PlaylistDownload, subject, qint32(m_downloadTimer.elapsed()));
+
+    if (reply->property("revalidation").toBool()) {
+        onRevalidationFinished(reply);
+        return;
+    }
+
     if (reply->error() != QNetworkReply::NoError) {
         qWarning() << "Network error:" << reply->errorString();
+        resetStream();
+        setLoading(false);
+        setLoadProgress(0);
         emit loadError(QString("URL yuklab bo'lmadi: %1").arg(reply->errorString()));
-        reply->deleteLater();
         return;
     }
 
-    QByteArray content = reply->readAll();
-    reply->deleteLater();
-    
-    parsePlaylistContent(content);
+    // The rest is parsed on the worker; onStreamFinished() takes it from there
+    feedStream(reply);
+    m_streamInfo = PlaylistCacheInfo();
+    m_streamInfo.source = reply->property("originalUrl").toString();
+    m_streamInfo.etag = reply->rawHeader("ETag");
+    m_streamInfo.lastModified = reply->rawHeader("Last-Modified");
+    QMetaObject::invokeMethod(m_streamWorker, [worker = m_streamWorker, generation = m_loadGeneration]() {
+        worker->finish(generation);
+    });
+}
+
+void PlaylistModel::onStreamFinished(quint64 generation, const QByteArray &epgUrl, qint64 parseNsecs,
+                                     std::shared_ptr<ChannelSearchIndex> searchIndex)
+{
+    if (generation != m_loadGeneration || !m_streaming)
+        return;
+    m_streaming = false;
+
+    m_store.setEpgUrl(epgUrl);
+    // Parsing overlapped the download; this is the time spent on it alone
+    Telemetry::record(TelemetryEvent::PlaylistParse, Telemetry::subject(m_streamInfo.source),
+                      qint32(parseNsecs / 1000000));
+    m_searchIndex = std::move(*searchIndex);
+
+    m_sourceInfo = m_streamInfo;
+    saveCacheInBackground(m_sourceInfo);
+    updateEpgSource();
+    m_prober->probe(m_store);
+
+    setLoading(false);
+    setLoadProgress(0);
+}
+
+void PlaylistModel::buildSearchIndexInBackground(std::function<ChannelSearchIndex()> &&build)
+{
+    // Sorting the postings of a large playlist takes a while, keep it off
+    // the GUI thread. searchAll() finds nothing until it is done.
+    const quint64 storeGeneration = m_storeGeneration;
+    auto promise = std::make_shared<QPromise<ChannelSearchIndex>>();
+
+    auto *watcher = new QFutureWatcher<ChannelSearchIndex>(this);
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, storeGeneration]() {
+        watcher->deleteLater();
+        QFuture<ChannelSearchIndex> future = watcher->future();
+        if (storeGeneration == m_storeGeneration && future.resultCount() > 0)
+            m_searchIndex = future.takeResult();
+    });
+    watcher->setFuture(promise->future());
+
+    QThreadPool::globalInstance()->start([promise, build = std::move(build)]() {
+        promise->start();
+        promise->addResult(build());
+        promise->finish();
+    });
+}
+
+void PlaylistModel::parseInBackground(std::function<QByteArray(QString *)> &&readContent,
+                                      const PlaylistCacheInfo &cacheInfo, bool refresh)
+{
+    const quint64 generation = m_loadGeneration;
+    static constexpr int progressSteps = 1000;
+
+    auto promise = std::make_shared<QPromise<ParsedPlaylist>>();
+    m_parseFuture = promise->future();
+
+    auto *watcher = new QFutureWatcher<ParsedPlaylist>(this);
+    connect(watcher, &QFutureWatcherBase::progressValueChanged, this,
+            [this, generation, refresh](int value) {
+                if (generation == m_loadGeneration && !refresh)
+                    setLoadProgress(qreal(value) / progressSteps);
+            });
+    connect(watcher, &QFutureWatcherBase::finished, this, [this, watcher, generation, cacheInfo, refresh]() {
+        watcher->deleteLater();
+        QFuture<ParsedPlaylist> future = watcher->future();
+        if (generation != m_loadGeneration || future.isCanceled() || future.resultCount() == 0)
+            return;
+
+        m_parseFuture = QFuture<ParsedPlaylist>();
+        ParsedPlaylist playlist = future.takeResult();
+        setLoading(false);
+        setLoadProgress(0);
+
+        if (!playlist.errorMessage.isEmpty()) {
+            // A failed background refresh keeps the playlist that is shown
+            if (refresh)
+                qWarning() << "Could not refresh playlist:" << playlist.errorMessage;
+            else
+                emit loadError(playlist.errorMessage);
+            return;
+        }
+        if (refresh)
+            applyRefreshedPlaylist(std::move(playlist));
+        else
+            applyParsedPlaylist(std::move(playlist));
+        m_sourceInfo = cacheInfo;
+        saveCacheInBackground(cacheInfo);
+    });
+    watcher->setFuture(m_parseFuture);
+
+    const quint64 subject = Telemetry::subject(cacheInfo.source);
+    QThreadPool::globalInstance()->start([promise, subject, readContent = std::move(readContent)]() {
+        promise->start();
+        promise->setProgressRange(0, progressSteps);
+
+        QString errorMessage;
+        const QByteArray bytes = readContent(&errorMessage);
+        if (!errorMessage.isEmpty()) {
+            ParsedPlaylist failed;
+            failed.errorMessage = errorMessage;
+            promise->addResult(std::move(failed));
+            promise->finish();
+            return;
+        }
+
+        QElapsedTimer parseTimer;
+        parseTimer.start();
+        ParsedPlaylist playlist = PlaylistBuilder::parse(bytes, [&promise](qreal progress) {
+            promise->setProgressValue(int(progress * progressSteps));
+            return !promise->isCanceled();
+        });
+        if (!promise->isCanceled()) {
+            Telemetry::record(TelemetryEvent::PlaylistParse, subject, qint32(parseTimer.elapsed()));
+            promise->addResult(std::move(playlist));
+        }
+        promise->finish();
+    });
 }
 
-void PlaylistModel::parsePlaylistContent(const QByteArray &content)
+void PlaylistModel::applyCachedPlaylist(ParsedPlaylist &&playlist)
+{
+    applyParsedPlaylist(std::move(playlist));
+    indexStoreInBackground();
+}
+
+void PlaylistModel::indexStoreInBackground()
+{
+    // The store shares its (mapped) arrays, so the copy is cheap
+    buildSearchIndexInBackground([store = m_store]() {
+        ChannelSearchIndex::Builder builder;
+        for (qsizetype channel = 0; channel < store.size(); ++channel)
+            builder.add(quint32(channel), store.field(quint32(channel), ChannelStore::NameField));
+        return builder.build();
+    });
+}
+
+void PlaylistModel::revalidate(const QUrl &url)
+{
+    QNetworkRequest request(url);
+    request.setRawHeader("User-Agent", "IPTV Player");
+    if (!m_sourceInfo.etag.isEmpty())
+        request.setRawHeader("If-None-Match", m_sourceInfo.etag);
+    if (!m_sourceInfo.lastModified.isEmpty())
+        request.setRawHeader("If-Modified-Since", m_sourceInfo.lastModified);
+
+    QNetworkReply *reply = m_networkManager->get(request);
+    reply->setProperty("originalUrl", m_sourceInfo.source);
+    reply->setProperty("generation", m_loadGeneration);
+    reply->setProperty("revalidation", true);
+    m_pendingReply = reply;
+    m_downloadTimer.start();
+}
+
+void PlaylistModel::onRevalidationFinished(QNetworkReply *reply)
+{
+    // The cached copy stays on screen whatever happens here
+    if (reply->error() != QNetworkReply::NoError) {
+        qWarning() << "Could not revalidate playlist:" << reply->errorString();
+        return;
+    }
+    if (reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt() == 304)
+        return;
+
+    PlaylistCacheInfo cacheInfo;
+    cacheInfo.source = reply->property("originalUrl").toString();
+    cacheInfo.etag = reply->rawHeader("ETag");
+    cacheInfo.lastModified = reply->rawHeader("Last-Modified");
+
+    parseInBackground([body = reply->readAll()](QString *errorMessage) {
+        if (!GzipDecoder::isGzip(body))
+            return body;
+        GzipDecoder decoder;
+        QByteArray inflated;
+        if (!decoder.decode(body, inflated) || !decoder.finish(inflated))
+            *errorMessage = QString("URL yuklab bo'lmadi: %1").arg(decoder.errorString());
+        return inflated;
+    }, cacheInfo, true);
+}
+
+void PlaylistModel::saveCacheInBackground(const PlaylistCacheInfo &cacheInfo)
+{
+    QThreadPool::globalInstance()->start([store = m_store, cacheInfo]() {
+        PlaylistCache::save(store, cacheInfo);
+    });
+}
+
+void PlaylistModel::applyParsedPlaylist(ParsedPlaylist &&playlist)
 {
     beginResetModel();
-    m_allChannels.clear();
-    m_displayedChannels.clear();
-    m_categories.clear();
+    m_store = std::move(playlist.store);
+    ++m_storeGeneration;
+    m_searchIndex = std::move(playlist.searchIndex);
+    m_displayedRows.clear();
+    m_unfetchedRows.clear();
+    m_categorySelected = false;
 
-    QTextStream in(content);
-    QString line;
-    QString currentName;
-    QString currentCategory = "Boshqa (Others)"; // Default category
-    QSet<QString> uniqueCategories;
+    // Leave the channel view empty until the user selects a category
+    endResetModel();
+    m_categories->setCategories(std::move(playlist.categories));
+    m_lastSearchQuery.clear();
+    m_searchResults->setResults({});
+    updateEpgSource();
+    m_prober->probe(m_store);
+}
 
-    while (!in.atEnd()) {
-        line = in.readLine().trimmed();
+void PlaylistModel::applyRefreshedPlaylist(ParsedPlaylist &&playlist)
+{
+    QList<quint32> rows;
+    if (m_categorySelected)
+        rows = filteredRows(playlist.store);
+    RowDiff diff = diffRows(m_store, m_displayedRows, playlist.store, std::move(rows));
+    applyRowDiff(std::move(playlist), std::move(diff));
+}
 
-        if (line.isEmpty()) {
+RowDiff PlaylistModel::diffRows(const ChannelStore &old, const QList<quint32> &displayed, const ChannelStore &fresh,
+                                QList<quint32> &&rows)
+{
+    // Match the rows on screen to the new store by identity. Rows that are
+    // gone, or that now come before a row already kept, are removed; the
+    // others keep their place and are only updated if their content changed.
+    RowDiff diff;
+    QHash<size_t, quint32> freshRows;
+    freshRows.reserve(rows.size());
+    for (quint32 channel : std::as_const(rows)) {
+        const size_t key = fresh.identityKey(channel);
+        if (!freshRows.contains(key))
+            freshRows.insert(key, channel);
+    }
+
+    qint64 lastKept = -1;
+    for (qsizetype i = 0; i < displayed.size(); ++i) {
+        const quint32 channel = displayed[i];
+        const auto it = freshRows.constFind(old.identityKey(channel));
+        if (it != freshRows.cend() && qint64(it.value()) > lastKept) {
+            lastKept = it.value();
+            if (fresh.contentKey(it.value()) != old.contentKey(channel))
+                diff.changed.append(diff.kept.size());
+            diff.kept.append(it.value());
             continue;
         }
+        if (!diff.removed.isEmpty() && diff.removed.last().first + diff.removed.last().second == i)
+            ++diff.removed.last().second;
+        else
+            diff.removed.append({int(i), 1});
+    }
+    diff.rows = std::move(rows);
+    return diff;
+}
 
-        if (line.startsWith("#EXTINF")) {
-            // Reset category for the new entry, defaulting to "Boshqa (Others)"
-            // Try to find group-title first (backward compatibility)
-            currentCategory = "Boshqa (Others)";
-            
-            int groupTitleIndex = line.indexOf("group-title=\"");
-            if (groupTitleIndex != -1) {
-                int endQuote = line.indexOf("\"", groupTitleIndex + 13);
-                if (endQuote != -1) {
-                    currentCategory = line.mid(groupTitleIndex + 13, endQuote - (groupTitleIndex + 13));
-                }
-            }
-
-            // Parse Name
-            int commaIndex = line.lastIndexOf(',');
-            if (commaIndex != -1) {
-                currentName = line.mid(commaIndex + 1).trimmed();
-            } else {
-                currentName = "Unknown Channel";
-            }
-        } else if (line.startsWith("#EXTGRP:")) {
-            // Handle #EXTGRP tag
-            currentCategory = line.mid(8).trimmed();
-        } else if (!line.startsWith("#")) {
-            // Assume it's a URL
-            if (!currentName.isEmpty()) {
-                Channel channel;
-                channel.name = currentName;
-                channel.url = QUrl(line);
-                channel.category = currentCategory;
-                m_allChannels.append(channel);
-                uniqueCategories.insert(currentCategory);
-                
-                currentName.clear();
-            }
+void PlaylistModel::applyRowDiff(ParsedPlaylist &&playlist, RowDiff &&diff)
+{
+    // A diff made on the thread pool knows nothing of stream health; kept
+    // rows that are hidden go with applyDisplayedRows() below
+    if (m_hideDead)
+        diff.rows.removeIf([&](quint32 channel) { return isHidden(playlist.store, channel); });
+
+    if (diff.removed.size() > kMaxRowRuns) {
+        beginResetModel();
+        m_store = std::move(playlist.store);
+        setDisplayedRows(std::move(diff.rows));
+        endResetModel();
+    } else {
+        for (auto it = diff.removed.crbegin(); it != diff.removed.crend(); ++it) {
+            beginRemoveRows(QModelIndex(), it->first, it->first + it->second - 1);
+            m_displayedRows.remove(it->first, it->second);
+            endRemoveRows();
         }
+
+        // The remaining rows are the same channels, renumbered for the new store
+        m_store = std::move(playlist.store);
+        m_displayedRows = std::move(diff.kept);
+
+        const QList<qsizetype> &changed = diff.changed;
+        for (qsizetype i = 0; i < changed.size();) {
+            qsizetype end = i + 1;
+            while (end < changed.size() && changed[end] == changed[end - 1] + 1)
+                ++end;
+            emit dataChanged(index(int(changed[i])), index(int(changed[end - 1])));
+            i = end;
+        }
+        applyDisplayedRows(std::move(diff.rows));
     }
+    m_searchIndex = std::move(playlist.searchIndex);
+    ++m_storeGeneration;
 
-    // Sort categories
-    m_categories = uniqueCategories.values();
-    std::sort(m_categories.begin(), m_categories.end());
-    emit categoriesChanged();
-    
-    // Initially show nothing or everything? 
-    // Creating separate channel view implies we show filtered list later.
-    // Let's leave currently display empty until user selects a category.
-    
-    endResetModel();
-    emit layoutChanged();
+    m_categories->updateCategories(std::move(playlist.categories));
+
+    // Results refer to channels of the old store
+    if (!m_lastSearchQuery.isEmpty())
+        searchAll(m_lastSearchQuery, m_lastSearchLimit);
+    else
+        m_searchResults->setResults({});
+    updateEpgSource();
+    // Only channels that are new or whose result went stale are checked
+    m_prober->probe(m_store);
+}
+
+QList<quint32> PlaylistModel::filteredRows(const ChannelStore &store) const
+{
+    const int categoryId = store.findCategory(m_currentCategory);
+    if (categoryId < 0)
+        return {};
+
+    QList<quint32> rows = store.filterByName(store.channelsInCategory(quint32(categoryId)), m_currentQuery);
+    if (m_hideDead)
+        rows.removeIf([&](quint32 channel) { return isHidden(store, channel); });
+    return rows;
+}
+
+bool PlaylistModel::channelMatchesFilter(quint32 channel) const
+{
+    return m_store.categoryName(m_store.categoryId(channel)) == m_currentCategory
+           && (m_currentQuery.isEmpty() || m_store.name(channel).contains(m_currentQuery, Qt::CaseInsensitive))
+           && !isHidden(m_store, channel);
+}
+
+bool PlaylistModel::isHidden(const ChannelStore &store, quint32 channel) const
+{
+    return m_hideDead
+           && m_prober->health(store.field(channel, ChannelStore::UrlField)).state == StreamHealth::Dead;
 }
 
 void PlaylistModel::filterChannels(const QString &category, const QString &searchQuery)
 {
-    beginResetModel();
-    m_displayedChannels.clear();
-    for (const auto &channel : m_allChannels) {
-        if (channel.category == category) {
-            if (searchQuery.isEmpty() || channel.name.contains(searchQuery, Qt::CaseInsensitive)) {
-                m_displayedChannels.append(channel);
-            }
+    const bool sameCategory = m_categorySelected && category == m_currentCategory;
+    // A query containing the previous one can only match a subset of its
+    // results, so only those need to be checked again
+    const bool narrowing = sameCategory && !m_currentQuery.isEmpty()
+                           && searchQuery.contains(m_currentQuery, Qt::CaseInsensitive);
+
+    m_currentCategory = category;
+    m_currentQuery = searchQuery;
+    m_categorySelected = true;
+
+    const int categoryId = m_store.findCategory(category);
+    QList<quint32> candidates;
+    if (narrowing)
+        candidates = m_displayedRows + m_unfetchedRows;
+    else if (categoryId >= 0)
+        candidates = m_store.channelsInCategory(quint32(categoryId));
+
+    QList<quint32> rows = m_store.filterByName(candidates, searchQuery);
+    if (m_hideDead)
+        rows.removeIf([this](quint32 channel) { return isHidden(m_store, channel); });
+
+    if (!sameCategory) {
+        // A different category is a different list altogether
+        beginResetModel();
+        setDisplayedRows(std::move(rows));
+        endResetModel();
+        return;
+    }
+    applyDisplayedRows(std::move(rows));
+}
+
+void PlaylistModel::applyDisplayedRows(QList<quint32> &&rows)
+{
+    // Old and new rows are both ascending subsets of the same category, so a
+    // merge walk finds the runs that disappear and the runs that appear.
+    // Removals go first, back to front, then insertions front to back; the
+    // view keeps its scroll position and current item throughout.
+    //
+    // Only the rows up to the last one the view has fetched, and at least a
+    // page of them, are diffed; the rest become unfetched. Clearing a search
+    // that had narrowed a large category thus inserts a page, not the lot.
+    const qsizetype fetched = m_displayedRows.isEmpty()
+                                  ? 0
+                                  : std::upper_bound(rows.begin(), rows.end(), m_displayedRows.last()) - rows.begin();
+    const qsizetype kept = qMin(rows.size(), qMax(fetched, kRowPage));
+    m_unfetchedRows = rows.sliced(kept);
+    rows.resize(kept);
+    updateTotalCount();
+
+    QList<std::pair<int, int>> removed; // (first, count)
+    qsizetype next = 0;
+    for (qsizetype i = 0; i < m_displayedRows.size(); ++i) {
+        while (next < rows.size() && rows[next] < m_displayedRows[i])
+            ++next;
+        if (next < rows.size() && rows[next] == m_displayedRows[i])
+            continue;
+        if (!removed.isEmpty() && removed.last().first + removed.last().second == i)
+            ++removed.last().second;
+        else
+            removed.append({int(i), 1});
+    }
+
+    // Thousands of scattered runs cost more in signal traffic than a reset
+    if (removed.size() > kMaxRowRuns) {
+        resetDisplayedRows(std::move(rows));
+        return;
+    }
+
+    for (auto it = removed.crbegin(); it != removed.crend(); ++it) {
+        beginRemoveRows(QModelIndex(), it->first, it->first + it->second - 1);
+        m_displayedRows.remove(it->first, it->second);
+        endRemoveRows();
+    }
+
+    qsizetype row = 0;
+    qsizetype from = 0;
+    qsizetype runs = 0;
+    while (from < rows.size()) {
+        if (row < m_displayedRows.size() && m_displayedRows[row] == rows[from]) {
+            ++row;
+            ++from;
+            continue;
         }
+        // Collect the run of new indices that goes in before m_displayedRows[row]
+        qsizetype to = from;
+        while (to < rows.size() && (row >= m_displayedRows.size() || rows[to] < m_displayedRows[row]))
+            ++to;
+
+        if (++runs > kMaxRowRuns) {
+            resetDisplayedRows(std::move(rows));
+            return;
+        }
+        beginInsertRows(QModelIndex(), int(row), int(row + (to - from) - 1));
+        m_displayedRows.insert(row, to - from, 0);
+        std::copy(rows.cbegin() + from, rows.cbegin() + to, m_displayedRows.begin() + row);
+        endInsertRows();
+
+        row += to - from;
+        from = to;
     }
+}
+
+void PlaylistModel::resetDisplayedRows(QList<quint32> &&rows)
+{
+    // The view starts over, so it gets the first page of all of them
+    rows.append(m_unfetchedRows);
+    beginResetModel();
+    setDisplayedRows(std::move(rows));
     endResetModel();
 }
 
 QUrl PlaylistModel::getChannelUrl(int index) const
 {
-    if (index >= 0 && index < m_displayedChannels.count()) {
-        return m_displayedChannels[index].url;
+    if (index >= 0 && index < m_displayedRows.count()) {
+        return m_store.url(m_displayedRows[index]);
+    }
+    // Rows not fetched yet can be looked at, e.g. to warm them up
+    const int unfetched = index - int(m_displayedRows.count());
+    if (unfetched >= 0 && unfetched < m_unfetchedRows.count()) {
+        return m_store.url(m_unfetchedRows[unfetched]);
     }
     return QUrl();
 }
 
 QString PlaylistModel::getChannelName(int index) const
 {
-    if (index >= 0 && index < m_displayedChannels.count()) {
-        return m_displayedChannels[index].name;
+    if (index >= 0 && index < m_displayedRows.count()) {
+        return m_store.name(m_displayedRows[index]);
+    }
+    const int unfetched = index - int(m_displayedRows.count());
+    if (unfetched >= 0 && unfetched < m_unfetchedRows.count()) {
+        return m_store.name(m_unfetchedRows[unfetched]);
     }
     return QString();
 }
+
+int PlaylistModel::searchAll(const QString &query, int limit)
+{
+    m_lastSearchQuery = query;
+    m_lastSearchLimit = limit;
+
+    const QList<ChannelSearchIndex::Match> matches =
+        m_searchIndex.search(query, limit, [this](quint32 channelIndex) {
+            return m_store.name(channelIndex);
+        });
+
+    QList<SearchResult> results;
+    results.reserve(matches.size());
+    for (const auto &match : matches) {
+        results.append({match.channel, m_store.name(match.channel),
+                        m_store.categoryName(m_store.categoryId(match.channel)), match.score});
+    }
+
+    m_searchResults->setResults(std::move(results));
+    return m_searchResults->count();
+}
+
+int PlaylistModel::rowForChannel(int channelIndex)
+{
+    // Displayed rows are ascending channel indices
+    while (channelIndex >= 0 && !m_unfetchedRows.isEmpty() && m_unfetchedRows.first() <= quint32(channelIndex))
+        fetchMore(QModelIndex());
+    const auto it = std::lower_bound(m_displayedRows.cbegin(), m_displayedRows.cend(), quint32(channelIndex));
+    if (channelIndex < 0 || it == m_displayedRows.cend() || *it != quint32(channelIndex))
+        return -1;
+    return int(it - m_displayedRows.cbegin());
+}
+
+int PlaylistModel::rowForUrl(const QUrl &url)
+{
+    // Compared as stored; QUrl parsing every row would cost more than the scan
+    const QByteArray decoded = url.toString().toUtf8();
+    const QByteArray encoded = url.toEncoded();
+    const auto matches = [&](quint32 channel) {
+        const QByteArrayView stored = m_store.field(channel, ChannelStore::UrlField);
+        return stored == decoded || stored == encoded;
+    };
+    for (qsizetype row = 0; row < m_displayedRows.size(); ++row) {
+        if (matches(m_displayedRows[row]))
+            return int(row);
+    }
+    for (quint32 channel : std::as_const(m_unfetchedRows)) {
+        if (matches(channel))
+            return rowForChannel(int(channel));
+    }
+    return -1;
+}
+
+void PlaylistModel::checkStreams()
+{
+    m_prober->probe(m_store, true);
+}
+
+QString PlaylistModel::memoryStats() const
+{
+    const qsizetype channels = m_store.size();
+    const qsizetype bytes = m_store.memoryUsage();
+    return QString("%1 channels, %2 categories, %3 KiB, %4 bytes/channel")
+        .arg(channels)
+        .arg(m_store.categoryCount())
+        .arg(bytes / 1024)
+        .arg(channels > 0 ? bytes / channels : 0);
+}
+
+void PlaylistModel::updateEpgSource()
+{
+    if (m_store.epgUrl() == m_epgSource)
+        return;
+
+    m_epgSource = m_store.epgUrl();
+    m_epg = EpgGuide();
+    m_epgTimer->stop();
+    if (m_epgSource.isEmpty()) {
+        m_epgLoader->cancel();
+        emitEpgChanged();
+        return;
+    }
+    m_epgLoader->load(QString::fromUtf8(m_epgSource).split(',', Qt::SkipEmptyParts));
+}
+
+void PlaylistModel::onEpgLoaded()
+{
+    m_epg = m_epgLoader->takeGuide();
+    m_epgChannels.clear();
+    if (!m_epg.isEmpty())
+        m_epgTimer->start();
+    emitEpgChanged();
+}
+
+void PlaylistModel::emitEpgChanged()
+{
+    // Views only fetch the roles again for the delegates they show
+    if (!m_displayedRows.isEmpty())
+        emit dataChanged(index(0), index(int(m_displayedRows.size()) - 1),
+                         {NowTitleRole, NextTitleRole, ProgressRole});
+}
+
+int PlaylistModel::epgChannel(quint32 channel) const
+{
+    if (m_epg.isEmpty())
+        return -1;
+
+    if (m_epgChannelsGeneration != m_storeGeneration) {
+        m_epgChannels.clear();
+        m_epgChannelsGeneration = m_storeGeneration;
+    }
+    if (m_epgChannels.size() <= qsizetype(channel))
+        m_epgChannels.resize(m_store.size(), -2);
+
+    qint32 &epg = m_epgChannels[channel];
+    if (epg == -2)
+        epg = m_epg.findChannel(m_store.tvgId(channel), m_store.name(channel));
+    return epg;
+}
+
+void PlaylistModel::onStreamHealthUpdated()
+{
+    // Results come in batches of a few hundred, a full pass is cheap
+    if (m_hideDead && m_categorySelected && !m_streaming)
+        applyDisplayedRows(filteredRows(m_store));
+    if (!m_displayedRows.isEmpty())
+        emit dataChanged(index(0), index(int(m_displayedRows.size()) - 1),
+                         {AliveRole, LatencyRole, LastCheckedRole});
+}
@@ -5,55 +5,259 @@
 #include <QString>
 #include <QList>
 #include <QUrl>
+#include <QFuture>
+#include <QPointer>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
+#include <QThread>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <functional>
+#include <memory>
+#include "playlistbuilder.h"
+#include "playlistcache.h"
+#include "epgguide.h"
+#include "searchresultsmodel.h"
+#include "categorylistmodel.h"
 
-struct Channel {
-    QString name;
-    QUrl url;
-    QString category;
+class PlaylistStreamWorker;
+class EpgLoader;
+class StreamProber;
+class PlaylistCatalogue;
+class PlaylistManager;
+Q_MOC_INCLUDE("playlistmanager.h")
+
+// A playlist's cache as read in the background
+struct CachedPlaylist {
+    bool found = false;
+    ParsedPlaylist playlist;
+    PlaylistCacheInfo info;
+};
+
+// The rows on screen matched to a refreshed store, see
+// PlaylistModel::diffRows()
+struct RowDiff {
+    QList<quint32> rows;                // what the view is to show of the new store
+    QList<quint32> kept;                // rows on screen that stay, renumbered
+    QList<qsizetype> changed;           // positions in kept whose content changed
+    QList<std::pair<int, int>> removed; // (first, count) of the rows on screen
+};
+
+// The merged catalogue built on the thread pool, with its diff
+struct CatalogueBuild {
+    ParsedPlaylist playlist;
+    RowDiff diff;
 };
 
 class PlaylistModel : public QAbstractListModel
 {
     Q_OBJECT
 
-    Q_PROPERTY(QStringList categories READ categories NOTIFY categoriesChanged)
+    Q_PROPERTY(CategoryListModel *categories READ categories CONSTANT)
+    Q_PROPERTY(bool loading READ isLoading NOTIFY loadingChanged)
+    Q_PROPERTY(qreal loadProgress READ loadProgress NOTIFY loadProgressChanged)
+    Q_PROPERTY(SearchResultsModel *searchResults READ searchResults CONSTANT)
+    // Leaves channels the stream check found unreachable out of the view
+    Q_PROPERTY(bool hideDeadChannels READ hideDeadChannels WRITE setHideDeadChannels NOTIFY hideDeadChannelsChanged)
+    // Playlist on screen: its file path or URL, "catalogue" for the merged
+    // catalogue. Keys per-playlist user state, see UserState.
+    Q_PROPERTY(QString source READ source NOTIFY sourceChanged)
+    // Rows of the view including those not fetched yet (rowCount() only
+    // has the fetched ones)
+    Q_PROPERTY(int totalCount READ totalCount NOTIFY totalCountChanged)
 
 public:
     enum ChannelRoles {
         NameRole = Qt::UserRole + 1,
         UrlRole,
-        CategoryRole
+        CategoryRole,
+        NowTitleRole,
+        NextTitleRole,
+        ProgressRole,
+        LogoRole,
+        AliveRole,      // undefined until checked
+        LatencyRole,    // ms
+        LastCheckedRole
     };
 
     explicit PlaylistModel(QObject *parent = nullptr);
+    ~PlaylistModel() override;
 
     int rowCount(const QModelIndex &parent = QModelIndex()) const override;
     QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
     QHash<int, QByteArray> roleNames() const override;
+    // A category is handed to the view a page at a time as it scrolls
+    bool canFetchMore(const QModelIndex &parent) const override;
+    void fetchMore(const QModelIndex &parent) override;
 
-    Q_INVOKABLE void loadPlaylist(const QString &filePath);
+    // refreshMinutes > 0 re-checks the source periodically, see refresh()
+    Q_INVOKABLE void loadPlaylist(const QString &filePath, int refreshMinutes = 0);
+    // Shows the enabled playlists of manager as one catalogue, duplicates
+    // merged, and follows its changes until another playlist is loaded
+    Q_INVOKABLE void loadCatalogue(PlaylistManager *manager);
+    Q_INVOKABLE void cancelLoad();
+    // Fetches the current playlist again and applies only what changed; the
+    // rows on screen and the current item stay where they are
+    Q_INVOKABLE void refresh();
     Q_INVOKABLE void filterChannels(const QString &category, const QString &searchQuery);
+    // Also for rows below totalCount not fetched yet
     Q_INVOKABLE QUrl getChannelUrl(int index) const;
     Q_INVOKABLE QString getChannelName(int index) const;
 
-    QStringList categories() const;
+    // Ranked fuzzy search over all categories, results go to searchResults.
+    // Returns the number of results.
+    Q_INVOKABLE int searchAll(const QString &query, int limit = 50);
+    // Row of a channel (by playlist index) in the current view, or -1.
+    // Fetches the rows up to it if the view has not got that far yet.
+    Q_INVOKABLE int rowForChannel(int channelIndex);
+    // Same for a channel URL, e.g. the one watched last
+    Q_INVOKABLE int rowForUrl(const QUrl &url);
+    // Fetches rows up to row (below totalCount) if needed; returns row, or
+    // -1 if it is out of range
+    Q_INVOKABLE int fetchRow(int row);
+    // The row step rows away from row, wrapping around the whole view and
+    // fetched; -1 if the view is empty
+    Q_INVOKABLE int neighbourRow(int row, int step);
+
+    // Checks every channel stream again, ignoring cached results
+    Q_INVOKABLE void checkStreams();
+
+    // Every source of the channel playing url, best first: several in a
+    // merged catalogue, otherwise none
+    QList<QUrl> channelSources(const QUrl &url) const;
+
+    // Debug readout of the channel storage footprint
+    Q_INVOKABLE QString memoryStats() const;
+
+    CategoryListModel *categories() const;
+    bool isLoading() const;
+    qreal loadProgress() const;
+    SearchResultsModel *searchResults() const;
+    bool hideDeadChannels() const;
+    void setHideDeadChannels(bool hide);
+    QString source() const;
+    int totalCount() const;
 
 signals:
-    void categoriesChanged();
+    void loadingChanged();
+    void loadProgressChanged();
     void loadError(const QString &errorMessage);
+    void hideDeadChannelsChanged();
+    void sourceChanged();
+    void totalCountChanged();
 
 private slots:
     void onNetworkReplyFinished(QNetworkReply *reply);
 
 private:
-    void parsePlaylistContent(const QByteArray &content);
-    
-    QList<Channel> m_allChannels;
-    QList<Channel> m_displayedChannels; // The ones currently visible in the view
-    QStringList m_categories;
+    // readContent runs on the worker thread and sets its argument on failure
+    void parseInBackground(std::function<QByteArray(QString *)> &&readContent, const PlaylistCacheInfo &cacheInfo,
+                           bool refresh = false);
+    void applyParsedPlaylist(ParsedPlaylist &&playlist);
+    void applyRefreshedPlaylist(ParsedPlaylist &&playlist);
+    // Thread-safe: works on the stores and row lists it is given only
+    static RowDiff diffRows(const ChannelStore &old, const QList<quint32> &displayed, const ChannelStore &fresh,
+                            QList<quint32> &&rows);
+    void applyRowDiff(ParsedPlaylist &&playlist, RowDiff &&diff);
+    QList<quint32> filteredRows(const ChannelStore &store) const;
+    // Maps the cache of filePath on the thread pool, then goes on with
+    // continueLoad()
+    void loadCacheInBackground(const QString &filePath);
+    void continueLoad(const QString &filePath, CachedPlaylist &&cached);
+    void applyCachedPlaylist(ParsedPlaylist &&playlist);
+    void indexStoreInBackground();
+    bool channelMatchesFilter(quint32 channel) const;
+    bool isHidden(const ChannelStore &store, quint32 channel) const;
+    void clearPlaylist();
+    void applyDisplayedRows(QList<quint32> &&rows);
+    // Without row signals, for use between beginResetModel() and endResetModel()
+    void setDisplayedRows(QList<quint32> &&rows);
+    // Resets the view to the first page of rows plus whatever is unfetched
+    void resetDisplayedRows(QList<quint32> &&rows);
+    void setLoading(bool loading);
+    void setLoadProgress(qreal progress);
+    void updateTotalCount();
+
+    // Streaming download path
+    void feedStream(QNetworkReply *reply);
+    void onStreamRows(quint64 generation, const ChannelStore &rows);
+    void onStreamFinished(quint64 generation, const QByteArray &epgUrl, qint64 parseNsecs,
+                          std::shared_ptr<ChannelSearchIndex> searchIndex);
+    void resetStream();
+    void buildSearchIndexInBackground(std::function<ChannelSearchIndex()> &&build);
+
+    // Cached playlists from URLs are shown at once and checked with a
+    // conditional GET; only a changed playlist is downloaded and parsed again
+    void revalidate(const QUrl &url);
+    void onRevalidationFinished(QNetworkReply *reply);
+    void saveCacheInBackground(const PlaylistCacheInfo &cacheInfo);
+
+    // Programme guide of the playlist's x-tvg-url
+    void updateEpgSource();
+    void onEpgLoaded();
+    void emitEpgChanged();
+    int epgChannel(quint32 channel) const;
+
+    // Reachability of the channel streams, checked in the background
+    void onStreamHealthUpdated();
+
+    // Merged catalogue mode
+    bool isCatalogueActive() const;
+    void onCatalogueChanged();
+
+    ChannelStore m_store;
+    quint64 m_storeGeneration = 0; // bumped whenever m_store is replaced
+    QList<quint32> m_displayedRows; // Indices into m_store currently visible in the view
+    QList<quint32> m_unfetchedRows; // The rest of the category, after m_displayedRows
+    int m_totalCount = 0; // of both, as last announced
+    ChannelSearchIndex m_searchIndex;
+    SearchResultsModel *m_searchResults;
+    QString m_lastSearchQuery; // re-run after a refresh
+    int m_lastSearchLimit = 0;
+    CategoryListModel *m_categories;
     QNetworkAccessManager *m_networkManager;
+
+    // Current filterChannels() arguments, so streamed rows can be matched
+    QString m_currentCategory;
+    QString m_currentQuery;
+    bool m_categorySelected = false;
+
+    // Every loadPlaylist()/cancelLoad() bumps the generation; results that
+    // arrive for an older generation are dropped.
+    quint64 m_loadGeneration = 0;
+    QPointer<QNetworkReply> m_pendingReply;
+    QFuture<ParsedPlaylist> m_parseFuture;
+    QFuture<CachedPlaylist> m_cacheFuture;
+    bool m_loading = false;
+    qreal m_loadProgress = 0;
+
+    // Where the playlist on screen came from, with its cache validators
+    PlaylistCacheInfo m_sourceInfo;
+    QTimer *m_refreshTimer;
+    QElapsedTimer m_downloadTimer; // of m_pendingReply, for Telemetry
+
+    // Remote playlists are parsed chunk by chunk as readyRead delivers them,
+    // by m_streamWorker on m_streamThread; its row batches are appended to
+    // m_store and shown as they come.
+    QThread m_streamThread;
+    PlaylistStreamWorker *m_streamWorker;
+    bool m_streaming = false;
+    PlaylistCacheInfo m_streamInfo; // of the download, taken over once parsed
+
+    EpgLoader *m_epgLoader;
+    EpgGuide m_epg;
+    QByteArray m_epgSource;
+    QTimer *m_epgTimer; // moves now/next/progress along
+    // Guide channel per store channel, resolved when a row first asks:
+    // -2 unresolved, -1 not in the guide
+    mutable QList<qint32> m_epgChannels;
+    mutable quint64 m_epgChannelsGeneration = 0;
+
+    StreamProber *m_prober;
+    bool m_hideDead = false;
+
+    PlaylistCatalogue *m_catalogue = nullptr; // created by the first loadCatalogue()
+    quint64 m_catalogueBuild = 0; // bumped per build, older ones are dropped
 };
 
 #endif // PLAYLISTMODEL_H
@@ -0,0 +1,129 @@
+#include "playliststreamworker.h"
+#include "gzipdecoder.h"
+#include "m3uparser.h"
+#include "playlistbuilder.h"
+#include <QDebug>
+#include <QElapsedTimer>
+#include <QTimer>
+
+namespace {
+
+// How often parsed rows are handed over while the download goes on
+constexpr int kBatchIntervalMs = 100;
+
+} // namespace
+
+PlaylistStreamWorker::PlaylistStreamWorker(QObject *parent)
+    : QObject(parent)
+    , m_batchTimer(new QTimer(this))
+{
+    m_batchTimer->setSingleShot(true);
+    m_batchTimer->setInterval(kBatchIntervalMs);
+    connect(m_batchTimer, &QTimer::timeout, this, &PlaylistStreamWorker::flushRows);
+}
+
+PlaylistStreamWorker::~PlaylistStreamWorker() = default;
+
+void PlaylistStreamWorker::start(quint64 generation)
+{
+    cancel();
+    m_generation = generation;
+    m_active = true;
+    m_parser = std::make_unique<M3uParser>();
+    m_builder = std::make_unique<PlaylistBuilder>(&m_store);
+}
+
+void PlaylistStreamWorker::cancel()
+{
+    m_batchTimer->stop();
+    m_active = false;
+    m_builder.reset();
+    m_parser.reset();
+    m_decoder.reset();
+    m_store = ChannelStore();
+    m_sniffed = false;
+    m_parseNsecs = 0;
+}
+
+void PlaylistStreamWorker::feed(quint64 generation, const QByteArray &data)
+{
+    if (!m_active || generation != m_generation || data.isEmpty())
+        return;
+
+    QByteArray chunk = data;
+    // Some providers serve the playlist file itself gzipped (.m3u.gz), which
+    // Content-Encoding handling does not cover
+    if (!m_sniffed) {
+        m_sniffed = true;
+        if (GzipDecoder::isGzip(chunk))
+            m_decoder = std::make_unique<GzipDecoder>();
+    }
+    if (m_decoder) {
+        QByteArray inflated;
+        if (!m_decoder->decode(chunk, inflated)) {
+            const QString error = m_decoder->errorString();
+            qWarning() << "Could not decompress playlist:" << error;
+            cancel();
+            emit failed(generation, error);
+            return;
+        }
+        chunk = std::move(inflated);
+    }
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    m_parser->feed(chunk);
+    M3uEntry entry;
+    while (m_parser->next(entry))
+        m_builder->add(entry);
+    m_parseNsecs += parseTimer.nsecsElapsed();
+
+    if (!m_batchTimer->isActive())
+        m_batchTimer->start();
+}
+
+void PlaylistStreamWorker::finish(quint64 generation)
+{
+    if (!m_active || generation != m_generation)
+        return;
+
+    if (m_decoder) {
+        QByteArray inflated;
+        if (!m_decoder->finish(inflated)) {
+            const QString error = m_decoder->errorString();
+            qWarning() << "Could not decompress playlist:" << error;
+            cancel();
+            emit failed(generation, error);
+            return;
+        }
+        m_parser->feed(inflated);
+    }
+
+    QElapsedTimer parseTimer;
+    parseTimer.start();
+    m_parser->finish();
+    M3uEntry entry;
+    while (m_parser->next(entry))
+        m_builder->add(entry);
+    const QByteArray epgUrl = PlaylistBuilder::epgUrl(m_parser->header());
+
+    m_batchTimer->stop();
+    flushRows();
+    auto searchIndex = std::make_shared<ChannelSearchIndex>(m_builder->takeSearchIndexBuilder().build());
+    const qint64 parseNsecs = m_parseNsecs + parseTimer.nsecsElapsed();
+    cancel();
+    emit finished(generation, epgUrl, parseNsecs, searchIndex);
+}
+
+void PlaylistStreamWorker::flushRows()
+{
+    if (!m_active)
+        return;
+    const PlaylistBatch batch = m_builder->takeBatch();
+    if (batch.endChannel == batch.firstChannel)
+        return;
+
+    ChannelStore rows;
+    rows.append(m_store, batch.firstChannel, batch.endChannel);
+    emit rowsReady(m_generation, rows);
+}
@@ -0,0 +1,63 @@
+#ifndef PLAYLISTSTREAMWORKER_H
+#define PLAYLISTSTREAMWORKER_H
+
+#include <QByteArray>
+#include <QObject>
+#include <QString>
+#include <memory>
+#include "channelsearchindex.h"
+#include "channelstore.h"
+
+class GzipDecoder;
+class M3uParser;
+class PlaylistBuilder;
+class QTimer;
+
+// Parses a playlist download chunk by chunk; lives on a thread of its own,
+// so the GUI thread only ever sees finished rows.
+//
+// Each download is identified by a generation (the model's load
+// generation): start() begins one, chunks of any other generation are
+// dropped, and receivers drop signals of a generation that is no longer
+// theirs. New rows are sent as a ChannelStore of just those channels, every
+// batch interval while data keeps coming and once more before finished().
+class PlaylistStreamWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PlaylistStreamWorker(QObject *parent = nullptr);
+    ~PlaylistStreamWorker() override;
+
+    void start(quint64 generation);
+    void feed(quint64 generation, const QByteArray &chunk);
+    // The last line may not end with a newline
+    void finish(quint64 generation);
+    // Drops the download in progress, if any
+    void cancel();
+
+signals:
+    // rows has its own category ids; match them by name
+    void rowsReady(quint64 generation, const ChannelStore &rows);
+    // searchIndex covers every channel sent, numbered in the order sent.
+    // parseNsecs is the time spent parsing alone, apart from the download.
+    void finished(quint64 generation, const QByteArray &epgUrl, qint64 parseNsecs,
+                  std::shared_ptr<ChannelSearchIndex> searchIndex);
+    void failed(quint64 generation, const QString &errorMessage);
+
+private:
+    void flushRows();
+
+    quint64 m_generation = 0;
+    bool m_active = false;
+    // Everything parsed so far; batches are copied out of it
+    ChannelStore m_store;
+    std::unique_ptr<M3uParser> m_parser;
+    std::unique_ptr<PlaylistBuilder> m_builder;
+    std::unique_ptr<GzipDecoder> m_decoder;
+    bool m_sniffed = false;
+    qint64 m_parseNsecs = 0;
+    QTimer *m_batchTimer;
+};
+
+#endif // PLAYLISTSTREAMWORKER_H
@@ -0,0 +1,59 @@
+#include "searchresultsmodel.h"
+
+SearchResultsModel::SearchResultsModel(QObject *parent)
+    : QAbstractListModel(parent)
+{
+}
+
+int SearchResultsModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid())
+        return 0;
+    return int(m_results.count());
+}
+
+QVariant SearchResultsModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_results.count())
+        return QVariant();
+
+    const SearchResult &result = m_results[index.row()];
+
+    switch (role) {
+    case NameRole:
+        return result.name;
+    case CategoryRole:
+        return result.category;
+    case ChannelIndexRole:
+        return result.channelIndex;
+    case ScoreRole:
+        return result.score;
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> SearchResultsModel::roleNames() const
+{
+    QHash<int, QByteArray> roles;
+    roles[NameRole] = "name";
+    roles[CategoryRole] = "category";
+    roles[ChannelIndexRole] = "channelIndex";
+    roles[ScoreRole] = "score";
+    return roles;
+}
+
+int SearchResultsModel::count() const
+{
+    return int(m_results.count());
+}
+
+void SearchResultsModel::setResults(QList<SearchResult> &&results)
+{
+    const bool countChanging = results.count() != m_results.count();
+    beginResetModel();
+    m_results = std::move(results);
+    endResetModel();
+    if (countChanging)
+        emit countChanged();
+}
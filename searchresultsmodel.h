@@ -0,0 +1,46 @@
+#ifndef SEARCHRESULTSMODEL_H
+#define SEARCHRESULTSMODEL_H
+
+#include <QAbstractListModel>
+#include <QList>
+#include <QString>
+
+struct SearchResult {
+    quint32 channelIndex;
+    QString name;
+    QString category;
+    float score;
+};
+
+// Ranked results of PlaylistModel::searchAll(), for QML to bind to
+class SearchResultsModel : public QAbstractListModel
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum ResultRoles {
+        NameRole = Qt::UserRole + 1,
+        CategoryRole,
+        ChannelIndexRole,
+        ScoreRole
+    };
+
+    explicit SearchResultsModel(QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    int count() const;
+    void setResults(QList<SearchResult> &&results);
+
+signals:
+    void countChanged();
+
+private:
+    QList<SearchResult> m_results;
+};
+
+#endif // SEARCHRESULTSMODEL_H
@@ -0,0 +1,130 @@
+#include "startuptrace.h"
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMetaEnum>
+#include <QQuickWindow>
+#include <QSaveFile>
+
+namespace {
+
+const char *phaseName(StartupTrace::Phase phase)
+{
+    return QMetaEnum::fromType<StartupTrace::Phase>().valueToKey(phase);
+}
+
+} // namespace
+
+StartupTrace::StartupTrace(const QElapsedTimer &clock, QObject *parent)
+    : QObject(parent)
+    , m_clock(clock)
+    , m_jsonPath(qEnvironmentVariable("IPTV_STARTUP_TRACE_FILE"))
+{
+    m_msecs.fill(-1);
+    stamp(ProcessStart, 0);
+}
+
+StartupTrace::~StartupTrace()
+{
+    // Whatever was reached, if playback never started
+    writeJson();
+}
+
+void StartupTrace::setWindow(QQuickWindow *window)
+{
+    disconnect(m_frameConnection);
+    m_window = window;
+    if (window && m_msecs[WindowShown] < 0)
+        watchNextFrame();
+}
+
+void StartupTrace::watchNextFrame()
+{
+    if (m_frameConnection || !m_window)
+        return;
+    // frameSwapped comes from the render thread; take the time there and
+    // stamp it on ours
+    m_frameConnection = connect(m_window, &QQuickWindow::frameSwapped, this, [this]() {
+        const qint64 msecs = m_clock.elapsed();
+        QMetaObject::invokeMethod(this, [this, msecs]() { onFrameSwapped(msecs); });
+    }, Qt::DirectConnection);
+}
+
+void StartupTrace::onFrameSwapped(qint64 msecs)
+{
+    stamp(WindowShown, msecs);
+    // A frame swapped before the phase was asked for does not show it yet
+    for (qsizetype i = 0; i < m_onNextFrame.size();) {
+        if (m_onNextFrame[i].second > msecs) {
+            ++i;
+            continue;
+        }
+        stamp(m_onNextFrame.takeAt(i).first, msecs);
+    }
+    // Nothing left to wait for: stop hearing about every frame
+    if (m_onNextFrame.isEmpty())
+        disconnect(m_frameConnection);
+}
+
+void StartupTrace::mark(Phase phase)
+{
+    stamp(phase, m_clock.elapsed());
+}
+
+void StartupTrace::markOnNextFrame(Phase phase)
+{
+    if (phase < 0 || phase >= PhaseCount || m_msecs[phase] >= 0)
+        return;
+    for (const auto &waiting : std::as_const(m_onNextFrame)) {
+        if (waiting.first == phase)
+            return;
+    }
+    if (!m_window) {
+        mark(phase);
+        return;
+    }
+    m_onNextFrame.append({phase, m_clock.elapsed()});
+    watchNextFrame();
+    m_window->update();
+}
+
+QString StartupTrace::summary() const
+{
+    QString text;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        if (m_msecs[phase] >= 0)
+            text += QString("\n%1 %2 ms").arg(phaseName(Phase(phase))).arg(m_msecs[phase]);
+    }
+    return text.mid(1);
+}
+
+void StartupTrace::stamp(Phase phase, qint64 msecs)
+{
+    if (phase < 0 || phase >= PhaseCount || m_msecs[phase] >= 0)
+        return;
+    m_msecs[phase] = msecs;
+    qDebug().noquote() << "Startup:" << phaseName(phase) << "after" << msecs << "ms";
+    emit updated();
+    if (phase == FirstVideoFrame)
+        writeJson();
+}
+
+void StartupTrace::writeJson()
+{
+    if (m_jsonPath.isEmpty() || m_written)
+        return;
+    m_written = true;
+
+    QJsonObject phases;
+    for (int phase = 0; phase < PhaseCount; ++phase) {
+        if (m_msecs[phase] >= 0)
+            phases.insert(phaseName(Phase(phase)), m_msecs[phase]);
+    }
+    const QByteArray json = QJsonDocument(phases).toJson();
+    QDir().mkpath(QFileInfo(m_jsonPath).absolutePath());
+    QSaveFile file(m_jsonPath);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit())
+        qWarning() << "Could not write startup trace to" << m_jsonPath << ":" << file.errorString();
+}
@@ -0,0 +1,69 @@
+#ifndef STARTUPTRACE_H
+#define STARTUPTRACE_H
+
+#include <QElapsedTimer>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <array>
+#include <utility>
+
+class QQuickWindow;
+
+// How long the launch took, phase by phase, measured from the top of
+// main(). Each phase is stamped once, the first time it is reached, and
+// logged. With IPTV_STARTUP_TRACE_FILE set, the phases are written there as
+// JSON once the first video frame is shown (or at exit), so launch-time
+// regressions can be compared between builds.
+class StartupTrace : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString summary READ summary NOTIFY updated)
+
+public:
+    enum Phase {
+        ProcessStart,    // main() entered
+        StateLoaded,     // StateStore read playlists, favourites and history
+        EngineReady,     // Main.qml created
+        WindowShown,     // first frame of the window on screen
+        ListShown,       // first frame with channels in the list
+        FirstVideoFrame, // first decoded frame of the first channel
+        PhaseCount
+    };
+    Q_ENUM(Phase)
+
+    // clock was started at the top of main()
+    explicit StartupTrace(const QElapsedTimer &clock, QObject *parent = nullptr);
+    ~StartupTrace() override;
+
+    // Stamps WindowShown at the first frame of window
+    void setWindow(QQuickWindow *window);
+
+    Q_INVOKABLE void mark(StartupTrace::Phase phase);
+    // For what QML sets up: stamped once the frame showing it is presented
+    Q_INVOKABLE void markOnNextFrame(StartupTrace::Phase phase);
+
+    // "phase ms" lines for the metrics overlay
+    QString summary() const;
+
+signals:
+    void updated();
+
+private:
+    void stamp(Phase phase, qint64 msecs);
+    void watchNextFrame();
+    void onFrameSwapped(qint64 msecs);
+    void writeJson();
+
+    QElapsedTimer m_clock;
+    std::array<qint64, PhaseCount> m_msecs;
+    QPointer<QQuickWindow> m_window;
+    QMetaObject::Connection m_frameConnection; // only while a phase waits for a frame
+    QList<std::pair<Phase, qint64>> m_onNextFrame; // with the time it was asked for
+    QString m_jsonPath;
+    bool m_written = false;
+};
+
+#endif // STARTUPTRACE_H
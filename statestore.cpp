@@ -0,0 +1,257 @@
+#include "statestore.h"
+#include <QDebug>
+#include <QDir>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <QUuid>
+
+namespace {
+
+// Fold the journal into a new snapshot beyond either of these
+constexpr qint64 kMaxJournalRecords = 2000;
+constexpr qint64 kMaxJournalBytes = 1024 * 1024;
+
+constexpr int kFlushDelayMs = 500;
+
+void applyTo(QJsonObject &state, const StateMutation &mutation)
+{
+    if (mutation.value.isUndefined())
+        state.remove(mutation.key);
+    else
+        state.insert(mutation.key, mutation.value);
+}
+
+} // namespace
+
+StateStoreWriter::StateStoreWriter(const QString &directory, const QString &legacyPlaylistsPath)
+    : m_directory(directory)
+    , m_legacyPlaylistsPath(legacyPlaylistsPath)
+    , m_journal(directory + "/journal.log")
+{
+}
+
+void StateStoreWriter::load()
+{
+    QDir().mkpath(m_directory);
+    const bool hadSnapshot = readSnapshot();
+    replayJournal();
+
+    // First start after the switch from playlists.json
+    if (!hadSnapshot && m_journalRecords == 0 && QFile::exists(m_legacyPlaylistsPath)) {
+        QFile legacy(m_legacyPlaylistsPath);
+        if (legacy.open(QIODevice::ReadOnly)) {
+            const QJsonDocument doc = QJsonDocument::fromJson(legacy.readAll());
+            if (doc.isArray()) {
+                // As PlaylistManager keeps them: playlists/<id>, in list order
+                const QJsonArray playlists = doc.array();
+                for (qsizetype i = 0; i < playlists.size(); ++i) {
+                    QJsonObject playlist = playlists[i].toObject();
+                    playlist.insert("position", i);
+                    m_state.insert("playlists/" + QUuid::createUuid().toString(QUuid::WithoutBraces), playlist);
+                }
+                writeSnapshot();
+                qInfo() << "Imported" << playlists.size() << "playlists from" << m_legacyPlaylistsPath;
+            }
+        }
+    }
+
+    if (!m_journal.open(QIODevice::WriteOnly | QIODevice::Append))
+        qWarning() << "Could not open state journal:" << m_journal.errorString();
+    emit loaded(m_state);
+}
+
+bool StateStoreWriter::readSnapshot()
+{
+    QFile file(m_directory + "/snapshot.json");
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    QJsonParseError error;
+    const QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &error);
+    if (!doc.isObject()) {
+        // QSaveFile never leaves a partial file, so this was edited by hand
+        qWarning() << "Ignoring unreadable state snapshot:" << error.errorString();
+        return false;
+    }
+    m_state = doc.object();
+    return true;
+}
+
+void StateStoreWriter::replayJournal()
+{
+    QFile file(m_journal.fileName());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+
+    bool torn = false;
+    while (!file.atEnd()) {
+        const QByteArray line = file.readLine().trimmed();
+        if (line.isEmpty())
+            continue;
+        const QJsonObject record = QJsonDocument::fromJson(line).object();
+        if (!record.contains("k")) {
+            // Only the last write can be cut short; nothing valid follows it
+            torn = true;
+            break;
+        }
+        applyTo(m_state, {record.value("k").toString(), record.value("v")});
+        ++m_journalRecords;
+    }
+    file.close();
+
+    // Appending after a torn line would glue the next record onto it
+    if (torn) {
+        qWarning() << "State journal ends in a partial record; compacting";
+        writeSnapshot();
+    }
+}
+
+bool StateStoreWriter::writeSnapshot()
+{
+    QSaveFile file(m_directory + "/snapshot.json");
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Could not write state snapshot:" << file.errorString();
+        return false;
+    }
+    file.write(QJsonDocument(m_state).toJson(QJsonDocument::Compact));
+    if (!file.commit()) {
+        qWarning() << "Could not write state snapshot:" << file.errorString();
+        return false;
+    }
+
+    // The snapshot holds everything now; only then is the journal dropped
+    if (m_journal.isOpen())
+        m_journal.resize(0);
+    else
+        QFile::resize(m_journal.fileName(), 0);
+    m_journalRecords = 0;
+    return true;
+}
+
+void StateStoreWriter::apply(const QList<StateMutation> &mutations)
+{
+    QByteArray lines;
+    for (const StateMutation &mutation : mutations) {
+        applyTo(m_state, mutation);
+        QJsonObject record{{"k", mutation.key}};
+        if (!mutation.value.isUndefined())
+            record.insert("v", mutation.value);
+        lines += QJsonDocument(record).toJson(QJsonDocument::Compact);
+        lines += '\n';
+    }
+
+    // One write per batch; a crash can only tear its last line
+    if (m_journal.write(lines) != lines.size() || !m_journal.flush())
+        qWarning() << "Could not append to state journal:" << m_journal.errorString();
+    m_journalRecords += mutations.size();
+
+    if (m_journalRecords > kMaxJournalRecords || m_journal.size() > kMaxJournalBytes)
+        writeSnapshot();
+}
+
+StateStore::StateStore(const QString &directory, QObject *parent)
+    : QObject(parent)
+    , m_flushTimer(new QTimer(this))
+{
+    const QString appData = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    m_writer = new StateStoreWriter(directory.isEmpty() ? appData + "/state" : directory,
+                                    appData + "/playlists.json");
+    m_writer->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_writer, &QObject::deleteLater);
+    connect(m_writer, &StateStoreWriter::loaded, this, &StateStore::onLoaded);
+
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(kFlushDelayMs);
+    connect(m_flushTimer, &QTimer::timeout, this, &StateStore::flush);
+
+    m_thread.setObjectName("StateStore");
+    m_thread.start();
+    QMetaObject::invokeMethod(m_writer, &StateStoreWriter::load);
+}
+
+StateStore::~StateStore()
+{
+    // Even if loading has not finished: the writer loads first, then applies
+    m_flushTimer->stop();
+    if (!m_pending.isEmpty()) {
+        QMetaObject::invokeMethod(
+            m_writer, [writer = m_writer, batch = takePending()]() { writer->apply(batch); },
+            Qt::BlockingQueuedConnection);
+    }
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool StateStore::isReady() const
+{
+    return m_ready;
+}
+
+QJsonValue StateStore::value(const QString &key) const
+{
+    return m_values.value(key);
+}
+
+QStringList StateStore::keys(const QString &prefix) const
+{
+    QStringList keys;
+    for (auto it = m_values.constBegin(); it != m_values.constEnd(); ++it) {
+        if (it.key().startsWith(prefix))
+            keys.append(it.key());
+    }
+    return keys;
+}
+
+void StateStore::setValue(const QString &key, const QJsonValue &value)
+{
+    if (m_values.value(key) == value)
+        return;
+    m_values.insert(key, value);
+    m_pending.insert(key, value);
+    if (m_ready && !m_flushTimer->isActive())
+        m_flushTimer->start();
+    emit changed(key);
+}
+
+void StateStore::remove(const QString &key)
+{
+    if (!m_values.contains(key))
+        return;
+    m_values.remove(key);
+    m_pending.insert(key, QJsonValue(QJsonValue::Undefined));
+    if (m_ready && !m_flushTimer->isActive())
+        m_flushTimer->start();
+    emit changed(key);
+}
+
+void StateStore::flush()
+{
+    // Before ready() the pending values still have to be laid over the
+    // loaded ones, see onLoaded()
+    if (!m_ready || m_pending.isEmpty())
+        return;
+    m_flushTimer->stop();
+    QMetaObject::invokeMethod(m_writer, [writer = m_writer, batch = takePending()]() { writer->apply(batch); });
+}
+
+QList<StateMutation> StateStore::takePending()
+{
+    QList<StateMutation> batch;
+    batch.reserve(m_pending.size());
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it)
+        batch.append({it.key(), it.value()});
+    m_pending.clear();
+    return batch;
+}
+
+void StateStore::onLoaded(const QJsonObject &state)
+{
+    m_values = state;
+    for (auto it = m_pending.cbegin(); it != m_pending.cend(); ++it)
+        applyTo(m_values, {it.key(), it.value()});
+    m_ready = true;
+    emit ready();
+    if (!m_pending.isEmpty())
+        m_flushTimer->start();
+}
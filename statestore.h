@@ -0,0 +1,104 @@
+#ifndef STATESTORE_H
+#define STATESTORE_H
+
+#include <QFile>
+#include <QHash>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
+#include <QObject>
+#include <QStringList>
+#include <QThread>
+#include <QTimer>
+
+struct StateMutation {
+    QString key;
+    QJsonValue value; // Undefined removes the key
+};
+
+// Owns the files of a StateStore; runs on its thread.
+//
+//   snapshot.json  every key, replaced atomically (QSaveFile)
+//   journal.log    one JSON line per mutation since the snapshot
+//
+// Mutations are absolute values, so replaying a journal over a snapshot
+// that already contains it is harmless, and a torn last line from a crash
+// is just skipped. Once the journal grows past a limit it is folded into a
+// new snapshot and truncated.
+class StateStoreWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    StateStoreWriter(const QString &directory, const QString &legacyPlaylistsPath);
+
+    void load();
+    void apply(const QList<StateMutation> &mutations);
+
+signals:
+    void loaded(const QJsonObject &state);
+
+private:
+    bool readSnapshot();
+    void replayJournal();
+    bool writeSnapshot();
+
+    QString m_directory;
+    QString m_legacyPlaylistsPath;
+    QJsonObject m_state;
+    QFile m_journal;
+    qint64 m_journalRecords = 0;
+};
+
+// Small, frequently changed app state: the playlist list, favourites,
+// history. Keys map to JSON values; reads come from memory, writes are
+// coalesced per key for a short while and then handed to a
+// StateStoreWriter thread as one batch, so the GUI thread never waits on
+// the disk.
+//
+// Loading happens on that thread as well: the store starts empty and emits
+// ready() once the files are read. Values set before then are kept and win
+// over what was loaded for the same key.
+//
+// A key is what gets merged and what a journal record holds, so
+// collections keep one key per item (<collection>/<item>) rather than one
+// array: an item added before ready() joins the loaded ones, and changing
+// one item writes just that item.
+class StateStore : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(bool ready READ isReady NOTIFY ready)
+
+public:
+    // directory defaults to <AppDataLocation>/state
+    explicit StateStore(const QString &directory = QString(), QObject *parent = nullptr);
+    // Writes whatever is pending before returning
+    ~StateStore() override;
+
+    bool isReady() const;
+    QJsonValue value(const QString &key) const;
+    // Keys starting with prefix, in key order
+    QStringList keys(const QString &prefix) const;
+    void setValue(const QString &key, const QJsonValue &value);
+    void remove(const QString &key);
+    // Hands pending mutations to the writer now instead of after the delay
+    void flush();
+
+signals:
+    void ready();
+    void changed(const QString &key);
+
+private:
+    void onLoaded(const QJsonObject &state);
+    QList<StateMutation> takePending();
+
+    QThread m_thread;
+    StateStoreWriter *m_writer;
+    QJsonObject m_values;
+    QHash<QString, QJsonValue> m_pending; // latest value per key
+    QTimer *m_flushTimer;
+    bool m_ready = false;
+};
+
+#endif // STATESTORE_H
@@ -0,0 +1,456 @@
+#include "streamprober.h"
+#include "channelstore.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QSaveFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QThreadPool>
+#include <utility>
+
+namespace {
+
+constexpr int kPerHost = 4;    // below the manager's 6 connections per host
+constexpr int kMaxActive = 32;
+constexpr int kMaxHops = 2;    // master playlist -> media playlist -> segment
+constexpr qint64 kMaxPlaylistBytes = 256 * 1024;
+
+// Results are trusted this long before a channel is checked again
+constexpr qint64 kAliveTtlSecs = 6 * 3600;
+constexpr qint64 kDeadTtlSecs = 30 * 60;
+// and dropped from disk after this long
+constexpr qint64 kForgetSecs = 7 * 24 * 3600;
+
+constexpr quint32 kCacheMagic = 0x49504853; // "IPHS"
+constexpr quint32 kCacheVersion = 1;
+
+bool isPlaylistUrl(const QUrl &url)
+{
+    const QString path = url.path();
+    return path.endsWith(".m3u8", Qt::CaseInsensitive) || path.endsWith(".m3u", Qt::CaseInsensitive);
+}
+
+bool isPlaylistReply(QNetworkReply *reply)
+{
+    return isPlaylistUrl(reply->url())
+           || reply->header(QNetworkRequest::ContentTypeHeader).toString().contains("mpegurl", Qt::CaseInsensitive);
+}
+
+// First media entry of an HLS playlist: a variant playlist of a master
+// playlist or the first segment of a media playlist
+QUrl firstEntry(const QByteArray &playlist, const QUrl &base)
+{
+    qsizetype from = 0;
+    while (from < playlist.size()) {
+        qsizetype to = playlist.indexOf('\n', from);
+        if (to < 0)
+            break; // a truncated last line is not trustworthy
+        const QByteArray line = playlist.mid(from, to - from).trimmed();
+        from = to + 1;
+        if (!line.isEmpty() && !line.startsWith('#'))
+            return base.resolved(QUrl(QString::fromUtf8(line)));
+    }
+    return QUrl();
+}
+
+void writeCache(const QString &path, const QHash<quint64, StreamHealth> &results)
+{
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QByteArray bytes;
+    {
+        QDataStream stream(&bytes, QIODevice::WriteOnly);
+        stream.setVersion(QDataStream::Qt_6_0);
+        quint32 count = 0;
+        for (const StreamHealth &health : results)
+            count += now - health.checked < kForgetSecs;
+        stream << kCacheMagic << kCacheVersion << count;
+        for (auto it = results.cbegin(); it != results.cend(); ++it) {
+            if (now - it->checked < kForgetSecs)
+                stream << it.key() << quint8(it->state) << it->latency << it->checked;
+        }
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size() || !file.commit())
+        qWarning() << "Could not write stream health cache:" << file.errorString();
+}
+
+} // namespace
+
+StreamProbeWorker::StreamProbeWorker(int timeoutMs)
+    : m_timeoutMs(timeoutMs)
+{
+}
+
+void StreamProbeWorker::enqueue(quint64 generation, const QList<StreamProbeTarget> &targets)
+{
+    cancel(generation);
+    for (const StreamProbeTarget &target : targets) {
+        auto job = std::make_shared<Job>();
+        job->key = target.key;
+        job->url = QUrl(QString::fromUtf8(target.url));
+        queue(job);
+    }
+    pump();
+}
+
+void StreamProbeWorker::cancel(quint64 generation)
+{
+    // Created here, on the worker thread, so their signals arrive here too
+    if (!m_network) {
+        m_network = new QNetworkAccessManager(this);
+        m_flushTimer = new QTimer(this);
+        m_flushTimer->setSingleShot(true);
+        m_flushTimer->setInterval(250);
+        connect(m_flushTimer, &QTimer::timeout, this, &StreamProbeWorker::flush);
+    }
+    if (generation == m_generation)
+        return;
+
+    m_generation = generation;
+    m_queues.clear();
+    m_hosts.clear();
+    m_nextHost = 0;
+    m_results.clear();
+    m_flushTimer->stop();
+    // Finishes them synchronously; onFinished() drops the old generation
+    const QList<QNetworkReply *> replies = m_network->findChildren<QNetworkReply *>();
+    for (QNetworkReply *reply : replies)
+        reply->abort();
+}
+
+void StreamProbeWorker::queue(const JobPtr &job, bool front)
+{
+    const QString host = job->url.host();
+    QList<JobPtr> &jobs = m_queues[host];
+    if (jobs.isEmpty())
+        m_hosts.append(host);
+    if (front)
+        jobs.prepend(job);
+    else
+        jobs.append(job);
+}
+
+void StreamProbeWorker::pump()
+{
+    // Round robin over the hosts so one big provider does not hold up the rest
+    bool started = true;
+    while (started && m_active < kMaxActive && !m_hosts.isEmpty()) {
+        started = false;
+        for (qsizetype n = m_hosts.size(); n > 0 && m_active < kMaxActive; --n) {
+            if (m_nextHost >= m_hosts.size())
+                m_nextHost = 0;
+            const QString host = m_hosts[m_nextHost];
+            if (m_activePerHost.value(host) >= kPerHost) {
+                ++m_nextHost;
+                continue;
+            }
+
+            QList<JobPtr> &jobs = m_queues[host];
+            const JobPtr job = jobs.takeFirst();
+            if (jobs.isEmpty()) {
+                m_queues.remove(host);
+                m_hosts.removeAt(m_nextHost);
+            } else {
+                ++m_nextHost;
+            }
+            start(job);
+            started = true;
+        }
+    }
+}
+
+void StreamProbeWorker::start(const JobPtr &job)
+{
+    if (!job->url.isValid() || job->url.host().isEmpty()) {
+        complete(job, false);
+        return;
+    }
+
+    QNetworkRequest request(job->url);
+    request.setRawHeader("User-Agent", "IPTV Player");
+    // Playlists are read whole; for anything else the first bytes will do
+    if (!isPlaylistUrl(job->url))
+        request.setRawHeader("Range", "bytes=0-1023");
+    request.setTransferTimeout(m_timeoutMs);
+    if (!job->timer.isValid())
+        job->timer.start();
+
+    const QString host = job->url.host();
+    ++m_activePerHost[host];
+    ++m_active;
+
+    QNetworkReply *reply = m_network->get(request);
+    reply->setProperty("host", host);
+    reply->setProperty("generation", m_generation);
+    connect(reply, &QNetworkReply::metaDataChanged, this, [job]() {
+        if (job->latency < 0)
+            job->latency = qint32(job->timer.elapsed());
+    });
+    connect(reply, &QIODevice::readyRead, this, [this, job, reply]() { onReadyRead(job, reply); });
+    connect(reply, &QNetworkReply::finished, this, [this, job, reply]() { onFinished(job, reply); });
+}
+
+void StreamProbeWorker::onReadyRead(const JobPtr &job, QNetworkReply *reply)
+{
+    if (reply->property("verdict").isValid())
+        return;
+
+    const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 416) {
+        // A live stream refusing the range, as in onFinished()
+        reply->setProperty("verdict", true);
+        reply->abort();
+        return;
+    }
+    if (status >= 400) {
+        reply->setProperty("verdict", false);
+        reply->abort();
+        return;
+    }
+    if (isPlaylistReply(reply)) {
+        // Wait for the whole playlist, unless it is unreasonably large
+        if (reply->bytesAvailable() > kMaxPlaylistBytes || job->hops >= kMaxHops) {
+            reply->setProperty("verdict", true);
+            reply->abort();
+        }
+        return;
+    }
+
+    // Media bytes are flowing, that is all we wanted to know
+    reply->setProperty("verdict", true);
+    reply->abort();
+}
+
+void StreamProbeWorker::onFinished(const JobPtr &job, QNetworkReply *reply)
+{
+    reply->deleteLater();
+    const QString host = reply->property("host").toString();
+    if (--m_activePerHost[host] <= 0)
+        m_activePerHost.remove(host);
+    --m_active;
+
+    if (reply->property("generation").toULongLong() == m_generation) {
+        if (job->latency < 0)
+            job->latency = qint32(job->timer.elapsed());
+
+        const QVariant verdict = reply->property("verdict");
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (verdict.isValid()) {
+            complete(job, verdict.toBool());
+        } else if (status == 416) {
+            // Live streams without a length refuse ranges, but they exist
+            complete(job, true);
+        } else if (reply->error() != QNetworkReply::NoError) {
+            complete(job, false);
+        } else if (isPlaylistReply(reply)) {
+            const QUrl next = firstEntry(reply->readAll(), reply->url());
+            if (next.isValid() && job->hops < kMaxHops) {
+                ++job->hops;
+                job->url = next;
+                queue(job, true);
+            } else {
+                complete(job, false); // an empty playlist plays nothing
+            }
+        } else {
+            complete(job, false); // answered, but without a single byte
+        }
+    }
+    pump();
+}
+
+void StreamProbeWorker::complete(const JobPtr &job, bool alive)
+{
+    StreamProbeResult result;
+    result.key = job->key;
+    result.health.state = alive ? StreamHealth::Alive : StreamHealth::Dead;
+    result.health.latency = job->latency;
+    result.health.checked = QDateTime::currentSecsSinceEpoch();
+    m_results.append(result);
+
+    // Reported in batches so the GUI thread is not flooded
+    if (!m_flushTimer->isActive())
+        m_flushTimer->start();
+}
+
+void StreamProbeWorker::flush()
+{
+    if (!m_results.isEmpty())
+        emit probed(m_generation, std::exchange(m_results, {}));
+}
+
+StreamProber::StreamProber(QObject *parent, int timeoutMs)
+    : QObject(parent)
+    , m_worker(new StreamProbeWorker(timeoutMs))
+    , m_saveTimer(new QTimer(this))
+{
+    m_worker->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_worker, &QObject::deleteLater);
+    connect(m_worker, &StreamProbeWorker::probed, this, &StreamProber::onProbed);
+    m_thread.setObjectName("StreamProber");
+    m_thread.start(QThread::LowPriority);
+
+    m_saveTimer->setSingleShot(true);
+    m_saveTimer->setInterval(5000);
+    connect(m_saveTimer, &QTimer::timeout, this, &StreamProber::save);
+}
+
+StreamProber::~StreamProber()
+{
+    m_thread.quit();
+    m_thread.wait();
+    // Results of the last few seconds, on the way out there is no pool
+    if (m_saveTimer->isActive())
+        writeCache(cachePath(), m_results);
+}
+
+void StreamProber::probe(const ChannelStore &store, bool force)
+{
+    ensureLoaded();
+    ++m_generation;
+
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+    QList<StreamProbeTarget> targets;
+    QSet<quint64> seen;
+    for (qsizetype channel = 0; channel < store.size(); ++channel) {
+        const QByteArrayView url = store.field(quint32(channel), ChannelStore::UrlField);
+        // rtmp, udp and the like cannot be checked with a GET
+        if (!url.startsWith("http://") && !url.startsWith("https://"))
+            continue;
+        const quint64 key = urlKey(url);
+        if (seen.contains(key))
+            continue;
+        seen.insert(key);
+        if (!force) {
+            const auto it = m_results.constFind(key);
+            if (it != m_results.cend() && !isStale(*it, now))
+                continue;
+        }
+        targets.append({key, url.toByteArray()});
+    }
+
+    m_pending = targets.size();
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, generation = m_generation, targets = std::move(targets)]() {
+        worker->enqueue(generation, targets);
+    });
+    if (m_pending == 0)
+        emit finished();
+}
+
+void StreamProber::cancel()
+{
+    ++m_generation;
+    m_pending = 0;
+    QMetaObject::invokeMethod(m_worker, [worker = m_worker, generation = m_generation]() {
+        worker->cancel(generation);
+    });
+}
+
+bool StreamProber::isProbing() const
+{
+    return m_pending > 0;
+}
+
+StreamHealth StreamProber::health(QByteArrayView url) const
+{
+    return m_results.value(urlKey(url));
+}
+
+quint64 StreamProber::urlKey(QByteArrayView url)
+{
+    // FNV-1a: unlike qHash it is the same on every run and machine
+    quint64 hash = 0xcbf29ce484222325ULL;
+    for (char c : url) {
+        hash ^= quint8(c);
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+void StreamProber::onProbed(quint64 generation, const QList<StreamProbeResult> &results)
+{
+    // Results of a superseded run are still true, keep them
+    for (const StreamProbeResult &result : results)
+        m_results.insert(result.key, result.health);
+    if (!m_saveTimer->isActive())
+        m_saveTimer->start();
+    emit updated();
+
+    if (generation != m_generation)
+        return;
+    m_pending -= results.size();
+    if (m_pending <= 0) {
+        m_pending = 0;
+        emit finished();
+    }
+}
+
+bool StreamProber::isStale(const StreamHealth &health, qint64 now)
+{
+    switch (health.state) {
+    case StreamHealth::Alive:
+        return now - health.checked > kAliveTtlSecs;
+    case StreamHealth::Dead:
+        return now - health.checked > kDeadTtlSecs;
+    default:
+        return true;
+    }
+}
+
+QString StreamProber::cachePath()
+{
+    return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/stream-health.bin";
+}
+
+void StreamProber::ensureLoaded()
+{
+    if (m_loaded)
+        return;
+    m_loaded = true;
+
+    // A few hundred KB even for big playlists, read on first use
+    QFile file(cachePath());
+    if (!file.open(QIODevice::ReadOnly))
+        return;
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_6_0);
+    quint32 magic = 0;
+    quint32 version = 0;
+    quint32 count = 0;
+    stream >> magic >> version >> count;
+    if (magic != kCacheMagic || version != kCacheVersion)
+        return;
+
+    QHash<quint64, StreamHealth> results;
+    results.reserve(count);
+    for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i) {
+        quint64 key = 0;
+        quint8 state = 0;
+        StreamHealth health;
+        stream >> key >> state >> health.latency >> health.checked;
+        if (state > StreamHealth::Dead)
+            return;
+        health.state = StreamHealth::State(state);
+        results.insert(key, health);
+    }
+    if (stream.status() != QDataStream::Ok)
+        return;
+    // Anything probed meanwhile is newer
+    results.insert(m_results);
+    m_results = std::move(results);
+}
+
+void StreamProber::save()
+{
+    QThreadPool::globalInstance()->start([path = cachePath(), results = m_results]() {
+        writeCache(path, results);
+    });
+}
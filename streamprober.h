@@ -0,0 +1,133 @@
+#ifndef STREAMPROBER_H
+#define STREAMPROBER_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QObject>
+#include <QThread>
+#include <QTimer>
+#include <QUrl>
+#include <memory>
+
+class ChannelStore;
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Reachability of one stream URL
+struct StreamHealth {
+    enum State : quint8 { Unknown, Alive, Dead };
+
+    State state = Unknown;
+    qint32 latency = -1; // ms until the server answered
+    qint64 checked = 0;  // secs since epoch
+};
+
+struct StreamProbeTarget {
+    quint64 key;
+    QByteArray url;
+};
+
+struct StreamProbeResult {
+    quint64 key;
+    StreamHealth health;
+};
+
+// Runs the requests on StreamProber's thread, with its own network manager
+// so that 50k replies never queue behind the GUI. One queue per host, served
+// round robin, at most kPerHost requests per host so keep-alive connections
+// are reused instead of opening new ones.
+class StreamProbeWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit StreamProbeWorker(int timeoutMs);
+
+    // Both drop the work of any other generation first
+    void enqueue(quint64 generation, const QList<StreamProbeTarget> &targets);
+    void cancel(quint64 generation);
+
+signals:
+    void probed(quint64 generation, const QList<StreamProbeResult> &results);
+
+private:
+    struct Job {
+        quint64 key;
+        QUrl url;
+        int hops = 0; // HLS playlists followed so far
+        QElapsedTimer timer;
+        qint32 latency = -1;
+    };
+    using JobPtr = std::shared_ptr<Job>;
+
+    void queue(const JobPtr &job, bool front = false);
+    void pump();
+    void start(const JobPtr &job);
+    void onReadyRead(const JobPtr &job, QNetworkReply *reply);
+    void onFinished(const JobPtr &job, QNetworkReply *reply);
+    void complete(const JobPtr &job, bool alive);
+    void flush();
+
+    int m_timeoutMs;
+    QNetworkAccessManager *m_network = nullptr;
+    QTimer *m_flushTimer = nullptr;
+    quint64 m_generation = 0;
+    QHash<QString, QList<JobPtr>> m_queues; // by host
+    QList<QString> m_hosts;                  // hosts with queued jobs
+    qsizetype m_nextHost = 0;
+    QHash<QString, int> m_activePerHost;
+    int m_active = 0;
+    QList<StreamProbeResult> m_results; // not yet reported
+};
+
+// Checks whether the channels of a playlist can be reached, without playing
+// them: a ranged GET that stops at the first bytes, and for HLS the playlist
+// plus the first bytes of its first segment. Results are kept on disk and
+// only re-checked once they are stale, so reopening a playlist costs nothing.
+//
+// Lives on the GUI thread; lookups are a hash probe.
+class StreamProber : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr int DefaultTimeoutMs = 5000;
+
+    explicit StreamProber(QObject *parent = nullptr, int timeoutMs = DefaultTimeoutMs);
+    ~StreamProber() override;
+
+    // Checks every http(s) channel whose result is missing or stale; force
+    // checks them all. Replaces whatever was still being checked.
+    void probe(const ChannelStore &store, bool force = false);
+    void cancel();
+    bool isProbing() const;
+
+    StreamHealth health(QByteArrayView url) const;
+
+    // Stable across runs, used as the key on disk
+    static quint64 urlKey(QByteArrayView url);
+
+signals:
+    // Some results changed (batched, a few times per second at most)
+    void updated();
+    void finished();
+
+private:
+    void onProbed(quint64 generation, const QList<StreamProbeResult> &results);
+    void ensureLoaded();
+    void save();
+    static bool isStale(const StreamHealth &health, qint64 now);
+    static QString cachePath();
+
+    QThread m_thread;
+    StreamProbeWorker *m_worker;
+    quint64 m_generation = 0;
+    qsizetype m_pending = 0;
+
+    QHash<quint64, StreamHealth> m_results;
+    bool m_loaded = false;
+    QTimer *m_saveTimer;
+};
+
+#endif // STREAMPROBER_H
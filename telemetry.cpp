@@ -0,0 +1,370 @@
+#include "telemetry.h"
+#include "lockfreering.h"
+#include "streamprober.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QMutex>
+#include <QSaveFile>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QUrl>
+
+namespace {
+
+using EventRing = LockFreeRing<TelemetryEvent, 4096>;
+Q_GLOBAL_STATIC(EventRing, eventRing)
+
+struct SubjectNames {
+    QMutex mutex;
+    QHash<quint64, QString> urls;
+};
+Q_GLOBAL_STATIC(SubjectNames, subjectNames)
+
+QString nameOf(quint64 subject)
+{
+    QMutexLocker locker(&subjectNames->mutex);
+    return subjectNames->urls.value(subject);
+}
+
+QString providerOf(const QString &url)
+{
+    const QString host = QUrl(url).host();
+    return host.isEmpty() ? QStringLiteral("local") : host;
+}
+
+QByteArray escapeLabel(const QString &value)
+{
+    QByteArray escaped = value.toUtf8();
+    escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+    return escaped;
+}
+
+QJsonObject statToJson(qint64 count, double sumMs, double maxMs)
+{
+    QJsonObject object;
+    object["count"] = count;
+    object["sumMs"] = sumMs;
+    object["maxMs"] = maxMs;
+    object["avgMs"] = count > 0 ? sumMs / double(count) : 0.0;
+    return object;
+}
+
+} // namespace
+
+void Telemetry::Stat::add(double ms)
+{
+    ++count;
+    sumMs += ms;
+    maxMs = qMax(maxMs, ms);
+}
+
+Telemetry::Telemetry(QObject *parent)
+    : QObject(parent)
+    , m_drainTimer(new QTimer(this))
+{
+    m_drainTimer->setInterval(1000);
+    connect(m_drainTimer, &QTimer::timeout, this, &Telemetry::drain);
+    m_drainTimer->start();
+}
+
+Telemetry::~Telemetry()
+{
+    // The last interval would be lost otherwise
+    if (!m_jsonPath.isEmpty())
+        writeJson(m_jsonPath);
+}
+
+void Telemetry::record(TelemetryEvent::Kind kind, quint64 subject, qint32 value, qint32 detail)
+{
+    TelemetryEvent event;
+    event.time = QDateTime::currentMSecsSinceEpoch();
+    event.subject = subject;
+    event.value = value;
+    event.detail = detail;
+    event.kind = kind;
+    eventRing->push(event);
+}
+
+quint64 Telemetry::subject(const QString &url)
+{
+    const quint64 key = StreamProber::urlKey(url.toUtf8());
+    QMutexLocker locker(&subjectNames->mutex);
+    if (!subjectNames->urls.contains(key))
+        subjectNames->urls.insert(key, url);
+    return key;
+}
+
+void Telemetry::drain()
+{
+    bool changed = false;
+    TelemetryEvent event;
+    while (eventRing->pop(&event)) {
+        changed = true;
+        SubjectStats &stats = m_subjects[event.subject];
+        switch (event.kind) {
+        case TelemetryEvent::PlaylistDownload:
+            stats.download.add(event.value);
+            m_lastDownload = event;
+            break;
+        case TelemetryEvent::PlaylistParse:
+            stats.parse.add(event.value);
+            m_lastParse = event;
+            break;
+        case TelemetryEvent::PlaylistError:
+            ++stats.playlistErrors[event.value];
+            m_lastError = event;
+            break;
+        case TelemetryEvent::FirstFrame:
+            (event.detail ? stats.firstFrameWarm : stats.firstFrameCold).add(event.value);
+            m_lastFirstFrame = event;
+            break;
+        case TelemetryEvent::Stall:
+            stats.stall.add(event.value);
+            ++m_stalls;
+            m_stallMs += event.value;
+            break;
+        case TelemetryEvent::PlaybackError:
+            ++stats.playbackErrors[event.value];
+            m_lastError = event;
+            break;
+        }
+    }
+    if (changed)
+        emit updated();
+}
+
+QString Telemetry::overlayText() const
+{
+    QStringList lines;
+    if (m_lastFirstFrame.time > 0) {
+        lines.append(QString("TTFF: %1 ms (%2)")
+                         .arg(m_lastFirstFrame.value)
+                         .arg(m_lastFirstFrame.detail ? "warm" : "cold"));
+    }
+
+    Stat warm;
+    Stat cold;
+    for (const SubjectStats &stats : m_subjects) {
+        warm.count += stats.firstFrameWarm.count;
+        warm.sumMs += stats.firstFrameWarm.sumMs;
+        cold.count += stats.firstFrameCold.count;
+        cold.sumMs += stats.firstFrameCold.sumMs;
+    }
+    if (warm.count + cold.count > 0) {
+        lines.append(QString("TTFF avg: warm %1 ms (%2), cold %3 ms (%4)")
+                         .arg(warm.count ? qRound(warm.sumMs / warm.count) : 0)
+                         .arg(warm.count)
+                         .arg(cold.count ? qRound(cold.sumMs / cold.count) : 0)
+                         .arg(cold.count));
+    }
+    lines.append(QString("Stalls: %1, %2 s").arg(m_stalls).arg(m_stallMs / 1000.0, 0, 'f', 1));
+    if (m_lastDownload.time > 0)
+        lines.append(QString("Playlist download: %1 ms").arg(m_lastDownload.value));
+    if (m_lastParse.time > 0)
+        lines.append(QString("Playlist parse: %1 ms").arg(m_lastParse.value));
+    if (m_lastError.time > 0) {
+        lines.append(QString("Last error: %1 %2 (%3)")
+                         .arg(m_lastError.kind == TelemetryEvent::PlaybackError ? "playback" : "playlist")
+                         .arg(m_lastError.value)
+                         .arg(QDateTime::fromMSecsSinceEpoch(m_lastError.time).toString("HH:mm:ss")));
+    }
+    if (const quint64 dropped = eventRing->dropped())
+        lines.append(QString("Dropped events: %1").arg(dropped));
+    return lines.join('\n');
+}
+
+QByteArray Telemetry::prometheusText()
+{
+    drain();
+
+    struct Series {
+        const char *name;
+        const char *help;
+        const char *type;
+        QByteArray samples;
+    };
+    Series download{"iptv_playlist_download_seconds", "Time to download a playlist.", "summary", {}};
+    Series parse{"iptv_playlist_parse_seconds", "Time spent parsing a playlist.", "summary", {}};
+    Series playlistErrors{"iptv_playlist_errors_total", "Failed playlist downloads by network error code.", "counter", {}};
+    Series firstFrame{"iptv_time_to_first_frame_seconds", "Time from a channel switch to its first frame.", "summary", {}};
+    Series stalls{"iptv_stall_seconds", "Playback stalls while buffering.", "summary", {}};
+    Series playbackErrors{"iptv_playback_errors_total", "Playback errors by QMediaPlayer::Error code.", "counter", {}};
+
+    const auto addStat = [](Series &series, const QByteArray &labels, const Stat &stat) {
+        if (stat.count == 0)
+            return;
+        series.samples += series.name + QByteArray("_sum{") + labels + "} " + QByteArray::number(stat.sumMs / 1000.0) + '\n';
+        series.samples += series.name + QByteArray("_count{") + labels + "} " + QByteArray::number(stat.count) + '\n';
+    };
+    const auto addCounts = [](Series &series, const QByteArray &labels, const QMap<qint32, quint64> &counts) {
+        for (auto it = counts.cbegin(); it != counts.cend(); ++it) {
+            series.samples += series.name + QByteArray("{") + labels + ",code=\"" + QByteArray::number(it.key())
+                              + "\"} " + QByteArray::number(it.value()) + '\n';
+        }
+    };
+
+    for (auto it = m_subjects.cbegin(); it != m_subjects.cend(); ++it) {
+        const QString url = nameOf(it.key());
+        const QByteArray labels = "url=\"" + escapeLabel(url) + "\",provider=\"" + escapeLabel(providerOf(url)) + '"';
+        const SubjectStats &stats = it.value();
+        addStat(download, labels, stats.download);
+        addStat(parse, labels, stats.parse);
+        addCounts(playlistErrors, labels, stats.playlistErrors);
+        addStat(firstFrame, labels + ",start=\"warm\"", stats.firstFrameWarm);
+        addStat(firstFrame, labels + ",start=\"cold\"", stats.firstFrameCold);
+        addStat(stalls, labels, stats.stall);
+        addCounts(playbackErrors, labels, stats.playbackErrors);
+    }
+
+    QByteArray text;
+    for (const Series *series : {&download, &parse, &playlistErrors, &firstFrame, &stalls, &playbackErrors}) {
+        text += QByteArray("# HELP ") + series->name + ' ' + series->help + '\n';
+        text += QByteArray("# TYPE ") + series->name + ' ' + series->type + '\n';
+        text += series->samples;
+    }
+    text += "# HELP iptv_telemetry_dropped_events_total Events lost because the ring was full.\n"
+            "# TYPE iptv_telemetry_dropped_events_total counter\n"
+            "iptv_telemetry_dropped_events_total "
+            + QByteArray::number(eventRing->dropped()) + '\n';
+    return text;
+}
+
+QJsonObject Telemetry::toJson()
+{
+    drain();
+
+    const auto statJson = [](const Stat &stat) { return statToJson(qint64(stat.count), stat.sumMs, stat.maxMs); };
+    const auto countsJson = [](const QMap<qint32, quint64> &counts) {
+        QJsonObject object;
+        for (auto it = counts.cbegin(); it != counts.cend(); ++it)
+            object[QString::number(it.key())] = qint64(it.value());
+        return object;
+    };
+
+    QJsonArray subjects;
+    QHash<QString, SubjectStats> providers;
+    for (auto it = m_subjects.cbegin(); it != m_subjects.cend(); ++it) {
+        const QString url = nameOf(it.key());
+        const SubjectStats &stats = it.value();
+
+        QJsonObject object;
+        object["url"] = url;
+        object["provider"] = providerOf(url);
+        object["playlistDownload"] = statJson(stats.download);
+        object["playlistParse"] = statJson(stats.parse);
+        object["playlistErrors"] = countsJson(stats.playlistErrors);
+        object["firstFrameWarm"] = statJson(stats.firstFrameWarm);
+        object["firstFrameCold"] = statJson(stats.firstFrameCold);
+        object["stalls"] = statJson(stats.stall);
+        object["playbackErrors"] = countsJson(stats.playbackErrors);
+        subjects.append(object);
+
+        SubjectStats &provider = providers[providerOf(url)];
+        const auto merge = [](Stat &into, const Stat &from) {
+            into.count += from.count;
+            into.sumMs += from.sumMs;
+            into.maxMs = qMax(into.maxMs, from.maxMs);
+        };
+        merge(provider.download, stats.download);
+        merge(provider.parse, stats.parse);
+        merge(provider.firstFrameWarm, stats.firstFrameWarm);
+        merge(provider.firstFrameCold, stats.firstFrameCold);
+        merge(provider.stall, stats.stall);
+        for (auto error = stats.playlistErrors.cbegin(); error != stats.playlistErrors.cend(); ++error)
+            provider.playlistErrors[error.key()] += error.value();
+        for (auto error = stats.playbackErrors.cbegin(); error != stats.playbackErrors.cend(); ++error)
+            provider.playbackErrors[error.key()] += error.value();
+    }
+
+    QJsonObject providerJson;
+    for (auto it = providers.cbegin(); it != providers.cend(); ++it) {
+        QJsonObject object;
+        object["playlistDownload"] = statJson(it->download);
+        object["playlistParse"] = statJson(it->parse);
+        object["playlistErrors"] = countsJson(it->playlistErrors);
+        object["firstFrameWarm"] = statJson(it->firstFrameWarm);
+        object["firstFrameCold"] = statJson(it->firstFrameCold);
+        object["stalls"] = statJson(it->stall);
+        object["playbackErrors"] = countsJson(it->playbackErrors);
+        providerJson[it.key()] = object;
+    }
+
+    QJsonObject root;
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["droppedEvents"] = qint64(eventRing->dropped());
+    root["subjects"] = subjects;
+    root["providers"] = providerJson;
+    return root;
+}
+
+bool Telemetry::listen(quint16 port)
+{
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection, this, &Telemetry::serve);
+    }
+    // Local only: the labels contain playlist and stream URLs
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
+        qWarning() << "Could not serve metrics on port" << port << ":" << m_server->errorString();
+        return false;
+    }
+    qInfo().noquote() << "Serving metrics on" << QString("http://127.0.0.1:%1/metrics").arg(port);
+    return true;
+}
+
+void Telemetry::serve()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            // Only the request line matters; wait for the end of the headers
+            QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+            if (!request.contains("\r\n\r\n")) {
+                if (request.size() > 8192)
+                    socket->abort();
+                else
+                    socket->setProperty("request", request);
+                return;
+            }
+
+            const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+            QByteArray status = "200 OK";
+            QByteArray body;
+            if (requestLine.size() < 2 || requestLine[0] != "GET") {
+                status = "405 Method Not Allowed";
+            } else if (requestLine[1] == "/metrics") {
+                body = prometheusText();
+            } else {
+                status = "404 Not Found";
+            }
+            socket->write("HTTP/1.1 " + status + "\r\n"
+                          "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                          "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                          "Connection: close\r\n\r\n"
+                          + body);
+            socket->disconnectFromHost();
+        });
+    }
+}
+
+void Telemetry::writeJsonPeriodically(const QString &path, int intervalSecs)
+{
+    m_jsonPath = path;
+    auto *timer = new QTimer(this);
+    timer->setInterval(intervalSecs * 1000);
+    connect(timer, &QTimer::timeout, this, [this]() { writeJson(m_jsonPath); });
+    timer->start();
+}
+
+void Telemetry::writeJson(const QString &path)
+{
+    const QByteArray json = QJsonDocument(toJson()).toJson();
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size() || !file.commit())
+        qWarning() << "Could not write metrics to" << path << ":" << file.errorString();
+}
@@ -0,0 +1,104 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonObject>
+#include <QMap>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+class QTcpServer;
+
+struct TelemetryEvent {
+    enum Kind : quint8 {
+        PlaylistDownload, // value: ms until the whole body arrived
+        PlaylistParse,    // value: ms spent parsing
+        PlaylistError,    // value: QNetworkReply::NetworkError
+        FirstFrame,       // value: ms from the switch, detail: 1 if the player was warm
+        Stall,            // value: ms the active player was stalled
+        PlaybackError     // value: QMediaPlayer::Error
+    };
+
+    qint64 time;     // msecs since epoch
+    quint64 subject; // Telemetry::subject() of the playlist or channel URL
+    qint32 value;
+    qint32 detail;
+    Kind kind;
+};
+
+// What users experience, measured where it happens: record() pushes into a
+// fixed lock-free ring and costs a few atomics, from any thread. Once a
+// second the GUI thread drains the ring into per-URL totals, which are shown
+// by the overlay (Ctrl+I) and optionally exported:
+//
+// - IPTV_METRICS_PORT: Prometheus text at http://127.0.0.1:<port>/metrics
+// - IPTV_METRICS_FILE: the same totals as JSON, rewritten every 30 s
+//
+// Every series is labelled with the URL and its host (the provider), so
+// they can be summed per channel or per provider.
+class Telemetry : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(QString overlayText READ overlayText NOTIFY updated)
+
+public:
+    explicit Telemetry(QObject *parent = nullptr);
+    ~Telemetry() override;
+
+    // Lock-free, callable from any thread; events are dropped (and counted)
+    // if the ring is full
+    static void record(TelemetryEvent::Kind kind, quint64 subject, qint32 value, qint32 detail = 0);
+    // Key of a playlist or channel URL. Remembers the URL for the labels,
+    // which takes a short lock, so call it once per load or switch.
+    static quint64 subject(const QString &url);
+
+    bool listen(quint16 port);
+    void writeJsonPeriodically(const QString &path, int intervalSecs);
+
+    QString overlayText() const;
+    QByteArray prometheusText();
+    QJsonObject toJson();
+
+signals:
+    void updated();
+
+private:
+    struct Stat {
+        quint64 count = 0;
+        double sumMs = 0;
+        double maxMs = 0;
+        void add(double ms);
+    };
+
+    struct SubjectStats {
+        Stat download;
+        Stat parse;
+        Stat firstFrameWarm;
+        Stat firstFrameCold;
+        Stat stall;
+        QMap<qint32, quint64> playlistErrors; // by code
+        QMap<qint32, quint64> playbackErrors;
+    };
+
+    void drain();
+    void writeJson(const QString &path);
+    void serve();
+
+    QHash<quint64, SubjectStats> m_subjects;
+    QTimer *m_drainTimer;
+    QTcpServer *m_server = nullptr;
+    QString m_jsonPath;
+
+    // For the overlay
+    TelemetryEvent m_lastFirstFrame{};
+    TelemetryEvent m_lastDownload{};
+    TelemetryEvent m_lastParse{};
+    TelemetryEvent m_lastError{};
+    quint64 m_stalls = 0;
+    double m_stallMs = 0;
+};
+
+#endif // TELEMETRY_H
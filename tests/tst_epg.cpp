@@ -0,0 +1,193 @@
+// XmltvParser and EpgGuide against the fixtures in fixtures/: guide.xml and
+// the same document gzipped, the way EpgLoader reads .xml.gz feeds.
+#include <QDateTime>
+#include <QFile>
+#include <QTest>
+#include <QTimeZone>
+#include "epgguide.h"
+#include "gzipdecoder.h"
+#include "xmltvparser.h"
+
+namespace {
+
+// Small enough that elements and attributes straddle chunk boundaries
+constexpr qsizetype kChunkSize = 7;
+
+qint64 utc(int hour, int minute, int second = 0)
+{
+    return QDateTime(QDate(2024, 1, 31), QTime(hour, minute, second), QTimeZone::UTC).toSecsSinceEpoch();
+}
+
+} // namespace
+
+class TestEpg : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void parseTime_data();
+    void parseTime();
+    void fixture_data();
+    void fixture();
+    void nowNext_data();
+    void nowNext();
+    void truncated();
+
+private:
+    // Parses the fixture chunk by chunk, inflating it first if gzipped
+    bool parseFixture(const QString &name, EpgGuide *guide);
+};
+
+bool TestEpg::parseFixture(const QString &name, EpgGuide *guide)
+{
+    QFile file(QFINDTESTDATA("fixtures/" + name));
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "Missing fixture" << name;
+        return false;
+    }
+    const QByteArray content = file.readAll();
+
+    EpgGuide::Builder builder;
+    XmltvParser parser(&builder);
+    GzipDecoder decoder;
+    const bool gzipped = GzipDecoder::isGzip(content);
+    for (qsizetype pos = 0; pos < content.size(); pos += kChunkSize) {
+        const QByteArrayView chunk = QByteArrayView(content).sliced(pos, qMin(kChunkSize, content.size() - pos));
+        if (gzipped) {
+            QByteArray inflated;
+            if (!decoder.decode(chunk, inflated) || !parser.feed(inflated))
+                return false;
+        } else if (!parser.feed(chunk)) {
+            return false;
+        }
+    }
+    if (gzipped) {
+        QByteArray inflated;
+        if (!decoder.finish(inflated) || !parser.feed(inflated))
+            return false;
+    }
+    if (!parser.finish())
+        return false;
+    *guide = builder.build();
+    return true;
+}
+
+void TestEpg::parseTime_data()
+{
+    QTest::addColumn<QString>("text");
+    QTest::addColumn<qint64>("seconds");
+
+    QTest::newRow("positive offset") << "20240131203000 +0100" << utc(19, 30);
+    QTest::newRow("negative offset") << "20240131203000 -0230" << utc(23, 0);
+    QTest::newRow("half hour offset") << "20240131200000 +0530" << utc(14, 30);
+    QTest::newRow("offset without space") << "20240131203000+0100" << utc(19, 30);
+    QTest::newRow("explicit UTC") << "20240131203000 +0000" << utc(20, 30);
+    QTest::newRow("no offset is UTC") << "20240131203000" << utc(20, 30);
+    QTest::newRow("no seconds") << "202401312030 +0100" << utc(19, 30);
+    QTest::newRow("date only") << "20240131" << utc(0, 0);
+    QTest::newRow("offset across midnight") << "20240131010000 +0300" << utc(0, 0) - 2 * 3600;
+    QTest::newRow("unknown zone name") << "20240131203000 EST" << utc(20, 30);
+    QTest::newRow("too short") << "2024013" << qint64(-1);
+    QTest::newRow("bad month") << "20241331000000" << qint64(-1);
+    QTest::newRow("bad hour") << "20240131250000" << qint64(-1);
+    QTest::newRow("empty") << "" << qint64(-1);
+}
+
+void TestEpg::parseTime()
+{
+    QFETCH(QString, text);
+    QFETCH(qint64, seconds);
+    QCOMPARE(XmltvParser::parseTime(text), seconds);
+}
+
+void TestEpg::fixture_data()
+{
+    QTest::addColumn<QString>("name");
+    QTest::newRow("plain") << "guide.xml";
+    QTest::newRow("gzip") << "guide.xml.gz";
+}
+
+void TestEpg::fixture()
+{
+    QFETCH(QString, name);
+    if (name.endsWith(".gz") && !GzipDecoder::isAvailable())
+        QSKIP("Built without zlib");
+
+    EpgGuide guide;
+    QVERIFY(parseFixture(name, &guide));
+
+    // Seven programmes, one of them a repeat of another
+    QCOMPARE(guide.programmeCount(), qsizetype(6));
+
+    // By tvg-id first, then by any display name, folded
+    QCOMPARE(guide.findChannel("news.uz", QString()), 0);
+    QCOMPARE(guide.findChannel("sport.uz", QString()), 1);
+    QCOMPARE(guide.findChannel("kino.uz", QString()), 2);
+    QCOMPARE(guide.findChannel(QByteArrayView(), "News UZ"), 0);
+    QCOMPARE(guide.findChannel(QByteArrayView(), "SPORT"), 1);
+    QCOMPARE(guide.findChannel("unknown.uz", "Kino"), 2);
+    QCOMPARE(guide.findChannel("unknown.uz", "Unknown"), -1);
+
+    // The first title wins over its translations
+    QCOMPARE(guide.nowNext(0, utc(15, 30)).nowTitle, QString("Axborot"));
+}
+
+void TestEpg::nowNext_data()
+{
+    QTest::addColumn<int>("channel");
+    QTest::addColumn<qint64>("now");
+    QTest::addColumn<QString>("nowTitle");
+    QTest::addColumn<QString>("nextTitle");
+    QTest::addColumn<qreal>("progress");
+
+    // news.uz: Axborot 15:00-16:00, Ob-havo 16:00-16:30 (given as +0500)
+    QTest::newRow("before the first") << 0 << utc(14, 59, 59) << QString() << "Axborot" << qreal(-1);
+    QTest::newRow("at a start") << 0 << utc(15, 0) << "Axborot" << "Ob-havo" << qreal(0);
+    QTest::newRow("half way") << 0 << utc(15, 30) << "Axborot" << "Ob-havo" << qreal(0.5);
+    QTest::newRow("last second") << 0 << utc(15, 59, 24) << "Axborot" << "Ob-havo" << qreal(0.99);
+    QTest::newRow("at a stop that is a start") << 0 << utc(16, 0) << "Ob-havo" << QString() << qreal(0);
+    QTest::newRow("at the last stop") << 0 << utc(16, 30) << QString() << QString() << qreal(-1);
+    QTest::newRow("after the last") << 0 << utc(18, 0) << QString() << QString() << qreal(-1);
+
+    // sport.uz (-0330): Futbol from 15:00 without a stop, Tennis 16:30-17:30
+    QTest::newRow("missing stop runs to the next") << 1 << utc(16, 0) << "Futbol" << "Tennis" << qreal(2.0 / 3);
+    QTest::newRow("missing stop ends at the next") << 1 << utc(16, 30) << "Tennis" << QString() << qreal(0);
+
+    // kino.uz (UTC): Film 15:00-17:00, Tungi film from 17:00 with no stop
+    QTest::newRow("next without a stop") << 2 << utc(16, 0) << "Film" << "Tungi film" << qreal(0.5);
+    QTest::newRow("last without a stop") << 2 << utc(17, 0) << QString() << QString() << qreal(-1);
+
+    QTest::newRow("unknown channel") << 7 << utc(15, 30) << QString() << QString() << qreal(-1);
+}
+
+void TestEpg::nowNext()
+{
+    QFETCH(int, channel);
+    QFETCH(qint64, now);
+    QFETCH(QString, nowTitle);
+    QFETCH(QString, nextTitle);
+    QFETCH(qreal, progress);
+
+    EpgGuide guide;
+    QVERIFY(parseFixture("guide.xml", &guide));
+    const EpgGuide::NowNext result = guide.nowNext(quint32(channel), now);
+    QCOMPARE(result.nowTitle, nowTitle);
+    QCOMPARE(result.nextTitle, nextTitle);
+    QVERIFY2(qAbs(result.progress - progress) < 0.001,
+             qPrintable(QString("progress %1, expected %2").arg(result.progress).arg(progress)));
+}
+
+void TestEpg::truncated()
+{
+    EpgGuide::Builder builder;
+    XmltvParser parser(&builder);
+    QVERIFY(parser.feed("<tv><programme start=\"20240131150000\" channel=\"a\"><title>Cut"));
+    QVERIFY(!parser.finish());
+
+    XmltvParser broken(&builder);
+    QVERIFY(!broken.feed("<tv><programme></tv>"));
+    QVERIFY(!broken.errorString().isEmpty());
+}
+
+QTEST_APPLESS_MAIN(TestEpg)
+#include "tst_epg.moc"
@@ -0,0 +1,245 @@
+// PlaylistStreamWorker against a large generated playlist served slowly from
+// 127.0.0.1, plain and as a .m3u.gz file, the way PlaylistModel feeds it.
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <QTimer>
+#include "channelstore.h"
+#include "gzipdecoder.h"
+#include "playliststreamworker.h"
+
+#ifdef IPTV_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace {
+
+constexpr int kChannels = 300000;
+constexpr int kCategories = 100;
+// Every body goes out in this many slices, a few milliseconds apart, so a
+// download takes about a second whatever its size
+constexpr int kSlices = 200;
+constexpr int kSliceIntervalMs = 5;
+constexpr quint64 kGeneration = 1;
+
+QByteArray channelName(int channel)
+{
+    return "Channel " + QByteArray::number(channel);
+}
+
+QByteArray channelUrl(int channel)
+{
+    return "http://127.0.0.1/live/" + QByteArray::number(channel) + ".ts";
+}
+
+QByteArray categoryName(int channel)
+{
+    return "Group " + QByteArray::number(channel % kCategories);
+}
+
+QByteArray playlist()
+{
+    QByteArray text = "#EXTM3U url-tvg=\"http://127.0.0.1/guide.xml\"\n";
+    text.reserve(kChannels * 110);
+    for (int channel = 0; channel < kChannels; ++channel) {
+        text += "#EXTINF:-1 tvg-id=\"c" + QByteArray::number(channel) + "\" group-title=\"" + categoryName(channel)
+                + "\"," + channelName(channel) + '\n' + channelUrl(channel) + '\n';
+    }
+    return text;
+}
+
+QByteArray gzip(const QByteArray &data)
+{
+#ifdef IPTV_HAVE_ZLIB
+    // 16 + MAX_WBITS writes a gzip header and trailer instead of zlib's
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return {};
+    QByteArray compressed(qsizetype(deflateBound(&stream, uLong(data.size()))), Qt::Uninitialized);
+    stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+    stream.avail_in = uInt(data.size());
+    stream.next_out = reinterpret_cast<Bytef *>(compressed.data());
+    stream.avail_out = uInt(compressed.size());
+    const int ret = deflate(&stream, Z_FINISH);
+    compressed.resize(qsizetype(stream.total_out));
+    deflateEnd(&stream);
+    return ret == Z_STREAM_END ? compressed : QByteArray();
+#else
+    Q_UNUSED(data);
+    return {};
+#endif
+}
+
+// Serves fixed bodies by path, each in kSlices slices
+class PlaylistSource : public QObject
+{
+public:
+    PlaylistSource()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &PlaylistSource::serve);
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl url(const QString &path) const
+    {
+        return QUrl(QString("http://127.0.0.1:%1%2").arg(m_server.serverPort()).arg(path));
+    }
+
+    void setBody(const QByteArray &path, const QByteArray &body) { m_bodies.insert(path, body); }
+
+private:
+    void serve()
+    {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                if (!request.contains("\r\n\r\n")) {
+                    socket->setProperty("request", request);
+                    return;
+                }
+                const QByteArray path = request.left(request.indexOf("\r\n")).split(' ').value(1);
+                const auto it = m_bodies.constFind(path);
+                if (it == m_bodies.cend()) {
+                    socket->write("HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+                    socket->disconnectFromHost();
+                    return;
+                }
+                // No Content-Encoding: a .gz file is passed through as is
+                const QByteArray contentType = path.endsWith(".gz") ? "application/gzip" : "audio/x-mpegurl";
+                socket->write("HTTP/1.1 200 OK\r\n"
+                              "Content-Type: " + contentType + "\r\n"
+                              "Content-Length: " + QByteArray::number(it->size()) + "\r\n"
+                              "Connection: close\r\n\r\n");
+                sendSlices(socket, *it, 0);
+            });
+        }
+    }
+
+    void sendSlices(QTcpSocket *socket, const QByteArray &body, qsizetype offset)
+    {
+        const qsizetype sliceSize = body.size() / kSlices + 1;
+        socket->write(body.mid(offset, sliceSize));
+        offset += sliceSize;
+        if (offset >= body.size()) {
+            socket->disconnectFromHost();
+            return;
+        }
+        QTimer::singleShot(kSliceIntervalMs, socket, [this, socket, body, offset]() {
+            sendSlices(socket, body, offset);
+        });
+    }
+
+    QTcpServer m_server;
+    QHash<QByteArray, QByteArray> m_bodies;
+};
+
+} // namespace
+
+class TestPlaylistStreamWorker : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void download_data();
+    void download();
+
+private:
+    PlaylistSource m_source;
+};
+
+void TestPlaylistStreamWorker::initTestCase()
+{
+    const QByteArray plain = playlist();
+    m_source.setBody("/playlist.m3u", plain);
+    if (GzipDecoder::isAvailable()) {
+        const QByteArray compressed = gzip(plain);
+        QVERIFY(GzipDecoder::isGzip(compressed));
+        m_source.setBody("/playlist.m3u.gz", compressed);
+        // Cut off in the middle of a gzip member
+        m_source.setBody("/truncated.m3u.gz", compressed.left(compressed.size() / 2));
+    }
+}
+
+void TestPlaylistStreamWorker::download_data()
+{
+    QTest::addColumn<QString>("path");
+    QTest::addColumn<bool>("complete");
+
+    QTest::newRow("plain") << "/playlist.m3u" << true;
+    QTest::newRow("gzip") << "/playlist.m3u.gz" << true;
+    QTest::newRow("truncated gzip") << "/truncated.m3u.gz" << false;
+}
+
+void TestPlaylistStreamWorker::download()
+{
+    QFETCH(QString, path);
+    QFETCH(bool, complete);
+    if (path.endsWith(".gz") && !GzipDecoder::isAvailable())
+        QSKIP("Built without zlib");
+
+    PlaylistStreamWorker worker;
+    qsizetype received = 0;
+    qsizetype receivedBeforeEnd = -1;
+    // The first channel that did not match what was served, if any
+    qsizetype mismatch = -1;
+    bool finished = false;
+    bool failed = false;
+    QByteArray epgUrl;
+    bool indexed = false;
+
+    connect(&worker, &PlaylistStreamWorker::rowsReady, this,
+            [&](quint64 generation, const ChannelStore &rows) {
+                QCOMPARE(generation, kGeneration);
+                for (qsizetype i = 0; i < rows.size() && mismatch < 0; ++i) {
+                    const int channel = int(received + i);
+                    if (rows.field(quint32(i), ChannelStore::NameField) != channelName(channel)
+                        || rows.field(quint32(i), ChannelStore::UrlField) != channelUrl(channel)
+                        || rows.categoryName(rows.categoryId(quint32(i))) != QString::fromUtf8(categoryName(channel)))
+                        mismatch = channel;
+                }
+                received += rows.size();
+            });
+    connect(&worker, &PlaylistStreamWorker::finished, this,
+            [&](quint64, const QByteArray &url, qint64, std::shared_ptr<ChannelSearchIndex> searchIndex) {
+                finished = true;
+                epgUrl = url;
+                indexed = searchIndex && !searchIndex->isEmpty();
+            });
+    connect(&worker, &PlaylistStreamWorker::failed, this, [&]() { failed = true; });
+
+    QNetworkAccessManager network;
+    QNetworkReply *reply = network.get(QNetworkRequest(m_source.url(path)));
+    worker.start(kGeneration);
+    connect(reply, &QIODevice::readyRead, this, [&]() { worker.feed(kGeneration, reply->readAll()); });
+    connect(reply, &QNetworkReply::finished, this, [&]() {
+        worker.feed(kGeneration, reply->readAll());
+        receivedBeforeEnd = received;
+        if (reply->error() == QNetworkReply::NoError)
+            worker.finish(kGeneration);
+        else
+            failed = true;
+    });
+
+    QTRY_VERIFY_WITH_TIMEOUT(finished || failed, 60000);
+    reply->deleteLater();
+
+    QCOMPARE(mismatch, qsizetype(-1));
+    if (!complete) {
+        QVERIFY(failed);
+        QVERIFY(!finished);
+        return;
+    }
+    QVERIFY(!failed);
+    QCOMPARE(received, qsizetype(kChannels));
+    // Rows were handed over while the download was still going on
+    QVERIFY2(receivedBeforeEnd > 0, "no rows before the download ended");
+    QCOMPARE(epgUrl, QByteArray("http://127.0.0.1/guide.xml"));
+    QVERIFY(indexed);
+}
+
+QTEST_GUILESS_MAIN(TestPlaylistStreamWorker)
+#include "tst_playliststreamworker.moc"
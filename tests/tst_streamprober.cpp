@@ -0,0 +1,190 @@
+// StreamProber against a server on 127.0.0.1 that answers, refuses, stalls
+// or hands out HLS playlists, with a short timeout from the constructor.
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTest>
+#include <memory>
+#include "channelstore.h"
+#include "streamprober.h"
+
+namespace {
+
+constexpr int kTimeoutMs = 500;
+
+// One canned response per path; /stalled.ts is read but never answered
+class StreamSource : public QObject
+{
+public:
+    StreamSource()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &StreamSource::serve);
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QByteArray url(const QByteArray &path) const
+    {
+        return "http://127.0.0.1:" + QByteArray::number(m_server.serverPort()) + path;
+    }
+
+    // Paths requested so far, in order
+    QList<QByteArray> requested() const { return m_requested; }
+
+private:
+    void serve()
+    {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                if (!request.contains("\r\n\r\n")) {
+                    socket->setProperty("request", request);
+                    return;
+                }
+                socket->setProperty("request", QByteArray());
+                const QByteArray path = request.left(request.indexOf("\r\n")).split(' ').value(1);
+                m_requested.append(path);
+                respond(socket, path);
+            });
+        }
+    }
+
+    void respond(QTcpSocket *socket, const QByteArray &path)
+    {
+        if (path == "/stalled.ts")
+            return;
+        if (path == "/alive.ts")
+            send(socket, "206 Partial Content", "video/mp2t", QByteArray(1024, char(0x47)));
+        else if (path == "/live.ts") // a live stream that will not do ranges
+            send(socket, "416 Range Not Satisfiable", "text/plain", "Range not satisfiable");
+        else if (path == "/master.m3u8")
+            send(socket, "200 OK", "application/vnd.apple.mpegurl",
+                 "#EXTM3U\n#EXT-X-STREAM-INF:BANDWIDTH=800000\nmedia.m3u8\n");
+        else if (path == "/media.m3u8")
+            send(socket, "200 OK", "application/vnd.apple.mpegurl",
+                 "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXTINF:2.0,\nsegment0.ts\n");
+        else if (path == "/segment0.ts")
+            send(socket, "206 Partial Content", "video/mp2t", QByteArray(1024, char(0x47)));
+        else if (path == "/broken.m3u8")
+            send(socket, "200 OK", "application/vnd.apple.mpegurl",
+                 "#EXTM3U\n#EXT-X-TARGETDURATION:2\n#EXTINF:2.0,\ngone.ts\n");
+        else if (path == "/empty.m3u8")
+            send(socket, "200 OK", "application/vnd.apple.mpegurl", "#EXTM3U\n");
+        else
+            send(socket, "404 Not Found", "text/plain", "Not found");
+    }
+
+    static void send(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+                     const QByteArray &body)
+    {
+        socket->write("HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: " + contentType + "\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n"
+                      + body);
+        socket->disconnectFromHost();
+    }
+
+    QTcpServer m_server;
+    QList<QByteArray> m_requested;
+};
+
+} // namespace
+
+class TestStreamProber : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void health_data();
+    void health();
+    void timeout();
+
+private:
+    // Probes the paths and waits until every one has a result
+    bool probe(const QList<QByteArray> &paths);
+
+    StreamSource m_source;
+    std::unique_ptr<StreamProber> m_prober;
+};
+
+void TestStreamProber::initTestCase()
+{
+    // Keeps the results cache away from the real one
+    QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestStreamProber::init()
+{
+    m_prober = std::make_unique<StreamProber>(nullptr, kTimeoutMs);
+}
+
+void TestStreamProber::cleanup()
+{
+    m_prober.reset();
+}
+
+bool TestStreamProber::probe(const QList<QByteArray> &paths)
+{
+    ChannelStore store;
+    const quint32 category = store.addCategory("Test");
+    for (const QByteArray &path : paths)
+        store.add(path, m_source.url(path), {}, {}, category);
+
+    QSignalSpy finished(m_prober.get(), &StreamProber::finished);
+    // Forced, so results cached by an earlier run are not reused
+    m_prober->probe(store, true);
+    return !finished.isEmpty() || finished.wait(10 * kTimeoutMs);
+}
+
+void TestStreamProber::health_data()
+{
+    QTest::addColumn<QByteArray>("path");
+    QTest::addColumn<int>("state");
+
+    QTest::newRow("media bytes") << QByteArray("/alive.ts") << int(StreamHealth::Alive);
+    QTest::newRow("404") << QByteArray("/missing.ts") << int(StreamHealth::Dead);
+    QTest::newRow("416 with a body") << QByteArray("/live.ts") << int(StreamHealth::Alive);
+    QTest::newRow("master to media to segment") << QByteArray("/master.m3u8") << int(StreamHealth::Alive);
+    QTest::newRow("missing segment") << QByteArray("/broken.m3u8") << int(StreamHealth::Dead);
+    QTest::newRow("empty playlist") << QByteArray("/empty.m3u8") << int(StreamHealth::Dead);
+}
+
+void TestStreamProber::health()
+{
+    QFETCH(QByteArray, path);
+    QFETCH(int, state);
+
+    QVERIFY(probe({path}));
+    const StreamHealth result = m_prober->health(m_source.url(path));
+    QCOMPARE(int(result.state), state);
+    QVERIFY(result.latency >= 0);
+    QVERIFY(result.checked > 0);
+    QVERIFY(!m_prober->isProbing());
+}
+
+void TestStreamProber::timeout()
+{
+    // A stalled server is given up on after the timeout, and does not hold
+    // up the channels next to it
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(probe({"/stalled.ts", "/alive.ts", "/master.m3u8"}));
+    QVERIFY(timer.elapsed() >= kTimeoutMs);
+
+    QCOMPARE(int(m_prober->health(m_source.url("/stalled.ts")).state), int(StreamHealth::Dead));
+    QCOMPARE(int(m_prober->health(m_source.url("/alive.ts")).state), int(StreamHealth::Alive));
+    QCOMPARE(int(m_prober->health(m_source.url("/master.m3u8")).state), int(StreamHealth::Alive));
+    // The HLS hops were followed, one after the other
+    const QList<QByteArray> requested = m_source.requested();
+    QVERIFY(requested.indexOf("/master.m3u8") < requested.indexOf("/media.m3u8"));
+    QVERIFY(requested.indexOf("/media.m3u8") < requested.indexOf("/segment0.ts"));
+}
+
+QTEST_GUILESS_MAIN(TestStreamProber)
+#include "tst_streamprober.moc"
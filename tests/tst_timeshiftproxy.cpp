@@ -0,0 +1,309 @@
+// TimeshiftRecorder against a live HLS source served from 127.0.0.1: what it
+// records into the ring and serves back as live.m3u8?delay= and <n>.ts.
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QSet>
+#include <QSignalSpy>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTemporaryDir>
+#include <QTest>
+#include <memory>
+#include "timeshiftproxy.h"
+
+namespace {
+
+constexpr qsizetype kTsPacket = 188;
+constexpr int kPacketsPerSegment = 10;
+// Room for five segments and a bit, so the sixth wraps around
+constexpr qint64 kRingBytes = 5 * kPacketsPerSegment * kTsPacket + 1000;
+constexpr quint32 kSession = 1;
+
+// A live media playlist of one-second MPEG-TS segments. The window only
+// moves on when told to, so each poll of the recorder sees a known state.
+class HlsSource : public QObject
+{
+public:
+    static constexpr int Window = 6;
+
+    HlsSource()
+    {
+        connect(&m_server, &QTcpServer::newConnection, this, &HlsSource::serve);
+        m_server.listen(QHostAddress::LocalHost);
+    }
+
+    QUrl playlistUrl() const
+    {
+        return QUrl(QString("http://127.0.0.1:%1/live.m3u8").arg(m_server.serverPort()));
+    }
+
+    // Whole packets, each saying which segment it belongs to
+    static QByteArray segment(int sequence)
+    {
+        QByteArray data;
+        for (int i = 0; i < kPacketsPerSegment; ++i)
+            data += char(0x47) + QByteArray::number(sequence).leftJustified(kTsPacket - 1, ' ');
+        return data;
+    }
+
+    void advance(int segments) { m_liveEnd += segments; }
+    void setDiscontinuity(int sequence) { m_discontinuities.insert(sequence); }
+
+private:
+    QByteArray playlist() const
+    {
+        const int first = qMax(0, m_liveEnd - Window);
+        QByteArray text = "#EXTM3U\n#EXT-X-VERSION:3\n#EXT-X-TARGETDURATION:1\n";
+        text += "#EXT-X-MEDIA-SEQUENCE:" + QByteArray::number(first) + '\n';
+        for (int sequence = first; sequence < m_liveEnd; ++sequence) {
+            if (m_discontinuities.contains(sequence))
+                text += "#EXT-X-DISCONTINUITY\n";
+            text += "#EXTINF:1.000,\nsegment" + QByteArray::number(sequence) + ".ts\n";
+        }
+        return text;
+    }
+
+    void serve()
+    {
+        while (QTcpSocket *socket = m_server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+                const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+                if (!request.contains("\r\n\r\n")) {
+                    socket->setProperty("request", request);
+                    return;
+                }
+                const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+                const QByteArray path = requestLine.value(1);
+                if (path == "/live.m3u8") {
+                    respond(socket, "200 OK", "application/vnd.apple.mpegurl", playlist());
+                } else if (path.startsWith("/segment") && path.endsWith(".ts")) {
+                    respond(socket, "200 OK", "video/mp2t", segment(path.mid(8).chopped(3).toInt()));
+                } else {
+                    respond(socket, "404 Not Found", "text/plain", {});
+                }
+            });
+        }
+    }
+
+    static void respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+                        const QByteArray &body)
+    {
+        socket->write("HTTP/1.1 " + status + "\r\n"
+                      "Content-Type: " + contentType + "\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n"
+                      + body);
+        socket->disconnectFromHost();
+    }
+
+    QTcpServer m_server;
+    int m_liveEnd = Window;
+    QSet<int> m_discontinuities;
+};
+
+// Value of a #EXT-X-<name>: tag
+QByteArray tag(const QByteArray &playlist, const QByteArray &name)
+{
+    for (const QByteArray &line : playlist.split('\n')) {
+        if (line.startsWith("#EXT-X-" + name + ':'))
+            return line.mid(name.size() + 8);
+    }
+    return {};
+}
+
+QList<QByteArray> uris(const QByteArray &playlist)
+{
+    QList<QByteArray> result;
+    for (const QByteArray &line : playlist.split('\n')) {
+        if (!line.isEmpty() && !line.startsWith('#'))
+            result.append(line);
+    }
+    return result;
+}
+
+QList<QByteArray> segmentUris(int first, int last)
+{
+    QList<QByteArray> result;
+    for (int sequence = first; sequence <= last; ++sequence)
+        result.append(QByteArray::number(sequence) + ".ts");
+    return result;
+}
+
+} // namespace
+
+class TestTimeshiftProxy : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void init();
+    void cleanup();
+    void playlist();
+    void ringWrap();
+    void discontinuity();
+    void delayedWindow();
+
+private:
+    struct Reply {
+        int status = 0;
+        QByteArray body;
+    };
+
+    void record();
+    // GET from the recorder, path starting with /<session>/
+    Reply get(const QString &path);
+
+    QTemporaryDir m_dir;
+    QNetworkAccessManager m_network;
+    std::unique_ptr<HlsSource> m_source;
+    std::unique_ptr<TimeshiftRecorder> m_recorder;
+    // One emission per committed segment
+    std::unique_ptr<QSignalSpy> m_committed;
+    quint16 m_port = 0;
+};
+
+void TestTimeshiftProxy::init()
+{
+    QVERIFY(m_dir.isValid());
+    m_source = std::make_unique<HlsSource>();
+    m_recorder = std::make_unique<TimeshiftRecorder>(m_dir.filePath("ring.ts"), kRingBytes);
+    m_committed = std::make_unique<QSignalSpy>(m_recorder.get(), &TimeshiftRecorder::bufferedChanged);
+    m_port = m_recorder->listen();
+    QVERIFY(m_port != 0);
+}
+
+void TestTimeshiftProxy::cleanup()
+{
+    m_committed.reset();
+    m_recorder.reset();
+    m_source.reset();
+}
+
+void TestTimeshiftProxy::record()
+{
+    m_recorder->start(kSession, m_source->playlistUrl());
+}
+
+TestTimeshiftProxy::Reply TestTimeshiftProxy::get(const QString &path)
+{
+    QNetworkReply *reply = m_network.get(QNetworkRequest(QUrl(QString("http://127.0.0.1:%1%2").arg(m_port).arg(path))));
+    QSignalSpy finished(reply, &QNetworkReply::finished);
+    Reply result;
+    if (reply->isFinished() || finished.wait(10000)) {
+        result.status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        result.body = reply->readAll();
+    }
+    reply->deleteLater();
+    return result;
+}
+
+void TestTimeshiftProxy::playlist()
+{
+    record();
+
+    // Asked for before anything is recorded: answered once three segments
+    // are, the last three of the first source playlist
+    const Reply live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(live.status, 200);
+    QCOMPARE(m_committed->count(), 3);
+    QVERIFY(live.body.startsWith("#EXTM3U\n"));
+    QCOMPARE(tag(live.body, "TARGETDURATION"), QByteArray("1"));
+    QCOMPARE(tag(live.body, "MEDIA-SEQUENCE"), QByteArray("0"));
+    QCOMPARE(tag(live.body, "DISCONTINUITY-SEQUENCE"), QByteArray("0"));
+    QVERIFY(live.body.contains("#EXTINF:1.000,\n0.ts\n"));
+    QVERIFY(!live.body.contains("#EXT-X-DISCONTINUITY\n"));
+    QVERIFY(!live.body.contains("#EXT-X-ENDLIST"));
+    QCOMPARE(uris(live.body), segmentUris(0, 2));
+
+    for (int i = 0; i < 3; ++i) {
+        const Reply segment = get(QString("/1/%1.ts").arg(i));
+        QCOMPARE(segment.status, 200);
+        QCOMPARE(segment.body, HlsSource::segment(HlsSource::Window - 3 + i));
+    }
+
+    QCOMPARE(get("/1/3.ts").status, 404); // not recorded yet
+    QCOMPARE(get("/1/live.ts").status, 404);
+    QCOMPARE(get("/2/live.m3u8?delay=0").status, 404); // another session
+}
+
+void TestTimeshiftProxy::ringWrap()
+{
+    record();
+    QTRY_COMPARE(m_committed->count(), 3);
+
+    // Four more: the sixth segment wraps to the start of the ring and
+    // overwrites the first, the seventh the second
+    m_source->advance(4);
+    QTRY_COMPARE(m_committed->count(), 7);
+    QCOMPARE(m_committed->last().at(1).toLongLong(), 5000);
+
+    const Reply live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(live.status, 200);
+    QCOMPARE(tag(live.body, "MEDIA-SEQUENCE"), QByteArray("2"));
+    QCOMPARE(uris(live.body), segmentUris(2, 6));
+
+    QCOMPARE(get("/1/0.ts").status, 404);
+    QCOMPARE(get("/1/1.ts").status, 404);
+    for (int i = 2; i <= 6; ++i) {
+        const Reply segment = get(QString("/1/%1.ts").arg(i));
+        QCOMPARE(segment.status, 200);
+        QCOMPARE(segment.body, HlsSource::segment(HlsSource::Window - 3 + i));
+    }
+}
+
+void TestTimeshiftProxy::discontinuity()
+{
+    // Source segment 4 is the second one recorded
+    m_source->setDiscontinuity(HlsSource::Window - 2);
+    record();
+    QTRY_COMPARE(m_committed->count(), 3);
+
+    Reply live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(live.status, 200);
+    QCOMPARE(tag(live.body, "DISCONTINUITY-SEQUENCE"), QByteArray("0"));
+    QVERIFY(live.body.contains("0.ts\n#EXT-X-DISCONTINUITY\n#EXTINF:1.000,\n1.ts\n"));
+
+    // The tagged segment becomes the first: the tag goes, the count stays
+    m_source->advance(3);
+    QTRY_COMPARE(m_committed->count(), 6);
+    live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(tag(live.body, "MEDIA-SEQUENCE"), QByteArray("1"));
+    QCOMPARE(tag(live.body, "DISCONTINUITY-SEQUENCE"), QByteArray("1"));
+    QVERIFY(!live.body.contains("#EXT-X-DISCONTINUITY\n"));
+
+    // And once it is overwritten as well
+    m_source->advance(1);
+    QTRY_COMPARE(m_committed->count(), 7);
+    live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(tag(live.body, "MEDIA-SEQUENCE"), QByteArray("2"));
+    QCOMPARE(tag(live.body, "DISCONTINUITY-SEQUENCE"), QByteArray("1"));
+    QVERIFY(!live.body.contains("#EXT-X-DISCONTINUITY\n"));
+}
+
+void TestTimeshiftProxy::delayedWindow()
+{
+    record();
+    QTRY_COMPARE(m_committed->count(), 3);
+
+    // Picked up by the next poll, a second after the first three
+    m_source->advance(2);
+    QTRY_COMPARE(m_committed->count(), 5);
+
+    const Reply delayed = get("/1/live.m3u8?delay=500");
+    QCOMPARE(delayed.status, 200);
+    QCOMPARE(tag(delayed.body, "MEDIA-SEQUENCE"), QByteArray("0"));
+    QCOMPARE(uris(delayed.body), segmentUris(0, 2));
+
+    const Reply live = get("/1/live.m3u8?delay=0");
+    QCOMPARE(live.status, 200);
+    QCOMPARE(uris(live.body), segmentUris(0, 4));
+
+    // Segments past the delayed edge are still served to whoever asks
+    const Reply segment = get("/1/4.ts");
+    QCOMPARE(segment.status, 200);
+    QCOMPARE(segment.body, HlsSource::segment(HlsSource::Window + 1));
+}
+
+QTEST_GUILESS_MAIN(TestTimeshiftProxy)
+#include "tst_timeshiftproxy.moc"
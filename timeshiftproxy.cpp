@@ -0,0 +1,623 @@
+#include "timeshiftproxy.h"
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QStandardPaths>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUrlQuery>
+#include <cmath>
+
+#ifdef Q_OS_LINUX
+#include <cerrno>
+#include <fcntl.h>
+#endif
+
+namespace {
+
+constexpr qsizetype kMaxSegments = 4096;
+constexpr qint64 kChunkMs = 2000;        // continuous TS is cut this often
+constexpr qsizetype kTsPacket = 188;
+constexpr int kMinPlaylistSegments = 3;   // players start this far from the edge
+constexpr qint64 kPlaylistWaitMs = 15000; // before answering 503
+constexpr int kLiveStartSegments = 3;     // taken from the first source playlist
+
+bool isTsSync(const QByteArray &data)
+{
+    return !data.isEmpty() && quint8(data[0]) == 0x47;
+}
+
+// Gives the file its blocks on disk, not just a size, so a full disk is
+// found before recording starts. Empty on success, the reason otherwise.
+QString preallocate(QFile &file, qint64 bytes)
+{
+    if (!file.resize(bytes))
+        return file.errorString();
+#ifdef Q_OS_LINUX
+    const int error = posix_fallocate(file.handle(), 0, bytes);
+    if (error == 0)
+        return {};
+    if (error != EOPNOTSUPP && error != EINVAL)
+        return qt_error_string(error);
+#endif
+    // Written out in chunks where the file system cannot reserve space
+    const QByteArray zeros(1 << 20, '\0');
+    if (!file.seek(0))
+        return file.errorString();
+    for (qint64 pos = 0; pos < bytes; pos += zeros.size()) {
+        const qint64 size = qMin(qint64(zeros.size()), bytes - pos);
+        if (file.write(zeros.constData(), size) != size)
+            return file.errorString();
+    }
+    return {};
+}
+
+} // namespace
+
+TimeshiftRecorder::TimeshiftRecorder(const QString &ringPath, qint64 ringBytes)
+    : m_ringPath(ringPath)
+    , m_ringBytes(ringBytes)
+{
+}
+
+TimeshiftRecorder::~TimeshiftRecorder()
+{
+    m_mode = Mode::Idle; // so the aborted replies do not reconnect
+    if (m_sourceReply)
+        m_sourceReply->abort();
+    if (m_segmentReply)
+        m_segmentReply->abort();
+}
+
+quint16 TimeshiftRecorder::listen()
+{
+    // Everything below lives on the recorder thread
+    m_network = new QNetworkAccessManager(this);
+    m_pollTimer = new QTimer(this);
+    m_pollTimer->setSingleShot(true);
+    connect(m_pollTimer, &QTimer::timeout, this, &TimeshiftRecorder::pollPlaylist);
+    m_housekeepingTimer = new QTimer(this);
+    m_housekeepingTimer->setInterval(500);
+    connect(m_housekeepingTimer, &QTimer::timeout, this, &TimeshiftRecorder::housekeeping);
+
+    m_server = new QTcpServer(this);
+    connect(m_server, &QTcpServer::newConnection, this, &TimeshiftRecorder::serve);
+    if (!m_server->listen(QHostAddress::LocalHost)) {
+        qWarning() << "Timeshift: could not listen:" << m_server->errorString();
+        return 0;
+    }
+    return m_server->serverPort();
+}
+
+void TimeshiftRecorder::start(quint32 session, const QUrl &source)
+{
+    stop();
+    m_session = session;
+    m_source = source;
+
+    // Allocated once, up front, so the disk cannot run out mid-recording.
+    // Zero-filling a large ring takes a moment, but this is not the GUI thread.
+    if (!m_ring.isOpen()) {
+        QDir().mkpath(QFileInfo(m_ringPath).absolutePath());
+        m_ring.setFileName(m_ringPath);
+        if (!m_ring.open(QIODevice::ReadWrite | QIODevice::Unbuffered)) {
+            fail(QString("ring file: %1").arg(m_ring.errorString()));
+            return;
+        }
+        const QString error = preallocate(m_ring, m_ringBytes);
+        if (!error.isEmpty()) {
+            fail(QString("ring file: %1").arg(error));
+            m_ring.remove(); // do not leave a half-allocated file behind
+            return;
+        }
+    }
+
+    m_mode = Mode::Probing;
+    m_housekeepingTimer->start();
+    openSource();
+}
+
+void TimeshiftRecorder::stop()
+{
+    m_mode = Mode::Idle;
+    if (m_sourceReply)
+        m_sourceReply->abort();
+    if (m_segmentReply)
+        m_segmentReply->abort();
+    m_pollTimer->stop();
+    m_housekeepingTimer->stop();
+    for (const PendingPlaylist &pending : std::as_const(m_pendingPlaylists)) {
+        if (pending.socket)
+            respond(pending.socket, "404 Not Found", "text/plain", {});
+    }
+    m_pendingPlaylists.clear();
+    reset();
+}
+
+void TimeshiftRecorder::reset()
+{
+    m_segments.clear();
+    m_writePos = 0;
+    m_discontinuitySequence = 0;
+    m_bufferedMs = 0;
+    m_discontinuity = false;
+    m_chunk.clear();
+    m_chunkTimer.invalidate();
+    m_mediaPlaylist.clear();
+    m_lastSourceSequence = -1;
+    m_sourceQueue.clear();
+}
+
+void TimeshiftRecorder::fail(const QString &reason)
+{
+    qWarning().noquote() << "Timeshift: not recording" << m_source.toString() << "-" << reason;
+    const quint32 session = m_session;
+    stop();
+    emit unsupported(session, reason);
+}
+
+void TimeshiftRecorder::openSource()
+{
+    QNetworkRequest request(m_mode == Mode::Hls ? m_mediaPlaylist : m_source);
+    request.setRawHeader("User-Agent", "IPTV Player");
+    request.setTransferTimeout(m_mode == Mode::Stream ? 0 : 10000);
+    QNetworkReply *reply = m_network->get(request);
+    m_sourceReply = reply;
+    connect(reply, &QIODevice::readyRead, this, [this, reply]() {
+        if (reply == m_sourceReply)
+            onSourceData();
+    });
+    connect(reply, &QNetworkReply::finished, this, [this, reply]() {
+        reply->deleteLater();
+        if (reply == m_sourceReply)
+            onSourceFinished();
+    });
+}
+
+void TimeshiftRecorder::onSourceData()
+{
+    QNetworkReply *reply = m_sourceReply;
+    if (m_mode == Mode::Probing) {
+        // Decide from the first bytes whether this is a playlist or a stream
+        const QByteArray head = reply->peek(7);
+        const bool playlist = head.startsWith("#EXTM3U")
+                              || reply->header(QNetworkRequest::ContentTypeHeader)
+                                     .toString()
+                                     .contains("mpegurl", Qt::CaseInsensitive);
+        if (playlist) {
+            m_mode = Mode::Hls;
+            m_mediaPlaylist = reply->url();
+            return; // read whole in onSourceFinished()
+        }
+        if (!isTsSync(head)) {
+            if (head.size() >= 7)
+                fail("not an MPEG-TS stream");
+            return;
+        }
+        m_mode = Mode::Stream;
+        m_chunkTimer.start();
+    }
+
+    if (m_mode != Mode::Stream)
+        return;
+    m_chunk.append(reply->readAll());
+    if (m_chunkTimer.elapsed() >= kChunkMs || m_chunk.size() > m_ringBytes / 16)
+        cutChunk();
+}
+
+void TimeshiftRecorder::cutChunk()
+{
+    // Whole packets only; the rest starts the next segment
+    const qsizetype usable = m_chunk.size() / kTsPacket * kTsPacket;
+    if (usable == 0)
+        return;
+    commit(m_chunk.left(usable), qint32(m_chunkTimer.restart()), m_discontinuity);
+    m_chunk.remove(0, usable);
+}
+
+void TimeshiftRecorder::onSourceFinished()
+{
+    QNetworkReply *reply = m_sourceReply;
+    m_sourceReply = nullptr;
+    if (m_mode == Mode::Idle || reply->error() == QNetworkReply::OperationCanceledError)
+        return;
+
+    if (m_mode == Mode::Hls) {
+        if (reply->error() != QNetworkReply::NoError) {
+            // Keep polling; live playlists do fail now and then
+            qWarning() << "Timeshift: playlist error:" << reply->errorString();
+            m_pollTimer->start(2000);
+            return;
+        }
+        parsePlaylist(reply->readAll(), reply->url());
+        return;
+    }
+
+    if (m_mode == Mode::Probing) {
+        fail(reply->errorString().isEmpty() ? QString("no data") : reply->errorString());
+        return;
+    }
+
+    // A continuous stream ended or dropped: reconnect and mark the gap
+    cutChunk();
+    m_chunk.clear();
+    m_discontinuity = true;
+    QTimer::singleShot(1000, this, [this, session = m_session]() {
+        if (session == m_session && m_mode == Mode::Stream) {
+            m_chunkTimer.start();
+            openSource();
+        }
+    });
+}
+
+void TimeshiftRecorder::pollPlaylist()
+{
+    if (m_mode == Mode::Hls && !m_sourceReply)
+        openSource();
+}
+
+void TimeshiftRecorder::parsePlaylist(const QByteArray &text, const QUrl &base)
+{
+    qint64 targetDuration = 6;
+    qint64 mediaSequence = 0;
+    qint32 durationMs = 0;
+    bool discontinuity = false;
+    bool variant = false;
+    QList<SourceSegment> entries;
+
+    for (QByteArray line : text.split('\n')) {
+        line = line.trimmed();
+        if (line.isEmpty())
+            continue;
+        if (line.startsWith("#EXT-X-STREAM-INF")) {
+            variant = true;
+        } else if (line.startsWith("#EXT-X-TARGETDURATION:")) {
+            targetDuration = qMax<qint64>(1, line.mid(22).toLongLong());
+        } else if (line.startsWith("#EXT-X-MEDIA-SEQUENCE:")) {
+            mediaSequence = line.mid(22).toLongLong();
+        } else if (line.startsWith("#EXTINF:")) {
+            const qsizetype comma = line.indexOf(',');
+            durationMs = qint32(std::lround(line.mid(8, comma < 0 ? -1 : comma - 8).toDouble() * 1000));
+        } else if (line.startsWith("#EXT-X-DISCONTINUITY")) {
+            discontinuity = true;
+        } else if (line.startsWith("#EXT-X-KEY") && !line.contains("METHOD=NONE")) {
+            fail("encrypted segments");
+            return;
+        } else if (line.startsWith("#EXT-X-MAP")) {
+            fail("fragmented MP4 segments");
+            return;
+        } else if (line.startsWith("#EXT-X-ENDLIST")) {
+            fail("not a live playlist");
+            return;
+        } else if (!line.startsWith('#')) {
+            const QUrl url = base.resolved(QUrl(QString::fromUtf8(line)));
+            if (variant) {
+                // A master playlist: record its first variant
+                m_mediaPlaylist = url;
+                pollPlaylist();
+                return;
+            }
+            entries.append({mediaSequence + entries.size(), durationMs, url, discontinuity});
+            durationMs = 0;
+            discontinuity = false;
+        }
+    }
+
+    // The first time, start near the live edge like a player would
+    qsizetype from = 0;
+    if (m_lastSourceSequence < 0)
+        from = qMax<qsizetype>(0, entries.size() - kLiveStartSegments);
+    for (qsizetype i = from; i < entries.size(); ++i) {
+        SourceSegment entry = entries[i];
+        if (entry.sequence <= m_lastSourceSequence)
+            continue;
+        if (m_lastSourceSequence >= 0 && entry.sequence != m_lastSourceSequence + 1)
+            entry.discontinuity = true; // fell behind, segments were missed
+        m_lastSourceSequence = entry.sequence;
+        m_sourceQueue.append(entry);
+    }
+    downloadNextSegment();
+    m_pollTimer->start(int(qMax<qint64>(1000, targetDuration * 1000 / 2)));
+}
+
+void TimeshiftRecorder::downloadNextSegment()
+{
+    if (m_segmentReply || m_sourceQueue.isEmpty() || m_mode != Mode::Hls)
+        return;
+
+    const SourceSegment entry = m_sourceQueue.takeFirst();
+    QNetworkRequest request(entry.url);
+    request.setRawHeader("User-Agent", "IPTV Player");
+    request.setTransferTimeout(20000);
+    QNetworkReply *reply = m_network->get(request);
+    m_segmentReply = reply;
+    connect(reply, &QNetworkReply::finished, this, [this, reply, entry]() {
+        reply->deleteLater();
+        if (reply != m_segmentReply)
+            return;
+        m_segmentReply = nullptr;
+        if (reply->error() == QNetworkReply::NoError) {
+            const QByteArray data = reply->readAll();
+            if (m_segments.isEmpty() && !isTsSync(data)) {
+                fail("segments are not MPEG-TS");
+                return;
+            }
+            commit(data, entry.durationMs, entry.discontinuity || m_discontinuity);
+        } else if (reply->error() != QNetworkReply::OperationCanceledError) {
+            qWarning() << "Timeshift: segment error:" << reply->errorString();
+            m_discontinuity = true;
+        }
+        downloadNextSegment();
+    });
+}
+
+bool TimeshiftRecorder::commit(const QByteArray &data, qint32 durationMs, bool discontinuity)
+{
+    const qint64 size = data.size();
+    if (size == 0 || size > m_ringBytes / 4) {
+        qWarning() << "Timeshift: skipping a segment of" << size << "bytes";
+        m_discontinuity = true;
+        return false;
+    }
+
+    // Segments are laid out in age order around the ring, so whatever the
+    // new one overwrites is always at the front of the index
+    if (m_writePos + size > m_ringBytes) {
+        while (!m_segments.isEmpty() && m_segments.first().offset >= m_writePos)
+            dropOldest();
+        m_writePos = 0;
+    }
+    while (!m_segments.isEmpty()
+           && (m_segments.size() >= kMaxSegments
+               || (m_segments.first().offset < m_writePos + size
+                   && m_segments.first().offset + m_segments.first().size > m_writePos)))
+        dropOldest();
+
+    if (!m_ring.seek(m_writePos) || m_ring.write(data) != size) {
+        qWarning() << "Timeshift: could not write the ring file:" << m_ring.errorString();
+        m_discontinuity = true;
+        return false;
+    }
+
+    Segment segment;
+    segment.sequence = m_nextSequence++;
+    segment.offset = m_writePos;
+    segment.size = qint32(size);
+    segment.durationMs = qMax(1, durationMs);
+    segment.receivedAt = QDateTime::currentMSecsSinceEpoch();
+    segment.discontinuity = discontinuity && !m_segments.isEmpty();
+    m_segments.append(segment);
+    m_writePos += size;
+    m_bufferedMs += segment.durationMs;
+    m_discontinuity = false;
+
+    emit bufferedChanged(m_session, m_bufferedMs);
+    housekeeping(); // answers playlists that were waiting for data
+    return true;
+}
+
+void TimeshiftRecorder::dropOldest()
+{
+    m_bufferedMs -= m_segments.first().durationMs;
+    m_segments.removeFirst();
+    // The first segment carries no tag; players learn of its discontinuity
+    // from EXT-X-DISCONTINUITY-SEQUENCE instead
+    if (!m_segments.isEmpty() && m_segments.first().discontinuity) {
+        m_segments.first().discontinuity = false;
+        ++m_discontinuitySequence;
+    }
+}
+
+QByteArray TimeshiftRecorder::playlist(qint64 delayMs) const
+{
+    // Everything recorded at least delayMs ago; the player starts a few
+    // segments before the end, so it plays that far behind live
+    const qint64 edge = QDateTime::currentMSecsSinceEpoch() - delayMs;
+    qsizetype end = m_segments.size();
+    while (end > 0 && m_segments[end - 1].receivedAt > edge)
+        --end;
+    if (end < kMinPlaylistSegments)
+        return {};
+
+    qint32 target = 1;
+    for (qsizetype i = 0; i < end; ++i)
+        target = qMax(target, (m_segments[i].durationMs + 999) / 1000);
+
+    QByteArray text = "#EXTM3U\n#EXT-X-VERSION:3\n";
+    text += "#EXT-X-TARGETDURATION:" + QByteArray::number(target) + '\n';
+    text += "#EXT-X-MEDIA-SEQUENCE:" + QByteArray::number(m_segments.first().sequence) + '\n';
+    text += "#EXT-X-DISCONTINUITY-SEQUENCE:" + QByteArray::number(m_discontinuitySequence) + '\n';
+    for (qsizetype i = 0; i < end; ++i) {
+        const Segment &segment = m_segments[i];
+        if (segment.discontinuity)
+            text += "#EXT-X-DISCONTINUITY\n";
+        text += "#EXTINF:" + QByteArray::number(segment.durationMs / 1000.0, 'f', 3) + ",\n";
+        text += QByteArray::number(segment.sequence) + ".ts\n";
+    }
+    return text;
+}
+
+void TimeshiftRecorder::housekeeping()
+{
+    for (qsizetype i = m_pendingPlaylists.size() - 1; i >= 0; --i) {
+        const PendingPlaylist &pending = m_pendingPlaylists[i];
+        if (!pending.socket) {
+            m_pendingPlaylists.removeAt(i);
+            continue;
+        }
+        const QByteArray text = playlist(pending.delayMs);
+        if (!text.isEmpty()) {
+            respond(pending.socket, "200 OK", "application/vnd.apple.mpegurl", text);
+            m_pendingPlaylists.removeAt(i);
+        } else if (pending.waiting.hasExpired(kPlaylistWaitMs)) {
+            respond(pending.socket, "503 Service Unavailable", "text/plain", {});
+            m_pendingPlaylists.removeAt(i);
+        }
+    }
+}
+
+void TimeshiftRecorder::serve()
+{
+    while (QTcpSocket *socket = m_server->nextPendingConnection()) {
+        connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+        connect(socket, &QTcpSocket::readyRead, this, [this, socket]() {
+            const QByteArray request = socket->property("request").toByteArray() + socket->readAll();
+            if (!request.contains("\r\n\r\n")) {
+                if (request.size() > 8192)
+                    socket->abort();
+                else
+                    socket->setProperty("request", request);
+                return;
+            }
+            const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+            if (requestLine.size() < 2 || requestLine[0] != "GET") {
+                respond(socket, "405 Method Not Allowed", "text/plain", {});
+                return;
+            }
+            handleRequest(socket, requestLine[1]);
+        });
+    }
+}
+
+void TimeshiftRecorder::handleRequest(QTcpSocket *socket, const QByteArray &target)
+{
+    // /<session>/live.m3u8?delay=<ms> and /<session>/<sequence>.ts
+    const QUrl url(QString::fromLatin1(target));
+    const QStringList parts = url.path().split('/', Qt::SkipEmptyParts);
+    if (parts.size() != 2 || parts[0].toUInt() != m_session || m_mode == Mode::Idle) {
+        respond(socket, "404 Not Found", "text/plain", {});
+        return;
+    }
+
+    if (parts[1] == "live.m3u8") {
+        const qint64 delayMs = qMax<qint64>(0, QUrlQuery(url).queryItemValue("delay").toLongLong());
+        const QByteArray text = playlist(delayMs);
+        if (!text.isEmpty()) {
+            respond(socket, "200 OK", "application/vnd.apple.mpegurl", text);
+            return;
+        }
+        // Nothing recorded that far back yet; answer once there is
+        PendingPlaylist pending;
+        pending.socket = socket;
+        pending.delayMs = delayMs;
+        pending.waiting.start();
+        m_pendingPlaylists.append(pending);
+        return;
+    }
+
+    bool ok = false;
+    const qint64 sequence = parts[1].chopped(parts[1].endsWith(".ts") ? 3 : 0).toLongLong(&ok);
+    const qint64 first = m_segments.isEmpty() ? 0 : m_segments.first().sequence;
+    if (!ok || m_segments.isEmpty() || sequence < first || sequence - first >= m_segments.size()) {
+        respond(socket, "404 Not Found", "text/plain", {}); // overwritten already
+        return;
+    }
+    const Segment &segment = m_segments[sequence - first];
+    QByteArray data(segment.size, Qt::Uninitialized);
+    if (!m_ring.seek(segment.offset) || m_ring.read(data.data(), segment.size) != segment.size) {
+        respond(socket, "500 Internal Server Error", "text/plain", {});
+        return;
+    }
+    respond(socket, "200 OK", "video/mp2t", data);
+}
+
+void TimeshiftRecorder::respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+                                const QByteArray &body)
+{
+    socket->write("HTTP/1.1 " + status + "\r\n"
+                  "Content-Type: " + contentType + "\r\n"
+                  "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                  "Cache-Control: no-cache\r\n"
+                  "Connection: close\r\n\r\n"
+                  + body);
+    socket->disconnectFromHost();
+}
+
+TimeshiftProxy::TimeshiftProxy(QObject *parent, qint64 ringBytes)
+    : QObject(parent)
+    , m_recorder(new TimeshiftRecorder(
+          QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/timeshift/ring.ts", ringBytes))
+{
+    m_recorder->moveToThread(&m_thread);
+    connect(&m_thread, &QThread::finished, m_recorder, &QObject::deleteLater);
+    connect(m_recorder, &TimeshiftRecorder::bufferedChanged, this, [this](quint32 session, qint64 msecs) {
+        if (session != m_session)
+            return;
+        m_bufferedMs = msecs;
+        emit bufferedChanged();
+    });
+    connect(m_recorder, &TimeshiftRecorder::unsupported, this, [this](quint32 session) {
+        if (session != m_session)
+            return;
+        m_supported = false;
+        m_bufferedMs = 0;
+        emit bufferedChanged();
+        emit unsupported(m_source);
+    });
+    m_thread.setObjectName("Timeshift");
+    m_thread.start();
+
+    // The port is needed for every URL handed out, so wait for it once
+    QMetaObject::invokeMethod(
+        m_recorder, [this]() { m_port = m_recorder->listen(); }, Qt::BlockingQueuedConnection);
+}
+
+TimeshiftProxy::~TimeshiftProxy()
+{
+    m_thread.quit();
+    m_thread.wait();
+}
+
+bool TimeshiftProxy::isListening() const
+{
+    return m_port != 0;
+}
+
+void TimeshiftProxy::start(const QUrl &source)
+{
+    ++m_session;
+    m_source = source;
+    m_supported = isListening();
+    m_bufferedMs = 0;
+    emit bufferedChanged();
+    if (!m_supported)
+        return;
+    QMetaObject::invokeMethod(m_recorder, [recorder = m_recorder, session = m_session, source]() {
+        recorder->start(session, source);
+    });
+}
+
+void TimeshiftProxy::stop()
+{
+    ++m_session;
+    m_source.clear();
+    m_supported = false;
+    m_bufferedMs = 0;
+    emit bufferedChanged();
+    QMetaObject::invokeMethod(m_recorder, [recorder = m_recorder]() { recorder->stop(); });
+}
+
+QUrl TimeshiftProxy::source() const
+{
+    return m_source;
+}
+
+bool TimeshiftProxy::isSupported() const
+{
+    return m_supported;
+}
+
+QUrl TimeshiftProxy::playbackUrl(qint64 delayMs) const
+{
+    return QUrl(QString("http://127.0.0.1:%1/%2/live.m3u8?delay=%3").arg(m_port).arg(m_session).arg(delayMs));
+}
+
+qint64 TimeshiftProxy::bufferedMsecs() const
+{
+    return m_bufferedMs;
+}
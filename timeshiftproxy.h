@@ -0,0 +1,168 @@
+#ifndef TIMESHIFTPROXY_H
+#define TIMESHIFTPROXY_H
+
+#include <QElapsedTimer>
+#include <QFile>
+#include <QList>
+#include <QObject>
+#include <QPointer>
+#include <QThread>
+#include <QUrl>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+class QTcpServer;
+class QTcpSocket;
+class QTimer;
+
+// Records one live channel into a fixed-size ring file and serves it back
+// as a live HLS playlist on 127.0.0.1. Runs on TimeshiftProxy's thread.
+//
+// - HLS sources: the media playlist is polled and new segments are copied
+//   into the ring as they appear (plain MPEG-TS segments only)
+// - Continuous MPEG-TS over HTTP: cut into ~2 s segments at packet
+//   boundaries
+//
+// The ring is one file sized up front; segments are written one after the
+// other and wrap around, overwriting the oldest. The index holds at most
+// kMaxSegments entries, so memory stays constant however long it records.
+class TimeshiftRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    TimeshiftRecorder(const QString &ringPath, qint64 ringBytes);
+    ~TimeshiftRecorder() override;
+
+    // Returns the port, 0 on failure
+    quint16 listen();
+    void start(quint32 session, const QUrl &source);
+    void stop();
+
+signals:
+    void bufferedChanged(quint32 session, qint64 msecs);
+    // The source is not something this can record; play it directly
+    void unsupported(quint32 session, const QString &reason);
+
+private:
+    struct Segment {
+        qint64 sequence;
+        qint64 offset; // in the ring file
+        qint32 size;
+        qint32 durationMs;
+        qint64 receivedAt; // msecs since epoch
+        bool discontinuity;
+    };
+
+    struct SourceSegment {
+        qint64 sequence;
+        qint32 durationMs;
+        QUrl url;
+        bool discontinuity;
+    };
+
+    struct PendingPlaylist {
+        QPointer<QTcpSocket> socket;
+        qint64 delayMs;
+        QElapsedTimer waiting;
+    };
+
+    // Source side
+    void openSource();
+    void onSourceData();
+    void onSourceFinished();
+    void cutChunk();
+    void pollPlaylist();
+    void parsePlaylist(const QByteArray &text, const QUrl &base);
+    void downloadNextSegment();
+    void fail(const QString &reason);
+
+    // Ring
+    bool commit(const QByteArray &data, qint32 durationMs, bool discontinuity);
+    void dropOldest();
+    void reset();
+
+    // Server side
+    void serve();
+    void handleRequest(QTcpSocket *socket, const QByteArray &path);
+    QByteArray playlist(qint64 delayMs) const;
+    void housekeeping();
+    static void respond(QTcpSocket *socket, const QByteArray &status, const QByteArray &contentType,
+                        const QByteArray &body);
+
+    enum class Mode { Idle, Probing, Stream, Hls };
+
+    QString m_ringPath;
+    qint64 m_ringBytes;
+    QFile m_ring;
+    qint64 m_writePos = 0;
+    QList<Segment> m_segments; // oldest first, consecutive sequences
+    qint64 m_nextSequence = 0;
+    // Discontinuities that are no longer tagged in the playlist because
+    // their segment is first in the index or already dropped
+    qint64 m_discontinuitySequence = 0;
+    qint64 m_bufferedMs = 0;
+
+    QNetworkAccessManager *m_network = nullptr;
+    QTcpServer *m_server = nullptr;
+    QTimer *m_pollTimer = nullptr;
+    QTimer *m_housekeepingTimer = nullptr;
+    QList<PendingPlaylist> m_pendingPlaylists;
+
+    quint32 m_session = 0;
+    QUrl m_source;
+    Mode m_mode = Mode::Idle;
+    QPointer<QNetworkReply> m_sourceReply;   // probe, stream or playlist
+    QPointer<QNetworkReply> m_segmentReply;
+    bool m_discontinuity = false; // before the next committed segment
+
+    // Continuous TS
+    QByteArray m_chunk;
+    QElapsedTimer m_chunkTimer;
+
+    // HLS
+    QUrl m_mediaPlaylist;
+    qint64 m_lastSourceSequence = -1;
+    QList<SourceSegment> m_sourceQueue;
+};
+
+// Pause, rewind and catch-up for live channels. start() begins recording a
+// channel in the background while it is played directly; playbackUrl()
+// then plays the recording any number of seconds behind live.
+class TimeshiftProxy : public QObject
+{
+    Q_OBJECT
+
+public:
+    static constexpr qint64 DefaultRingBytes = 512LL * 1024 * 1024;
+
+    explicit TimeshiftProxy(QObject *parent = nullptr, qint64 ringBytes = DefaultRingBytes);
+    ~TimeshiftProxy() override;
+
+    bool isListening() const;
+    // Records source, replacing the previous recording
+    void start(const QUrl &source);
+    void stop();
+    QUrl source() const;
+    // False once the recorder gave up on the current source
+    bool isSupported() const;
+
+    // Plays the recording delayMs behind live
+    QUrl playbackUrl(qint64 delayMs) const;
+    qint64 bufferedMsecs() const;
+
+signals:
+    void bufferedChanged();
+    void unsupported(const QUrl &source);
+
+private:
+    QThread m_thread;
+    TimeshiftRecorder *m_recorder;
+    quint16 m_port = 0;
+    quint32 m_session = 0;
+    QUrl m_source;
+    bool m_supported = false;
+    qint64 m_bufferedMs = 0;
+};
+
+#endif // TIMESHIFTPROXY_H
@@ -0,0 +1,161 @@
+#include "userstate.h"
+#include "statestore.h"
+#include <QDateTime>
+#include <QJsonObject>
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+constexpr qsizetype kMaxHistory = 50;
+
+const QString kFavoritesPrefix = QStringLiteral("favorites/");
+const QString kHistoryPrefix = QStringLiteral("history/");
+const QString kLastWatchedKey = QStringLiteral("lastWatched");
+const QString kFastStartKey = QStringLiteral("fastStart");
+
+// favorites/<playlist>/, with the playlist percent-encoded
+QString playlistPrefix(const QString &prefix, const QString &playlist)
+{
+    return prefix + QString::fromLatin1(QUrl::toPercentEncoding(playlist)) + u'/';
+}
+
+} // namespace
+
+UserState::UserState(StateStore *store, QObject *parent)
+    : QObject(parent)
+    , m_store(store)
+{
+    connect(m_store, &StateStore::changed, this, &UserState::onStoreChanged);
+    connect(m_store, &StateStore::ready, this, [this]() {
+        m_favoriteSets.clear();
+        ++m_revision;
+        emit changed();
+        emit readyChanged();
+    });
+}
+
+int UserState::revision() const
+{
+    return m_revision;
+}
+
+bool UserState::isReady() const
+{
+    return m_store->isReady();
+}
+
+bool UserState::fastStart() const
+{
+    return m_store->value(kFastStartKey).toBool(false);
+}
+
+void UserState::setFastStart(bool enabled)
+{
+    m_store->setValue(kFastStartKey, enabled);
+}
+
+void UserState::onStoreChanged(const QString &key)
+{
+    if (key.startsWith(kFavoritesPrefix))
+        m_favoriteSets.clear();
+    else if (!key.startsWith(kHistoryPrefix) && key != kLastWatchedKey && key != kFastStartKey)
+        return;
+    ++m_revision;
+    emit changed();
+}
+
+const QSet<QString> &UserState::favoriteSet(const QString &playlist) const
+{
+    auto it = m_favoriteSets.find(playlist);
+    if (it == m_favoriteSets.end()) {
+        const QString prefix = playlistPrefix(kFavoritesPrefix, playlist);
+        QSet<QString> urls;
+        for (const QString &key : m_store->keys(prefix))
+            urls.insert(key.mid(prefix.size()));
+        it = m_favoriteSets.insert(playlist, urls);
+    }
+    return *it;
+}
+
+bool UserState::isFavorite(const QString &playlist, const QUrl &url) const
+{
+    return favoriteSet(playlist).contains(url.toString());
+}
+
+void UserState::setFavorite(const QString &playlist, const QUrl &url, bool favorite)
+{
+    const QString key = playlistPrefix(kFavoritesPrefix, playlist) + url.toString();
+    if (!favorite)
+        m_store->remove(key);
+    else if (m_store->value(key).isUndefined())
+        m_store->setValue(key, QDateTime::currentMSecsSinceEpoch());
+}
+
+QStringList UserState::favorites(const QString &playlist) const
+{
+    // In the order they were added
+    const QString prefix = playlistPrefix(kFavoritesPrefix, playlist);
+    QList<std::pair<qint64, QString>> added;
+    for (const QString &key : m_store->keys(prefix))
+        added.append({qint64(m_store->value(key).toDouble()), key.mid(prefix.size())});
+    std::sort(added.begin(), added.end());
+
+    QStringList urls;
+    for (const auto &favorite : std::as_const(added))
+        urls.append(favorite.second);
+    return urls;
+}
+
+void UserState::channelWatched(const QString &playlist, const QUrl &url, const QString &name,
+                               const QString &category)
+{
+    if (playlist.isEmpty() || url.isEmpty())
+        return;
+
+    const QString urlString = url.toString();
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    const QString prefix = playlistPrefix(kHistoryPrefix, playlist);
+    m_store->setValue(prefix + urlString, QJsonObject{{"name", name}, {"time", now}});
+
+    // Oldest entries beyond the limit go
+    const QStringList keys = m_store->keys(prefix);
+    if (keys.size() > kMaxHistory) {
+        QList<std::pair<qint64, QString>> watched;
+        for (const QString &key : keys)
+            watched.append({qint64(m_store->value(key).toObject().value("time").toDouble()), key});
+        std::sort(watched.begin(), watched.end());
+        for (qsizetype i = 0; i < watched.size() - kMaxHistory; ++i)
+            m_store->remove(watched[i].second);
+    }
+
+    m_store->setValue(kLastWatchedKey, QJsonObject{{"playlist", playlist},
+                                                   {"category", category},
+                                                   {"url", urlString},
+                                                   {"name", name},
+                                                   {"time", now}});
+}
+
+QVariantList UserState::history(const QString &playlist) const
+{
+    // Newest first, as {url, name, time}
+    const QString prefix = playlistPrefix(kHistoryPrefix, playlist);
+    QList<std::pair<qint64, QVariantMap>> watched;
+    for (const QString &key : m_store->keys(prefix)) {
+        QVariantMap entry = m_store->value(key).toObject().toVariantMap();
+        entry.insert("url", key.mid(prefix.size()));
+        watched.append({entry.value("time").toLongLong(), entry});
+    }
+    std::sort(watched.begin(), watched.end(),
+              [](const auto &a, const auto &b) { return a.first > b.first; });
+
+    QVariantList history;
+    for (qsizetype i = 0; i < watched.size() && i < kMaxHistory; ++i)
+        history.append(watched[i].second);
+    return history;
+}
+
+QVariantMap UserState::lastWatched() const
+{
+    return m_store->value(kLastWatchedKey).toObject().toVariantMap();
+}
@@ -0,0 +1,68 @@
+#ifndef USERSTATE_H
+#define USERSTATE_H
+
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QUrl>
+#include <QVariantList>
+#include <QVariantMap>
+
+class StateStore;
+
+// Favourites, watch history and the last watched channel, kept in a
+// StateStore. playlist is PlaylistModel::source, so each playlist (and the
+// merged catalogue) has its own favourites and history. One key per
+// channel, with the playlist percent-encoded so it holds no '/':
+//
+//   favorites/<playlist>/<url>  time it was added
+//   history/<playlist>/<url>    {name, time}; the newest 50 are kept
+//   lastWatched                 {playlist, category, url, name, time}
+//   fastStart                   bool, off unless set; see Main.qml's restoreSession()
+//
+// QML re-evaluates bindings that read these through revision.
+// Nothing is known before ready; the store loads in the background.
+class UserState : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(int revision READ revision NOTIFY changed)
+    Q_PROPERTY(bool ready READ isReady NOTIFY readyChanged)
+    // Reopen the last channel on start
+    Q_PROPERTY(bool fastStart READ fastStart WRITE setFastStart NOTIFY changed)
+
+public:
+    explicit UserState(StateStore *store, QObject *parent = nullptr);
+
+    int revision() const;
+    bool isReady() const;
+    bool fastStart() const;
+    void setFastStart(bool enabled);
+
+    Q_INVOKABLE bool isFavorite(const QString &playlist, const QUrl &url) const;
+    Q_INVOKABLE void setFavorite(const QString &playlist, const QUrl &url, bool favorite);
+    Q_INVOKABLE QStringList favorites(const QString &playlist) const;
+
+    // Moves the channel to the front of the playlist's history
+    Q_INVOKABLE void channelWatched(const QString &playlist, const QUrl &url, const QString &name,
+                                    const QString &category = QString());
+    Q_INVOKABLE QVariantList history(const QString &playlist) const;
+    // Empty until something was watched
+    Q_INVOKABLE QVariantMap lastWatched() const;
+
+signals:
+    void changed();
+    void readyChanged();
+
+private:
+    void onStoreChanged(const QString &key);
+    const QSet<QString> &favoriteSet(const QString &playlist) const;
+
+    StateStore *m_store;
+    int m_revision = 0;
+    // isFavorite() runs for every delegate; parsed once per change
+    mutable QHash<QString, QSet<QString>> m_favoriteSets;
+};
+
+#endif // USERSTATE_H
@@ -0,0 +1,142 @@
+#include "xmltvparser.h"
+
+namespace {
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+qint64 daysFromCivil(qint64 year, unsigned month, unsigned day)
+{
+    year -= month <= 2;
+    const qint64 era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yearOfEra = unsigned(year - era * 400);
+    const unsigned dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + qint64(dayOfEra) - 719468;
+}
+
+bool readDigits(QStringView text, qsizetype from, qsizetype count, int *value)
+{
+    if (from + count > text.size())
+        return false;
+    int result = 0;
+    for (qsizetype i = from; i < from + count; ++i) {
+        const char16_t ch = text[i].unicode();
+        if (ch < u'0' || ch > u'9')
+            return false;
+        result = result * 10 + (ch - u'0');
+    }
+    *value = result;
+    return true;
+}
+
+} // namespace
+
+XmltvParser::XmltvParser(EpgGuide::Builder *builder)
+    : m_builder(builder)
+{
+}
+
+qint64 XmltvParser::parseTime(QStringView text)
+{
+    int year, month, day, hour = 0, minute = 0, second = 0;
+    if (!readDigits(text, 0, 4, &year) || !readDigits(text, 4, 2, &month) || !readDigits(text, 6, 2, &day))
+        return -1;
+    // Hours, minutes and seconds may each be left out
+    qsizetype pos = 8;
+    for (int *field : {&hour, &minute, &second}) {
+        if (!readDigits(text, pos, 2, field))
+            break;
+        pos += 2;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60)
+        return -1;
+
+    qint64 seconds = daysFromCivil(year, unsigned(month), unsigned(day)) * 86400 + hour * 3600 + minute * 60 + second;
+
+    const QStringView zone = text.sliced(pos).trimmed();
+    int offsetHours, offsetMinutes;
+    if (zone.size() >= 5 && (zone[0] == u'+' || zone[0] == u'-') && readDigits(zone, 1, 2, &offsetHours)
+        && readDigits(zone, 3, 2, &offsetMinutes)) {
+        const qint64 offset = offsetHours * 3600 + offsetMinutes * 60;
+        seconds -= zone[0] == u'+' ? offset : -offset;
+    }
+    return seconds;
+}
+
+bool XmltvParser::feed(QByteArrayView chunk)
+{
+    m_reader.addData(chunk);
+    return readAvailable();
+}
+
+bool XmltvParser::finish()
+{
+    if (!readAvailable())
+        return false;
+    // Whatever is still open at this point is truncated
+    return !m_reader.hasError() && !m_inProgramme && !m_inChannel;
+}
+
+QString XmltvParser::errorString() const
+{
+    if (m_reader.hasError() && m_reader.error() != QXmlStreamReader::PrematureEndOfDocumentError)
+        return m_reader.errorString();
+    return QStringLiteral("Unexpected end of XMLTV data");
+}
+
+bool XmltvParser::readAvailable()
+{
+    while (!m_reader.atEnd()) {
+        switch (m_reader.readNext()) {
+        case QXmlStreamReader::StartElement: {
+            const QStringView name = m_reader.name();
+            if (name == u"programme") {
+                const QXmlStreamAttributes attributes = m_reader.attributes();
+                m_inProgramme = true;
+                m_hasTitle = false;
+                m_title.clear();
+                m_channel = m_builder->channel(attributes.value(u"channel"));
+                m_start = parseTime(attributes.value(u"start"));
+                m_stop = parseTime(attributes.value(u"stop"));
+            } else if (name == u"title" && m_inProgramme && !m_hasTitle) {
+                // The first title wins, later ones are translations
+                m_capture = Capture::Title;
+                m_text.clear();
+            } else if (name == u"channel" && !m_inProgramme) {
+                m_inChannel = true;
+                m_channel = m_builder->channel(m_reader.attributes().value(u"id"));
+            } else if (name == u"display-name" && m_inChannel) {
+                m_capture = Capture::DisplayName;
+                m_text.clear();
+            }
+            break;
+        }
+        case QXmlStreamReader::Characters:
+            if (m_capture != Capture::None)
+                m_text.append(m_reader.text());
+            break;
+        case QXmlStreamReader::EndElement: {
+            const QStringView name = m_reader.name();
+            if (m_capture == Capture::Title && name == u"title") {
+                m_title = m_text.trimmed();
+                m_hasTitle = true;
+                m_capture = Capture::None;
+            } else if (m_capture == Capture::DisplayName && name == u"display-name") {
+                m_builder->addDisplayName(m_channel, m_text.trimmed());
+                m_capture = Capture::None;
+            } else if (name == u"programme") {
+                if (m_start >= 0)
+                    m_builder->addProgramme(m_channel, m_start, m_stop, m_title);
+                m_inProgramme = false;
+            } else if (name == u"channel") {
+                m_inChannel = false;
+            }
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    // Running out of input in the middle of the document is expected here
+    return !m_reader.hasError() || m_reader.error() == QXmlStreamReader::PrematureEndOfDocumentError;
+}
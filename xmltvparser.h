@@ -0,0 +1,47 @@
+#ifndef XMLTVPARSER_H
+#define XMLTVPARSER_H
+
+#include <QByteArrayView>
+#include <QString>
+#include <QXmlStreamReader>
+#include "epgguide.h"
+
+// Incremental XMLTV reader. Built on QXmlStreamReader, which is a pull
+// parser: chunks are handed over with feed() as they are read and nothing
+// but the current <channel>/<programme> is kept, so feeds of hundreds of MB
+// parse in constant memory. Results go straight into an EpgGuide::Builder.
+class XmltvParser
+{
+public:
+    explicit XmltvParser(EpgGuide::Builder *builder);
+
+    // Returns false on malformed XML; a chunk may end anywhere
+    bool feed(QByteArrayView chunk);
+    // Call after the last chunk. Returns false if the document is incomplete.
+    bool finish();
+    QString errorString() const;
+
+    // "20240131203000 +0100" -> seconds since the epoch; a missing offset
+    // means UTC. Returns -1 if the text is not a valid XMLTV time.
+    static qint64 parseTime(QStringView text);
+
+private:
+    bool readAvailable();
+
+    EpgGuide::Builder *m_builder;
+    QXmlStreamReader m_reader;
+
+    // Element being read
+    enum class Capture { None, DisplayName, Title };
+    Capture m_capture = Capture::None;
+    QString m_text;
+    bool m_inChannel = false;
+    bool m_inProgramme = false;
+    bool m_hasTitle = false;
+    quint32 m_channel = 0;
+    qint64 m_start = -1;
+    qint64 m_stop = -1;
+    QString m_title;
+};
+
+#endif // XMLTVPARSER_H
@@ -0,0 +1,465 @@
+#include "zappingcontroller.h"
+#include "playlistmodel.h"
+#include "telemetry.h"
+#include "timeshiftproxy.h"
+#include <QVideoSink>
+#include <algorithm>
+
+ZappingController::ZappingController(QObject *parent)
+    : QObject(parent)
+    , m_audioOutput(new QAudioOutput(this))
+    , m_reloadTimer(new QTimer(this))
+{
+    // Always have a player so QML can bind to its state before the first switch
+    m_active = createPlayer();
+    m_active->setAudioOutput(m_audioOutput);
+
+    m_reloadTimer->setInterval(2000);
+    connect(m_reloadTimer, &QTimer::timeout, this, &ZappingController::reloadStale);
+}
+
+ZappingController::~ZappingController()
+{
+    QObject::disconnect(m_frameConnection);
+}
+
+PlaylistModel *ZappingController::model() const
+{
+    return m_model;
+}
+
+void ZappingController::setModel(PlaylistModel *model)
+{
+    if (m_model == model)
+        return;
+    m_model = model;
+    emit modelChanged();
+}
+
+QObject *ZappingController::videoOutput() const
+{
+    return m_videoOutput;
+}
+
+void ZappingController::setVideoOutput(QObject *videoOutput)
+{
+    if (m_videoOutput == videoOutput)
+        return;
+    m_videoOutput = videoOutput;
+    m_active->setVideoOutput(videoOutput);
+    emit videoOutputChanged();
+}
+
+qreal ZappingController::volume() const
+{
+    return m_audioOutput->volume();
+}
+
+void ZappingController::setVolume(qreal volume)
+{
+    if (qFuzzyCompare(m_audioOutput->volume(), float(volume)))
+        return;
+    m_audioOutput->setVolume(float(volume));
+    emit volumeChanged();
+}
+
+QMediaPlayer *ZappingController::player() const
+{
+    return m_active;
+}
+
+int ZappingController::warmLimit() const
+{
+    return m_warmLimit;
+}
+
+void ZappingController::setWarmLimit(int limit)
+{
+    limit = qMax(0, limit);
+    if (m_warmLimit == limit)
+        return;
+    m_warmLimit = limit;
+    while (m_warm.size() > m_warmLimit)
+        release(m_warm.takeLast().player);
+    emit warmLimitChanged();
+}
+
+int ZappingController::warmMaxAge() const
+{
+    return m_warmMaxAge;
+}
+
+void ZappingController::setWarmMaxAge(int msecs)
+{
+    if (m_warmMaxAge == msecs)
+        return;
+    m_warmMaxAge = msecs;
+    emit warmMaxAgeChanged();
+}
+
+int ZappingController::lastTimeToFirstFrame() const
+{
+    return m_lastTimeToFirstFrame;
+}
+
+bool ZappingController::timeshift() const
+{
+    return m_timeshift;
+}
+
+void ZappingController::setTimeshift(bool enabled)
+{
+    if (m_timeshift == enabled)
+        return;
+    m_timeshift = enabled;
+    if (enabled) {
+        if (!m_timeshiftProxy) {
+            m_timeshiftProxy = new TimeshiftProxy(this);
+            connect(m_timeshiftProxy, &TimeshiftProxy::bufferedChanged, this, &ZappingController::timeshiftChanged);
+            connect(m_timeshiftProxy, &TimeshiftProxy::unsupported, this, [this](const QUrl &source) {
+                if (source == m_activeUrl)
+                    goLive();
+            });
+        }
+        if (!m_activeUrl.isEmpty())
+            record(m_activeUrl);
+    } else {
+        goLive();
+        m_pausedTimer.invalidate();
+        if (m_timeshiftProxy)
+            m_timeshiftProxy->stop();
+    }
+    emit timeshiftChanged();
+}
+
+int ZappingController::timeshiftDelay() const
+{
+    return int(m_timeshiftDelay / 1000);
+}
+
+int ZappingController::timeshiftBuffered() const
+{
+    return canShift() ? int(m_timeshiftProxy->bufferedMsecs() / 1000) : 0;
+}
+
+bool ZappingController::canShift() const
+{
+    return m_timeshift && m_timeshiftProxy && m_timeshiftProxy->isSupported()
+           && m_timeshiftProxy->source() == m_activeUrl;
+}
+
+void ZappingController::record(const QUrl &url)
+{
+    if (m_timeshift && m_timeshiftProxy && m_timeshiftProxy->source() != url)
+        m_timeshiftProxy->start(url);
+}
+
+QMediaPlayer *ZappingController::createPlayer()
+{
+    if (!m_spare.isEmpty())
+        return m_spare.takeLast();
+
+    auto *player = new QMediaPlayer(this);
+    connect(player, &QMediaPlayer::errorOccurred, this, [this, player]() { onPlayerError(player); });
+    connect(player, &QMediaPlayer::mediaStatusChanged, this,
+            [this, player](QMediaPlayer::MediaStatus status) { onMediaStatusChanged(player, status); });
+    return player;
+}
+
+void ZappingController::release(QMediaPlayer *player)
+{
+    // Dropping the source closes the connection and frees the buffers
+    player->stop();
+    player->setSource(QUrl());
+    player->setVideoOutput(nullptr);
+    player->setAudioOutput(nullptr);
+    m_spare.append(player);
+}
+
+QMediaPlayer *ZappingController::takeWarm(const QUrl &url)
+{
+    for (qsizetype i = 0; i < m_warm.size(); ++i) {
+        if (m_warm[i].player->source() == url)
+            return m_warm.takeAt(i).player;
+    }
+    return nullptr;
+}
+
+void ZappingController::playRow(int row)
+{
+    if (!m_model)
+        return;
+    const QUrl url = m_model->getChannelUrl(row);
+    if (url.isEmpty())
+        return;
+
+    playUrl(url);
+    emit channelStarted(url, m_model->getChannelName(row));
+
+    // Same wrap-around as the next/previous gestures, over the whole
+    // category rather than the rows fetched so far. Unfetched rows are only
+    // looked at, not fetched.
+    const int count = m_model->totalCount();
+    QList<QUrl> likely;
+    if (count > 1) {
+        likely.append(m_model->getChannelUrl((row + 1) % count));
+        likely.append(m_model->getChannelUrl((row - 1 + count) % count));
+    }
+    likely.append(m_lastWatched);
+    warm(likely);
+}
+
+void ZappingController::playUrl(const QUrl &url)
+{
+    if (m_activeUrl == url) {
+        record(url);
+        resume();
+        return;
+    }
+
+    endStall();
+    QMediaPlayer *next = takeWarm(url);
+    const bool wasWarm = next != nullptr;
+    if (!next) {
+        next = createPlayer();
+        next->setSource(url);
+    }
+
+    if (m_activeUrl.isEmpty()) {
+        release(m_active);
+    } else {
+        // The channel left behind is the most likely way back
+        m_lastWatched = m_activeUrl;
+        m_active->setVideoOutput(nullptr);
+        m_active->setAudioOutput(nullptr);
+        // Only a player on the channel's own URL can be found again; one on
+        // the recording or a fallback source is not worth keeping
+        if (m_warmLimit > 0 && m_active->error() == QMediaPlayer::NoError && m_active->source() == m_activeUrl) {
+            m_active->pause();
+            m_warm.prepend({m_active, QElapsedTimer()});
+            m_warm.first().loaded.start();
+        } else {
+            release(m_active);
+        }
+    }
+
+    next->setVideoOutput(m_videoOutput.data());
+    next->setAudioOutput(m_audioOutput);
+    m_active = next;
+    m_activeUrl = url;
+    m_timeshiftDelay = 0;
+    m_pausedTimer.invalidate();
+    record(url);
+    m_activeSubject = Telemetry::subject(url.toString());
+    measureFirstFrame(wasWarm);
+    next->play();
+    emit playerChanged();
+    emit timeshiftChanged();
+}
+
+void ZappingController::warm(const QList<QUrl> &urls)
+{
+    QList<QUrl> wanted;
+    for (const QUrl &url : urls) {
+        if (!url.isEmpty() && !wanted.contains(url) && url != m_activeUrl)
+            wanted.append(url);
+    }
+    wanted.resize(qMin(wanted.size(), qsizetype(m_warmLimit)));
+
+    // Keep what is still wanted in priority order and drop the rest
+    QList<WarmPlayer> kept;
+    for (const QUrl &url : std::as_const(wanted)) {
+        // A kept player keeps its age: being wanted again does not make its
+        // buffer any fresher
+        const auto existing = std::find_if(m_warm.begin(), m_warm.end(), [&url](const WarmPlayer &warmPlayer) {
+            return warmPlayer.player->source() == url;
+        });
+        if (existing != m_warm.end()) {
+            kept.append(*existing);
+            m_warm.erase(existing);
+        } else {
+            // Paused without outputs: loads and buffers but renders nothing
+            QMediaPlayer *fresh = createPlayer();
+            fresh->setSource(url);
+            fresh->pause();
+            kept.append({fresh, QElapsedTimer()});
+            kept.last().loaded.start();
+        }
+    }
+    for (const WarmPlayer &stale : std::as_const(m_warm))
+        release(stale.player);
+    m_warm = kept;
+
+    if (m_warm.isEmpty())
+        m_reloadTimer->stop();
+    else if (!m_reloadTimer->isActive())
+        m_reloadTimer->start();
+}
+
+void ZappingController::reloadStale()
+{
+    for (WarmPlayer &warmPlayer : m_warm) {
+        // Recordings and on-demand streams keep their place
+        if (warmPlayer.player->isSeekable() || !warmPlayer.loaded.hasExpired(m_warmMaxAge))
+            continue;
+        // Loaded again from the live edge, well before it is switched to
+        const QUrl url = warmPlayer.player->source();
+        warmPlayer.player->setSource(QUrl());
+        warmPlayer.player->setSource(url);
+        warmPlayer.player->pause();
+        warmPlayer.loaded.start();
+    }
+}
+
+void ZappingController::stop()
+{
+    endStall();
+    QObject::disconnect(m_frameConnection);
+    if (m_timeshiftDelay > 0) {
+        m_timeshiftDelay = 0;
+        m_active->setSource(m_activeUrl);
+    }
+    m_active->stop();
+    m_pausedTimer.invalidate();
+    if (m_timeshiftProxy)
+        m_timeshiftProxy->stop();
+    emit timeshiftChanged();
+    for (const WarmPlayer &warmPlayer : std::as_const(m_warm))
+        release(warmPlayer.player);
+    m_warm.clear();
+    m_reloadTimer->stop();
+}
+
+void ZappingController::onPlayerError(QMediaPlayer *player)
+{
+    if (player == m_active) {
+        // Shown to the user by the normal error handling
+        endStall();
+        Telemetry::record(TelemetryEvent::PlaybackError, m_activeSubject, player->error());
+        // The recording may have been overwritten; live is the safe place
+        if (m_timeshiftDelay > 0)
+            goLive();
+        else
+            QTimer::singleShot(0, this, [this, player]() { tryNextSource(player); });
+        return;
+    }
+    for (qsizetype i = 0; i < m_warm.size(); ++i) {
+        if (m_warm[i].player == player) {
+            release(m_warm.takeAt(i).player);
+            return;
+        }
+    }
+}
+
+void ZappingController::pause()
+{
+    m_active->pause();
+    if (canShift() && !m_pausedTimer.isValid())
+        m_pausedTimer.start();
+}
+
+void ZappingController::resume()
+{
+    if (m_pausedTimer.isValid() && canShift()) {
+        // Everything that went out while paused is in the recording
+        const qint64 delayMs = m_timeshiftDelay + m_pausedTimer.elapsed();
+        m_pausedTimer.invalidate();
+        playShifted(delayMs);
+        return;
+    }
+    m_pausedTimer.invalidate();
+    m_active->play();
+}
+
+void ZappingController::rewind(int secs)
+{
+    if (!canShift())
+        return;
+    qint64 delayMs = m_timeshiftDelay + qint64(secs) * 1000;
+    if (m_pausedTimer.isValid()) {
+        delayMs += m_pausedTimer.elapsed();
+        m_pausedTimer.invalidate();
+    }
+    // The oldest segments may be overwritten while the player starts up
+    delayMs = qMin(delayMs, m_timeshiftProxy->bufferedMsecs() - 6000);
+    if (delayMs <= 0)
+        return;
+    playShifted(delayMs);
+}
+
+void ZappingController::playShifted(qint64 delayMs)
+{
+    endStall();
+    m_timeshiftDelay = delayMs;
+    m_active->setSource(m_timeshiftProxy->playbackUrl(delayMs));
+    m_active->play();
+    emit timeshiftChanged();
+}
+
+void ZappingController::goLive()
+{
+    if (m_timeshiftDelay == 0)
+        return;
+    endStall();
+    m_timeshiftDelay = 0;
+    m_pausedTimer.invalidate();
+    m_active->setSource(m_activeUrl);
+    m_active->play();
+    emit timeshiftChanged();
+}
+
+void ZappingController::tryNextSource(QMediaPlayer *player)
+{
+    // In a merged catalogue the same channel may come from other playlists
+    if (player != m_active || !m_model || player->error() == QMediaPlayer::NoError)
+        return;
+    const QList<QUrl> sources = m_model->channelSources(m_activeUrl);
+    const qsizetype current = sources.indexOf(player->source());
+    if (current < 0 || current + 1 >= sources.size())
+        return;
+
+    measureFirstFrame(false);
+    player->setSource(sources[current + 1]);
+    player->play();
+}
+
+void ZappingController::onMediaStatusChanged(QMediaPlayer *player, QMediaPlayer::MediaStatus status)
+{
+    if (player != m_active)
+        return;
+    // Stalled means the buffer ran dry during playback; it ends when the
+    // player has enough data again
+    if (status == QMediaPlayer::StalledMedia) {
+        if (!m_stallTimer.isValid())
+            m_stallTimer.start();
+    } else if (status == QMediaPlayer::BufferedMedia || status == QMediaPlayer::EndOfMedia) {
+        endStall();
+    }
+}
+
+void ZappingController::endStall()
+{
+    if (!m_stallTimer.isValid())
+        return;
+    Telemetry::record(TelemetryEvent::Stall, m_activeSubject, qint32(m_stallTimer.elapsed()));
+    m_stallTimer.invalidate();
+}
+
+void ZappingController::measureFirstFrame(bool warm)
+{
+    QObject::disconnect(m_frameConnection);
+    QVideoSink *sink = m_videoOutput ? m_videoOutput->property("videoSink").value<QVideoSink *>() : nullptr;
+    if (!sink)
+        return;
+
+    m_switchWarm = warm;
+    m_switchTimer.start();
+    m_frameConnection = connect(sink, &QVideoSink::videoFrameChanged, this, [this](const QVideoFrame &frame) {
+        if (!frame.isValid())
+            return;
+        QObject::disconnect(m_frameConnection);
+        m_lastTimeToFirstFrame = int(m_switchTimer.elapsed());
+        Telemetry::record(TelemetryEvent::FirstFrame, m_activeSubject, m_lastTimeToFirstFrame, m_switchWarm);
+        emit firstFrameShown(m_lastTimeToFirstFrame, m_switchWarm);
+    });
+}
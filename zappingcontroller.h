@@ -0,0 +1,151 @@
+#ifndef ZAPPINGCONTROLLER_H
+#define ZAPPINGCONTROLLER_H
+
+#include <QAudioOutput>
+#include <QElapsedTimer>
+#include <QList>
+#include <QMediaPlayer>
+#include <QObject>
+#include <QPointer>
+#include <QTimer>
+#include <QUrl>
+
+class PlaylistModel;
+Q_MOC_INCLUDE("playlistmodel.h")
+class QVideoSink;
+class TimeshiftProxy;
+
+// Plays the selected channel and keeps a few players "warm" for the channels
+// the user is most likely to switch to next: the rows after and before the
+// current one, and the channel watched last. A warm player has its source
+// set and is paused, so the connection is open and the first segments are
+// buffered; switching to it only attaches the video and audio outputs and
+// calls play(). Cold switches load the URL from scratch as before.
+//
+// Warm players cost a connection, buffers and a demuxer each, so the pool
+// is small (warmLimit), and anything that errors is evicted at once. A
+// paused live stream does not move on, so a live player whose buffer is
+// older than warmMaxAge is loaded again in the background; promoted, it is
+// never further behind live than that.
+//
+// If the active channel fails and the model has other sources for it (a
+// merged catalogue), the next one is played in its place.
+//
+// With timeshift on, the active channel is also recorded by a
+// TimeshiftProxy. It still plays directly, so zapping stays fast; only
+// resuming after a pause or rewinding switches the player to the recording,
+// and goLive() switches back.
+class ZappingController : public QObject
+{
+    Q_OBJECT
+
+    Q_PROPERTY(PlaylistModel *model READ model WRITE setModel NOTIFY modelChanged)
+    Q_PROPERTY(QObject *videoOutput READ videoOutput WRITE setVideoOutput NOTIFY videoOutputChanged)
+    Q_PROPERTY(qreal volume READ volume WRITE setVolume NOTIFY volumeChanged)
+    Q_PROPERTY(QMediaPlayer *player READ player NOTIFY playerChanged)
+    Q_PROPERTY(int warmLimit READ warmLimit WRITE setWarmLimit NOTIFY warmLimitChanged)
+    Q_PROPERTY(int warmMaxAge READ warmMaxAge WRITE setWarmMaxAge NOTIFY warmMaxAgeChanged)
+    Q_PROPERTY(int lastTimeToFirstFrame READ lastTimeToFirstFrame NOTIFY firstFrameShown)
+    Q_PROPERTY(bool timeshift READ timeshift WRITE setTimeshift NOTIFY timeshiftChanged)
+    Q_PROPERTY(int timeshiftDelay READ timeshiftDelay NOTIFY timeshiftChanged)
+    Q_PROPERTY(int timeshiftBuffered READ timeshiftBuffered NOTIFY timeshiftChanged)
+
+public:
+    explicit ZappingController(QObject *parent = nullptr);
+    ~ZappingController() override;
+
+    PlaylistModel *model() const;
+    void setModel(PlaylistModel *model);
+    QObject *videoOutput() const;
+    void setVideoOutput(QObject *videoOutput);
+    qreal volume() const;
+    void setVolume(qreal volume);
+    QMediaPlayer *player() const;
+    int warmLimit() const;
+    void setWarmLimit(int limit);
+    int warmMaxAge() const;
+    void setWarmMaxAge(int msecs);
+    int lastTimeToFirstFrame() const;
+    bool timeshift() const;
+    void setTimeshift(bool enabled);
+    // Seconds behind live, 0 when playing live
+    int timeshiftDelay() const;
+    // Seconds recorded so far, 0 if the channel cannot be recorded
+    int timeshiftBuffered() const;
+
+    // Plays a row of the model and warms up its neighbours
+    Q_INVOKABLE void playRow(int row);
+    // Plays a URL outside the model, e.g. a search result
+    Q_INVOKABLE void playUrl(const QUrl &url);
+    // Stops playback and releases every warm player
+    Q_INVOKABLE void stop();
+    // With timeshift, resume() continues from where pause() left off
+    Q_INVOKABLE void pause();
+    Q_INVOKABLE void resume();
+    Q_INVOKABLE void rewind(int secs);
+    Q_INVOKABLE void goLive();
+
+signals:
+    void modelChanged();
+    void videoOutputChanged();
+    void volumeChanged();
+    void playerChanged();
+    void warmLimitChanged();
+    void warmMaxAgeChanged();
+    void timeshiftChanged();
+    // Time from the switch request to the first decoded frame
+    void firstFrameShown(int msecs, bool warm);
+    // A channel of the model was switched to, for history and the like
+    void channelStarted(const QUrl &url, const QString &name);
+
+private:
+    struct WarmPlayer {
+        QMediaPlayer *player;
+        QElapsedTimer loaded; // age of its buffer
+    };
+
+    QMediaPlayer *createPlayer();
+    QMediaPlayer *takeWarm(const QUrl &url);
+    void warm(const QList<QUrl> &urls);
+    void release(QMediaPlayer *player);
+    void reloadStale();
+    void onPlayerError(QMediaPlayer *player);
+    void tryNextSource(QMediaPlayer *player);
+    void onMediaStatusChanged(QMediaPlayer *player, QMediaPlayer::MediaStatus status);
+    void endStall();
+    void measureFirstFrame(bool warm);
+    void record(const QUrl &url);
+    bool canShift() const;
+    void playShifted(qint64 delayMs);
+
+    QPointer<PlaylistModel> m_model;
+    QPointer<QObject> m_videoOutput;
+    QAudioOutput *m_audioOutput;
+    QMediaPlayer *m_active; // never null
+    QUrl m_activeUrl;       // the channel, also while playing the recording
+    QList<WarmPlayer> m_warm;      // most useful first
+    QList<QMediaPlayer *> m_spare; // stopped, ready for reuse
+    QUrl m_lastWatched;
+
+    int m_warmLimit = 3;
+    int m_warmMaxAge = 10000;
+    QTimer *m_reloadTimer;
+
+    // Time-to-first-frame of the switch in progress
+    QElapsedTimer m_switchTimer;
+    QMetaObject::Connection m_frameConnection;
+    bool m_switchWarm = false;
+    int m_lastTimeToFirstFrame = -1;
+
+    // Telemetry of the active channel
+    quint64 m_activeSubject = 0;
+    QElapsedTimer m_stallTimer; // running while the active player is stalled
+
+    // Timeshift of the active channel
+    bool m_timeshift = false;
+    TimeshiftProxy *m_timeshiftProxy = nullptr; // created when first enabled
+    qint64 m_timeshiftDelay = 0;                // ms behind live
+    QElapsedTimer m_pausedTimer;
+};
+
+#endif // ZAPPINGCONTROLLER_H